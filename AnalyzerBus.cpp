@@ -0,0 +1,301 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "AnalyzerBus.h"
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+#include "MemoryGovernor.h"
+#include "PipelineTrace.h"
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * An analyzer the bus runs, with the frames it wants.
+ */
+struct BusSubscriber {
+    FrameAnalyzer* analyzer;
+    FrameSubscription subscription;
+
+    // The index in the widths scaled for every frame.
+    int width_id;
+};
+
+/**
+ * Get the first frame from a frame on that a subscriber wants, or INT_MAX when it wants no more.
+ */
+static int GetNextWantedFrame(const BusSubscriber& subscriber, int from_frame) {
+    int interval = subscriber.subscription.interval;
+    int sample = (from_frame + interval - 1) / interval;
+
+    if (subscriber.subscription.count >= 0 && sample >= subscriber.subscription.count)
+        return INT_MAX;
+
+    return sample * interval;
+}
+
+static int GetNextWantedFrame(const vector<BusSubscriber>& subscribers, int from_frame) {
+    int next_frame = INT_MAX;
+
+    for (const BusSubscriber& subscriber : subscribers)
+        next_frame = min(next_frame, GetNextWantedFrame(subscriber, from_frame));
+
+    return next_frame;
+}
+
+/**
+ * Decodes a frame, grabbing through the frames before it when they are close and seeking otherwise.
+ *
+ * @param position The next frame the capture decodes, or -1 when the next read seeks.
+ */
+static bool DecodeBusFrame(VideoCapture& cap, int& position, int target_frame, Mat& frame) {
+    TraceSpan span("decode", target_frame);
+
+    if (position < 0 || target_frame < position || target_frame - position > ANALYZER_BUS_MAX_GRAB_GAP) {
+        cap.set(CAP_PROP_POS_FRAMES, target_frame);
+        position = target_frame;
+    }
+
+    while (position < target_frame) {
+        if (!cap.grab()) {
+            position = -1;
+            return false;
+        }
+        position++;
+    }
+
+    if (!cap.read(frame) || frame.empty()) {
+        position = -1;
+        return false;
+    }
+
+    position++;
+
+    return true;
+}
+
+void AnalyzerBus::Add(FrameAnalyzer* analyzer) {
+    analyzers.push_back(analyzer);
+}
+
+bool AnalyzerBus::Run(const string& movie_path, const ArtRenderOptions& options) {
+    VideoCapture cap;
+
+    if (!OpenMovieCapture(cap, movie_path, options)) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return false;
+    }
+
+    FrameBusInfo info;
+    info.movie_path = movie_path;
+    info.frame_count = (int)cap.get(CAP_PROP_FRAME_COUNT);
+    info.fps = cap.get(CAP_PROP_FPS);
+    info.frame_size = Size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+
+    vector<BusSubscriber> subscribers;
+    vector<int> widths;
+
+    for (FrameAnalyzer* analyzer : analyzers) {
+        BusSubscriber subscriber;
+        subscriber.analyzer = analyzer;
+
+        if (!analyzer->Begin(info, subscriber.subscription))
+            continue;
+
+        subscriber.subscription.interval = max(1, subscriber.subscription.interval);
+
+        // Analyzers that want the same width share the scaled frames.
+        vector<int>::iterator width = find(widths.begin(), widths.end(), subscriber.subscription.width);
+        subscriber.width_id = (int)(width - widths.begin());
+
+        if (width == widths.end())
+            widths.push_back(subscriber.subscription.width);
+
+        subscribers.push_back(subscriber);
+    }
+
+    if (subscribers.empty())
+        return false;
+
+    // Waits here while the other renders use up the memory budget, before the decoder fills its pool.
+    MemoryReservation reservation(EstimateRenderMemory(info.frame_size, options), options.memory_job);
+
+    int position = -1;
+    int current_frame = GetNextWantedFrame(subscribers, 0);
+    Mat decoded;
+    bool current_decoded = current_frame < info.frame_count && DecodeBusFrame(cap, position, current_frame, decoded);
+
+    vector<Mat> scaled_frames(widths.size());
+    vector<BusSubscriber*> wanting;
+
+    while (current_frame < info.frame_count) {
+        int next_frame = GetNextWantedFrame(subscribers, current_frame + 1);
+
+        // The analyzers still hold the current frame while the next one is decoded, so it gets pixels of its own.
+        Mat next_decoded;
+        bool next_decoded_ok = false;
+
+        wanting.clear();
+
+        if (current_decoded) {
+            for (BusSubscriber& subscriber : subscribers) {
+                if (GetNextWantedFrame(subscriber, current_frame) == current_frame)
+                    wanting.push_back(&subscriber);
+            }
+
+            TraceSpan span("convert", current_frame);
+
+            for (size_t i = 0; i < widths.size(); i++) {
+                Size scaled_size = GetReducedFrameSize(decoded.size(), widths[i]);
+
+                if (scaled_size == decoded.size())
+                    scaled_frames[i] = decoded;
+                else {
+                    scaled_frames[i].release();
+                    resize(decoded, scaled_frames[i], scaled_size, 0, 0, INTER_AREA);
+                }
+            }
+        }
+
+        // Index 0 decodes the next frame while the others analyze the current one. The frames an analyzer
+        // misses, because they could not be decoded, are simply never given to it.
+        GetSharedThreadPool().ParallelFor((int)wanting.size() + 1, [&](int i) {
+            if (i == 0) {
+                if (next_frame < info.frame_count)
+                    next_decoded_ok = DecodeBusFrame(cap, position, next_frame, next_decoded);
+                return;
+            }
+
+            BusSubscriber* subscriber = wanting[i - 1];
+            TraceSpan span("analyze", current_frame);
+            subscriber->analyzer->Analyze(current_frame, scaled_frames[subscriber->width_id]);
+        });
+
+        current_frame = next_frame;
+        current_decoded = next_decoded_ok;
+        decoded = next_decoded;
+    }
+
+    cap.release();
+
+    for (BusSubscriber& subscriber : subscribers)
+        subscriber.analyzer->Finish();
+
+    return true;
+}
+
+ArtFrameAnalyzer::ArtFrameAnalyzer(Mat& art_image, const ArtRenderOptions& options, ArtVideoSink* video_sink)
+    : art_image(art_image), options(options), video_sink(video_sink), fps(0.0), frame_count(0), sample_interval(0), next_column(0) {
+    context.roi_mask = options.roi_mask;
+    context.sparse_log = options.sparse_log;
+    context.reduction_pool = options.parallel_reduction ? &GetSharedThreadPool() : nullptr;
+}
+
+bool ArtFrameAnalyzer::SupportsStyle(int style) {
+    return style != ART_STYLE_MOTION_VECTORS && !ArtStyleNeedsFollowingFrame(style);
+}
+
+bool ArtFrameAnalyzer::Begin(const FrameBusInfo& info, FrameSubscription& subscription) {
+    if (!SupportsStyle(options.style) || art_image.cols == 0 || info.frame_count <= 0)
+        return false;
+
+    movie_path = info.movie_path;
+    fps = info.fps;
+    frame_count = info.frame_count;
+    sample_interval = frame_count / art_image.cols;
+    next_column = 0;
+
+    // Movies with fewer frames than the image has columns show every frame, over several columns.
+    subscription.interval = max(sample_interval, 1);
+    subscription.count = sample_interval > 0 ? art_image.cols : frame_count;
+    subscription.width = options.reduction_width;
+
+    if (video_sink != nullptr)
+        video_sink->SyncToMovie(fps, sample_interval);
+
+    return true;
+}
+
+int ArtFrameAnalyzer::GetColumnFrame(int column_id) const {
+    if (sample_interval > 0)
+        return column_id * sample_interval;
+
+    return (int)((long long)column_id * frame_count / art_image.cols);
+}
+
+void ArtFrameAnalyzer::SkipColumns(int last_column, bool truncated) {
+    for (; next_column < last_column; next_column++) {
+        int column_frame = GetColumnFrame(next_column);
+
+        if (truncated) {
+            // Frame counts are estimated from the duration, so missing the very last sample is no damage.
+            if (column_frame + max(sample_interval, 1) < frame_count)
+                damage_log.AddColumn(next_column, column_frame, true);
+            continue;
+        }
+
+        damage_log.AddColumn(next_column, column_frame);
+
+        // Holds the last color until the damage can be blended, so the video doesn't flash black.
+        if (next_column > 0)
+            art_image.col(next_column - 1).copyTo(art_image.col(next_column));
+
+        if (video_sink != nullptr)
+            video_sink->AddColumn(art_image, next_column);
+    }
+}
+
+void ArtFrameAnalyzer::Analyze(int frame_index, const Mat& frame) {
+    int first_column = sample_interval > 0 ? frame_index / sample_interval : (int)(((long long)frame_index * art_image.cols + frame_count - 1) / frame_count);
+    int last_column = sample_interval > 0 ? first_column + 1 : (int)(((long long)(frame_index + 1) * art_image.cols + frame_count - 1) / frame_count);
+
+    last_column = min(last_column, art_image.cols);
+    SkipColumns(first_column, false);
+
+    // The reducers only read the frame.
+    Mat column_frame = frame;
+
+    for (; next_column < last_column; next_column++) {
+        if (next_column > first_column)
+            art_image.col(next_column - 1).copyTo(art_image.col(next_column));
+        else if (CreateArtColumn(column_frame, art_image, next_column, options.style, false, &context) != ART_COLUMN_OK) {
+            damage_log.AddColumn(next_column, frame_index);
+
+            if (next_column > 0)
+                art_image.col(next_column - 1).copyTo(art_image.col(next_column));
+        }
+
+        if (video_sink != nullptr) {
+            TraceSpan span("write column", frame_index, next_column);
+            video_sink->AddColumn(art_image, next_column);
+        }
+    }
+}
+
+void ArtFrameAnalyzer::Finish() {
+    // The frames after the last one analyzed were past the end of the movie.
+    SkipColumns(art_image.cols, true);
+
+    damage_log.FillFromNeighbours(art_image);
+    damage_log.Report(movie_path, fps);
+}
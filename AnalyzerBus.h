@@ -0,0 +1,147 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ANALYZER_BUS_H
+#define ANALYZER_BUS_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "ArtDamage.h"
+#include "ArtVideo.h"
+#include "MovieWallArt.h"
+
+// Frames the bus grabs through to reach the next wanted frame before it seeks instead.
+#define ANALYZER_BUS_MAX_GRAB_GAP 250
+
+/**
+ * What an analyzer knows about the movie before the first frame.
+ */
+struct FrameBusInfo {
+    std::string movie_path;
+    int frame_count = 0;
+    double fps = 0.0;
+    cv::Size frame_size;
+};
+
+/**
+ * The frames an analyzer wants: frame 0, interval, 2 * interval and so on.
+ */
+struct FrameSubscription {
+    int interval = 1;
+
+    // How many frames, or -1 to the end of the movie.
+    int count = -1;
+
+    // Frames are downscaled to this width before the analyzer sees them, or 0 to keep them at full resolution.
+    int width = 0;
+};
+
+/**
+ * Looks at the frames of a movie as the bus decodes them. Every analyzer gets its frames in order, one at a
+ * time, but on any thread and alongside the other analyzers. The frames are shared by the analyzers that
+ * want the same width, so they must only be read.
+ */
+class FrameAnalyzer {
+public:
+    virtual ~FrameAnalyzer() {}
+
+    /**
+     * @param info The movie.
+     * @param subscription Receives the frames the analyzer wants.
+     * @return False to leave the analyzer out of this movie.
+     */
+    virtual bool Begin(const FrameBusInfo& info, FrameSubscription& subscription) = 0;
+
+    virtual void Analyze(int frame_index, const cv::Mat& frame) = 0;
+
+    /**
+     * Called on the thread that ran the bus, once the last frame was analyzed.
+     */
+    virtual void Finish() {}
+};
+
+/**
+ * Decodes a movie once for any number of analyzers. Each frame is decoded when some analyzer wants it,
+ * scaled once per width wanted, and analyzed by every analyzer that wants it on the shared pool, while
+ * the next wanted frame is decoded.
+ */
+class AnalyzerBus {
+public:
+    void Add(FrameAnalyzer* analyzer);
+
+    /**
+     * @param movie_path The path to the movie.
+     * @param options The decoding settings, the memory job and the decoder threads.
+     * @return False when the movie can't be opened or no analyzer wants it.
+     */
+    bool Run(const std::string& movie_path, const ArtRenderOptions& options);
+
+private:
+    std::vector<FrameAnalyzer*> analyzers;
+};
+
+/**
+ * Renders the art image of a movie on the bus, the same as CreateMovieWallArt without a preview.
+ */
+class ArtFrameAnalyzer : public FrameAnalyzer {
+public:
+    /**
+     * @param art_image A reference to the image being created.
+     * @param options The style and the settings of the render.
+     * @param video_sink Optional sink that encodes a video out of the columns as they are created.
+     */
+    ArtFrameAnalyzer(cv::Mat& art_image, const ArtRenderOptions& options, ArtVideoSink* video_sink = nullptr);
+
+    /**
+     * Whether a style can be rendered on the bus. The styles that look at the following frame and the motion
+     * vector style read the movie their own way.
+     */
+    static bool SupportsStyle(int style);
+
+    bool Begin(const FrameBusInfo& info, FrameSubscription& subscription) override;
+    void Analyze(int frame_index, const cv::Mat& frame) override;
+    void Finish() override;
+
+private:
+    int GetColumnFrame(int column_id) const;
+
+    /**
+     * Logs the columns up to last_column that got no frame. Damaged ones repeat the column on their left
+     * until they are blended, the ones after the end of the movie are left alone.
+     */
+    void SkipColumns(int last_column, bool truncated);
+
+    cv::Mat& art_image;
+    const ArtRenderOptions& options;
+    ArtVideoSink* video_sink;
+    ArtColumnContext context;
+    ArtDamageLog damage_log;
+
+    std::string movie_path;
+    double fps;
+    int frame_count;
+    int sample_interval;
+
+    // The first column no frame was analyzed for yet.
+    int next_column;
+};
+
+#endif // !ANALYZER_BUS_H
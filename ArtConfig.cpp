@@ -0,0 +1,491 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "ArtConfig.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+ArtConfig::ArtConfig()
+    : movie_path("path/to/your/movie.mp4"), art_path("path/to/your/art.png"), art_width(1920), art_height(1080),
+      threads(0), memory_budget_mb(0), block_seconds(0.0), detect_static_overlays(false),
+      video_mode(ART_VIDEO_NONE), video_path("path/to/your/art.mp4"), video_size(1920, 1080), video_fps(30.0), video_window(240),
+      distributed_workers(0), shard_columns(0), shard_attempts(3), keep_fragments(false), worker_first_column(-1), worker_last_column(-1),
+      proxy(false), proxy_validate(false), qc(false), qc_interval(1) {
+    synthetic.duration_seconds = 600.0;
+    synthetic.fourcc = "avc1";
+    synthetic.keyframe_interval = 48;
+    synthetic.letterbox_ratio = 2.39;
+}
+
+static string TrimConfigText(const string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+
+    if (begin == string::npos)
+        return "";
+
+    size_t end = text.find_last_not_of(" \t\r\n");
+
+    return text.substr(begin, end - begin + 1);
+}
+
+static bool ReadConfigInt(const string& value, int& result) {
+    try {
+        size_t used = 0;
+        result = stoi(value, &used);
+        return used == value.size();
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+static bool ReadConfigPositiveInt(const string& value, int& result) {
+    int number;
+
+    if (!ReadConfigInt(value, number) || number <= 0)
+        return false;
+
+    result = number;
+    return true;
+}
+
+static bool ReadConfigDouble(const string& value, double& result) {
+    try {
+        size_t used = 0;
+        result = stod(value, &used);
+        return used == value.size();
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+static bool ReadConfigBool(const string& value, bool& result) {
+    if (value == "true" || value == "yes" || value == "1") {
+        result = true;
+        return true;
+    }
+
+    if (value == "false" || value == "no" || value == "0") {
+        result = false;
+        return true;
+    }
+
+    return false;
+}
+
+static bool ReadConfigStyle(const string& value, int& style) {
+    const char* names[] = { "center_pixel", "average_color", "pixel_strip", "edge_energy", "detail_density", "motion_energy",
+                            "motion_vectors", "sparse_average" };
+    const int styles[] = { ART_STYLE_CENTER_PIXEL, ART_STYLE_AVERAGE_COLOR, ART_STYLE_PIXEL_STRIP,
+                           ART_STYLE_EDGE_ENERGY, ART_STYLE_DETAIL_DENSITY, ART_STYLE_MOTION_ENERGY,
+                           ART_STYLE_MOTION_VECTORS, ART_STYLE_SPARSE_AVERAGE };
+
+    for (int i = 0; i < 8; i++) {
+        if (value == names[i]) {
+            style = styles[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Reads an extra art written as "path,width,height" or "path,width,height,style".
+ */
+static bool ReadConfigExtraArt(const string& value, ExtraArtConfig& extra_art) {
+    vector<string> parts;
+    stringstream stream(value);
+    string part;
+
+    while (getline(stream, part, ','))
+        parts.push_back(TrimConfigText(part));
+
+    if (parts.size() < 3 || parts.size() > 4 || parts[0].empty())
+        return false;
+
+    extra_art.art_path = parts[0];
+
+    if (!ReadConfigPositiveInt(parts[1], extra_art.art_width) || !ReadConfigPositiveInt(parts[2], extra_art.art_height))
+        return false;
+
+    return parts.size() < 4 || ReadConfigStyle(parts[3], extra_art.style);
+}
+
+/**
+ * Reads an exclusion written as "x,y,width,height", in fractions of the frame.
+ */
+static bool ReadConfigExclusion(const string& value, RoiExclusion& exclusion) {
+    float parts[4];
+    stringstream stream(value);
+    string part;
+
+    for (int i = 0; i < 4; i++) {
+        double number;
+
+        if (!getline(stream, part, ',') || !ReadConfigDouble(TrimConfigText(part), number))
+            return false;
+
+        parts[i] = (float)number;
+    }
+
+    if (getline(stream, part, ','))
+        return false;
+
+    exclusion.x = parts[0];
+    exclusion.y = parts[1];
+    exclusion.width = parts[2];
+    exclusion.height = parts[3];
+
+    return true;
+}
+
+bool SetArtConfigValue(ArtConfig& config, const string& key, const string& value) {
+    bool valid = true;
+
+    if (key == "movie")
+        config.movie_path = value;
+    else if (key == "art")
+        config.art_path = value;
+    else if (key == "width")
+        valid = ReadConfigPositiveInt(value, config.art_width);
+    else if (key == "height")
+        valid = ReadConfigPositiveInt(value, config.art_height);
+    else if (key == "style")
+        valid = ReadConfigStyle(value, config.render.style);
+    else if (key == "threads")
+        valid = ReadConfigInt(value, config.threads);
+    else if (key == "memory-budget")
+        valid = ReadConfigInt(value, config.memory_budget_mb) && config.memory_budget_mb >= 0;
+    else if (key == "decoder-threads")
+        valid = ReadConfigInt(value, config.render.decoder_threads);
+    else if (key == "sampling") {
+        if (value == "seek")
+            config.render.sampling = ART_SAMPLING_SEEK;
+        else if (value == "sequential")
+            config.render.sampling = ART_SAMPLING_SEQUENTIAL;
+        else if (value == "gop")
+            config.render.sampling = ART_SAMPLING_GOP;
+        else
+            valid = false;
+    }
+    else if (key == "reduction-width")
+        valid = ReadConfigInt(value, config.render.reduction_width);
+    else if (key == "dc-average")
+        valid = ReadConfigBool(value, config.render.dc_average);
+    else if (key == "parallel-reduction")
+        valid = ReadConfigBool(value, config.render.parallel_reduction);
+    else if (key == "motion-directions")
+        valid = ReadConfigBool(value, config.render.motion_directions);
+    else if (key == "preview")
+        valid = ReadConfigBool(value, config.render.preview);
+    else if (key == "extra-art") {
+        ExtraArtConfig extra_art;
+        extra_art.style = config.render.style;
+        valid = ReadConfigExtraArt(value, extra_art);
+
+        if (valid)
+            config.extra_arts.push_back(extra_art);
+    }
+    else if (key == "compare")
+        config.comparison_paths.push_back(value);
+    else if (key == "chapters")
+        config.chapters_path = value;
+    else if (key == "block-seconds")
+        valid = ReadConfigDouble(value, config.block_seconds);
+    else if (key == "exclude") {
+        RoiExclusion exclusion;
+        valid = ReadConfigExclusion(value, exclusion);
+
+        if (valid)
+            config.roi_exclusions.push_back(exclusion);
+    }
+    else if (key == "detect-overlays")
+        valid = ReadConfigBool(value, config.detect_static_overlays);
+    else if (key == "video-mode") {
+        if (value == "none")
+            config.video_mode = ART_VIDEO_NONE;
+        else if (value == "build_up")
+            config.video_mode = ART_VIDEO_BUILD_UP;
+        else if (value == "moving_barcode")
+            config.video_mode = ART_VIDEO_MOVING_BARCODE;
+        else
+            valid = false;
+    }
+    else if (key == "video")
+        config.video_path = value;
+    else if (key == "video-width")
+        valid = ReadConfigPositiveInt(value, config.video_size.width);
+    else if (key == "video-height")
+        valid = ReadConfigPositiveInt(value, config.video_size.height);
+    else if (key == "video-fps")
+        valid = ReadConfigDouble(value, config.video_fps);
+    else if (key == "video-window")
+        valid = ReadConfigInt(value, config.video_window);
+    else if (key == "workers")
+        valid = ReadConfigInt(value, config.distributed_workers) && config.distributed_workers >= 0;
+    else if (key == "worker-command")
+        config.worker_commands.push_back(value);
+    else if (key == "shard-columns")
+        valid = ReadConfigInt(value, config.shard_columns) && config.shard_columns >= 0;
+    else if (key == "shard-attempts")
+        valid = ReadConfigPositiveInt(value, config.shard_attempts);
+    else if (key == "fragment-dir")
+        config.fragment_dir = value;
+    else if (key == "keep-fragments")
+        valid = ReadConfigBool(value, config.keep_fragments);
+    else if (key == "worker-shard") {
+        char separator = 0;
+        istringstream shard(value);
+        valid = (bool)(shard >> config.worker_first_column >> separator >> config.worker_last_column) && separator == ','
+                && config.worker_first_column >= 0 && config.worker_last_column > config.worker_first_column;
+    }
+    else if (key == "fragment")
+        config.fragment_path = value;
+    else if (key == "proxy")
+        valid = ReadConfigBool(value, config.proxy);
+    else if (key == "proxy-validate")
+        valid = ReadConfigBool(value, config.proxy_validate);
+    else if (key == "qc")
+        valid = ReadConfigBool(value, config.qc);
+    else if (key == "qc-interval")
+        valid = ReadConfigPositiveInt(value, config.qc_interval);
+    else if (key == "sparse-errors")
+        config.sparse_errors_path = value;
+    else if (key == "sprites")
+        config.sprites.vtt_path = value;
+    else if (key == "sprite-seconds")
+        valid = ReadConfigDouble(value, config.sprites.seconds) && config.sprites.seconds > 0.0;
+    else if (key == "sprite-width")
+        valid = ReadConfigPositiveInt(value, config.sprites.thumbnail_width);
+    else if (key == "trace")
+        config.trace_path = value;
+    else if (key == "fingerprint")
+        config.fingerprint_path = value;
+    else if (key == "fingerprint-rate")
+        valid = ReadConfigDouble(value, config.fingerprint_rate) && config.fingerprint_rate > 0.0;
+    else if (key == "align") {
+        size_t comma = value.find(',');
+        valid = comma != string::npos && comma > 0 && comma + 1 < value.size();
+
+        if (valid) {
+            config.align_first_path = value.substr(0, comma);
+            config.align_second_path = value.substr(comma + 1);
+        }
+    }
+    else if (key == "map-time") {
+        double seconds = 0.0;
+        valid = ReadConfigDouble(value, seconds) && seconds >= 0.0;
+
+        if (valid)
+            config.map_times.push_back(seconds);
+    }
+    else if (key == "range") {
+        size_t comma = value.find(',');
+        double first_seconds = 0.0;
+        double last_seconds = 0.0;
+        valid = comma != string::npos && ReadConfigDouble(TrimConfigText(value.substr(0, comma)), first_seconds)
+                && ReadConfigDouble(TrimConfigText(value.substr(comma + 1)), last_seconds) && first_seconds >= 0.0 && last_seconds > first_seconds;
+
+        if (valid)
+            config.ranges.push_back(make_pair(first_seconds, last_seconds));
+    }
+    else if (key == "locate") {
+        size_t comma = value.find(',');
+        valid = comma != string::npos && comma > 0 && comma + 1 < value.size();
+
+        if (valid) {
+            config.locate_trailer_path = value.substr(0, comma);
+            config.locate_feature_path = value.substr(comma + 1);
+        }
+    }
+    else if (key == "synthetic")
+        config.synthetic_path = value;
+    else if (key == "synthetic-seconds")
+        valid = ReadConfigDouble(value, config.synthetic.duration_seconds);
+    else if (key == "synthetic-width")
+        valid = ReadConfigPositiveInt(value, config.synthetic.frame_size.width);
+    else if (key == "synthetic-height")
+        valid = ReadConfigPositiveInt(value, config.synthetic.frame_size.height);
+    else if (key == "synthetic-fourcc") {
+        if (value.size() == 4)
+            config.synthetic.fourcc = value;
+        else
+            valid = false;
+    }
+    else if (key == "synthetic-keyframe-interval")
+        valid = ReadConfigInt(value, config.synthetic.keyframe_interval);
+    else if (key == "synthetic-letterbox-ratio")
+        valid = ReadConfigDouble(value, config.synthetic.letterbox_ratio);
+    else if (key == "synthetic-vfr")
+        valid = ReadConfigBool(value, config.synthetic.variable_frame_rate);
+    else {
+        cout << "Unknown setting: " << key << endl;
+        return false;
+    }
+
+    if (!valid)
+        cout << "Invalid value for " << key << ": " << value << endl;
+
+    return valid;
+}
+
+bool LoadArtConfigFile(const string& config_path, ArtConfig& config) {
+    ifstream file(config_path);
+
+    if (!file.is_open()) {
+        cout << "Error opening config file: " << config_path << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+
+    while (getline(file, line)) {
+        line_number++;
+        line = TrimConfigText(line);
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t separator = line.find('=');
+
+        if (separator == string::npos) {
+            cout << "Expected key = value in " << config_path << ", line " << line_number << "." << endl;
+            return false;
+        }
+
+        string key = TrimConfigText(line.substr(0, separator));
+        string value = TrimConfigText(line.substr(separator + 1));
+
+        if (!SetArtConfigValue(config, key, value)) {
+            cout << "In " << config_path << ", line " << line_number << "." << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ParseArtConfig(int argc, char** argv, ArtConfig& config) {
+    if (argc > 0)
+        config.executable_path = argv[0];
+
+    config.arguments.assign(argv + min(argc, 1), argv + argc);
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+
+        if (argument == "--help" || argument == "-h") {
+            PrintArtConfigUsage();
+            return false;
+        }
+
+        if (argument.compare(0, 2, "--") != 0) {
+            cout << "Unexpected argument: " << argument << endl;
+            PrintArtConfigUsage();
+            return false;
+        }
+
+        string key = argument.substr(2);
+        string value;
+        size_t separator = key.find('=');
+
+        if (separator != string::npos) {
+            value = key.substr(separator + 1);
+            key = key.substr(0, separator);
+        }
+        else if (i + 1 < argc) {
+            value = argv[++i];
+        }
+        else {
+            cout << "Missing value for " << key << endl;
+            return false;
+        }
+
+        bool valid = key == "config" ? LoadArtConfigFile(value, config) : SetArtConfigValue(config, key, value);
+
+        if (!valid)
+            return false;
+    }
+
+    return true;
+}
+
+void PrintArtConfigUsage() {
+    cout << "Usage: MovieWallArt [--config file] [--key value]..." << endl
+         << endl
+         << "  --movie path                  Movie to render." << endl
+         << "  --art path                    Image to write." << endl
+         << "  --width, --height pixels      Size of the art (1920x1080)." << endl
+         << "  --style name                  center_pixel, average_color, pixel_strip, edge_energy," << endl
+         << "                                detail_density, motion_energy, motion_vectors or sparse_average" << endl
+         << "                                (pixel_strip)." << endl
+         << "  --threads n                   Workers of the comparison and grid layouts (one per available core)." << endl
+         << "  --memory-budget mb            Resident memory the renders should stay within (no limit)." << endl
+         << "  --decoder-threads n           FFmpeg threads of each capture (the cores left per worker)." << endl
+         << "  --sampling seek|sequential|gop" << endl
+         << "                                Seek to every sample, decode through, or seek once per GOP (seek)." << endl
+         << "  --reduction-width pixels      Downscale frames before reducing them (full resolution)." << endl
+         << "  --dc-average true|false       Experimental: read MJPEG from its DC coefficients (false)." << endl
+         << "  --parallel-reduction true|false  Split every frame among the threads, for single renders (false)." << endl
+         << "  --motion-directions true|false  Color motion_vectors by the direction of the motion (false)." << endl
+         << "  --preview true|false          Show the art while rendering (true)." << endl
+         << "  --extra-art path,w,h[,style]  Also render the movie at another size or style, sharing the decode." << endl
+         << "  --compare path                Add a movie to a comparison, once per movie." << endl
+         << "  --chapters path               FFMETADATA chapters for the grid layout." << endl
+         << "  --block-seconds s             Duration of each grid band without chapters." << endl
+         << "  --exclude x,y,w,h             Leave a part of the frame out, in fractions of the frame." << endl
+         << "  --detect-overlays true|false  Leave out logos and letterbox bars (false)." << endl
+         << "  --video-mode mode             none, build_up or moving_barcode (none)." << endl
+         << "  --video path                  Video of the art to write." << endl
+         << "  --video-width, --video-height, --video-fps, --video-window" << endl
+         << "  --workers n                   Render in shards on n worker processes (0, in this process)." << endl
+         << "  --worker-command command      Add a remote worker slot, run as \"command MovieWallArt ...\"." << endl
+         << "  --shard-columns n             Columns per shard (four shards per worker)." << endl
+         << "  --shard-attempts n            Times a shard is tried before it is left black (3)." << endl
+         << "  --fragment-dir path           Shared directory for the fragments (next to the art)." << endl
+         << "  --keep-fragments true|false   Keep the fragments after merging them (false)." << endl
+         << "  --proxy true|false            Render from a small proxy of the movie, written on the first render (false)." << endl
+         << "  --proxy-validate true|false   Report how far the proxy is from the movie (false)." << endl
+         << "  --qc true|false               Report black and frozen frames, found in the same decode as the art (false)." << endl
+         << "  --qc-interval n               Frames between the frames checked (1)." << endl
+         << "  --sparse-errors path.csv      Write the error bound of every sparse_average column." << endl
+         << "  --sprites path.vtt            Write player thumbnail sprites and their WebVTT cues." << endl
+         << "  --sprite-seconds s            Time between the thumbnails (2)." << endl
+         << "  --sprite-width n              Width of the thumbnails (160)." << endl
+         << "  --trace path                  Write a Chrome trace of every frame through the pipeline." << endl
+         << "  --range from,to               Render only this range of the movie, in seconds, once per range." << endl
+         << "  --fingerprint path            Write the timeline fingerprint of the movie instead of creating art." << endl
+         << "  --fingerprint-rate n          Fingerprint samples per second of movie, 4 for trailers and their features (1)." << endl
+         << "  --align first,second          Tell whether two fingerprints are the same movie and align them." << endl
+         << "  --map-time s                  Map a time of the first aligned movie to the second, once per time." << endl
+         << "  --locate trailer,feature      Find the shots of a trailer fingerprint in the fingerprint of the feature." << endl
+         << "  --synthetic path              Write a synthetic movie instead of creating art." << endl
+         << "  --synthetic-seconds, --synthetic-width, --synthetic-height, --synthetic-fourcc," << endl
+         << "  --synthetic-keyframe-interval, --synthetic-letterbox-ratio, --synthetic-vfr" << endl
+         << endl
+         << "Config files take the same keys without the dashes, one \"key = value\" per line." << endl;
+}
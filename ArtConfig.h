@@ -0,0 +1,173 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ART_CONFIG_H
+#define ART_CONFIG_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ArtVideo.h"
+#include "MovieWallArt.h"
+#include "RoiMask.h"
+#include "SpriteSheet.h"
+#include "SyntheticMovie.h"
+#include "TimelineFingerprint.h"
+
+/**
+ * Another art image of the same movie, rendered at the same time and sharing its decode.
+ */
+struct ExtraArtConfig {
+    std::string art_path;
+    int art_width = 0;
+    int art_height = 0;
+    int style = ART_STYLE_PIXEL_STRIP;
+};
+
+/**
+ * Everything a run of the program can be told, read from a config file and the command line.
+ */
+struct ArtConfig {
+    ArtConfig();
+
+    std::string movie_path;
+    std::string art_path;
+    int art_width;
+    int art_height;
+
+    // Style, decoder threads, sampling strategy, reduction resolution and preview of every render.
+    ArtRenderOptions render;
+
+    // Workers of the shared thread pool used by the comparison and grid layouts, or 0 for one per available core.
+    int threads;
+
+    // Resident memory the renders of the process should stay within, or 0 for no limit.
+    int memory_budget_mb;
+
+    // More art images of movie_path, in other sizes or styles. They all decode the movie once.
+    std::vector<ExtraArtConfig> extra_arts;
+
+    // Movies stacked as bands of rows in one art image. Empty renders movie_path alone.
+    std::vector<std::string> comparison_paths;
+
+    // Grid layout, one band of rows per chapter or per block of time. Both empty render a single strip.
+    std::string chapters_path;
+    double block_seconds;
+
+    std::vector<RoiExclusion> roi_exclusions;
+    bool detect_static_overlays;
+
+    int video_mode;
+    std::string video_path;
+    cv::Size video_size;
+    double video_fps;
+    int video_window;
+
+    // Distributed render: local worker processes, plus one remote slot per worker command, like "ssh render2".
+    int distributed_workers;
+    std::vector<std::string> worker_commands;
+    int shard_columns;
+    int shard_attempts;
+
+    // Where the fragments are written, a directory every host sees. Empty writes them next to the art.
+    std::string fragment_dir;
+    bool keep_fragments;
+
+    // Set on the worker processes: the columns to render and the fragment to write them to.
+    int worker_first_column;
+    int worker_last_column;
+    std::string fragment_path;
+
+    // The program and the settings it was started with, passed on to the worker processes.
+    std::string executable_path;
+    std::vector<std::string> arguments;
+
+    // Renders from the proxy of the movie when it has one, and writes one while rendering when it hasn't.
+    bool proxy;
+
+    // Compares columns made from the proxy with columns made from the movie after the render.
+    bool proxy_validate;
+
+    // Looks for black and frozen frames in the same decode as the art, every qc_interval frames.
+    bool qc;
+    int qc_interval;
+
+    // Writes the samples and the error bound of every column of the sparse_average style here, when set.
+    std::string sparse_errors_path;
+
+    // Writes player thumbnails from the samples of the art, when the WebVTT path is set.
+    SpriteSheetOptions sprites;
+
+    // Writes a Chrome trace of the render pipeline here, when set.
+    std::string trace_path;
+
+    // Writes the timeline fingerprint of the movie here instead of creating art, when set.
+    std::string fingerprint_path;
+    double fingerprint_rate = FINGERPRINT_SAMPLES_PER_SECOND;
+
+    // Aligns two fingerprints instead of creating art, when set, and maps these times, in seconds, from the first to the second.
+    std::string align_first_path;
+    std::string align_second_path;
+    std::vector<double> map_times;
+
+    // Renders the art of these ranges of the movie, from and to in seconds, instead of the whole movie, when set.
+    // See RangeRender.h.
+    std::vector<std::pair<double, double>> ranges;
+
+    // Finds the shots of the first fingerprint, a trailer, in the second one instead of creating art, when set.
+    std::string locate_trailer_path;
+    std::string locate_feature_path;
+
+    // Writes a synthetic movie here instead of creating art, when set.
+    std::string synthetic_path;
+    SyntheticMovieConfig synthetic;
+};
+
+/**
+ * Sets one value of the config, as named in config files and on the command line without the dashes.
+ * "compare" and "exclude" add one more movie or exclusion every time they are set.
+ *
+ * @param config A reference to the config being read.
+ * @param key The name of the setting, like "width" or "reduction-width".
+ * @param value The value as text.
+ * @return Whether the key exists and the value could be read.
+ */
+bool SetArtConfigValue(ArtConfig& config, const std::string& key, const std::string& value);
+
+/**
+ * Reads a config file with one "key = value" per line. Lines starting with # are comments.
+ *
+ * @param config_path The path to the config file.
+ * @param config A reference to the config being read.
+ */
+bool LoadArtConfigFile(const std::string& config_path, ArtConfig& config);
+
+/**
+ * Reads the command line, as "--key value" or "--key=value". "--config path" reads a config file at that
+ * point, so the options after it override the file.
+ *
+ * @return Whether the program should run. False on errors and after printing the usage.
+ */
+bool ParseArtConfig(int argc, char** argv, ArtConfig& config);
+
+void PrintArtConfigUsage();
+
+#endif // !ART_CONFIG_H
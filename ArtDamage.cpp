@@ -0,0 +1,140 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "ArtDamage.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+void ArtDamageLog::AddColumn(int column_id, int frame, bool truncated) {
+    lock_guard<mutex> lock(ranges_mutex);
+
+    // Segments log their columns in order, so a column usually extends a range its segment started.
+    for (ArtDamagedRange& range : ranges) {
+        if (range.last_column == column_id && range.truncated == truncated) {
+            range.last_column = column_id + 1;
+            range.last_frame = max(range.last_frame, frame + 1);
+            return;
+        }
+    }
+
+    ArtDamagedRange range;
+    range.first_column = column_id;
+    range.last_column = column_id + 1;
+    range.first_frame = frame;
+    range.last_frame = frame + 1;
+    range.truncated = truncated;
+
+    ranges.push_back(range);
+}
+
+bool ArtDamageLog::IsEmpty() {
+    lock_guard<mutex> lock(ranges_mutex);
+    return ranges.empty();
+}
+
+vector<ArtDamagedRange> ArtDamageLog::GetRanges() {
+    lock_guard<mutex> lock(ranges_mutex);
+
+    vector<ArtDamagedRange> sorted = ranges;
+    sort(sorted.begin(), sorted.end(), [](const ArtDamagedRange& a, const ArtDamagedRange& b) {
+        return a.first_column < b.first_column;
+    });
+
+    // Ranges split between two segments are joined back.
+    vector<ArtDamagedRange> merged;
+
+    for (const ArtDamagedRange& range : sorted) {
+        if (!merged.empty() && merged.back().last_column == range.first_column && merged.back().truncated == range.truncated) {
+            merged.back().last_column = range.last_column;
+            merged.back().last_frame = max(merged.back().last_frame, range.last_frame);
+        }
+        else {
+            merged.push_back(range);
+        }
+    }
+
+    return merged;
+}
+
+void ArtDamageLog::FillFromNeighbours(Mat& art_image) {
+    vector<ArtDamagedRange> damaged = GetRanges();
+    vector<bool> bad_columns(art_image.cols, false);
+
+    for (const ArtDamagedRange& range : damaged) {
+        for (int x = max(0, range.first_column); x < min(art_image.cols, range.last_column); x++)
+            bad_columns[x] = true;
+    }
+
+    for (const ArtDamagedRange& range : damaged) {
+        if (range.truncated)
+            continue;
+
+        int left = range.first_column - 1;
+        int right = range.last_column;
+
+        while (left >= 0 && bad_columns[left])
+            left--;
+
+        while (right < art_image.cols && bad_columns[right])
+            right++;
+
+        if (left < 0 && right >= art_image.cols)
+            continue;
+
+        for (int x = max(0, range.first_column); x < min(art_image.cols, range.last_column); x++) {
+            // Only one side left: hold its color.
+            int from = left >= 0 ? left : right;
+            int to = right < art_image.cols ? right : left;
+            float t = from == to ? 0.0f : (float)(x - from) / (to - from);
+
+            for (int y = 0; y < art_image.rows; y++) {
+                const Vec3b& a = art_image.at<Vec3b>(y, from);
+                const Vec3b& b = art_image.at<Vec3b>(y, to);
+
+                art_image.at<Vec3b>(y, x) = Vec3b((uchar)(a[0] + (b[0] - a[0]) * t + 0.5f),
+                                                  (uchar)(a[1] + (b[1] - a[1]) * t + 0.5f),
+                                                  (uchar)(a[2] + (b[2] - a[2]) * t + 0.5f));
+            }
+        }
+    }
+}
+
+void ArtDamageLog::Report(const string& movie_path, double fps) {
+    vector<ArtDamagedRange> damaged = GetRanges();
+
+    if (damaged.empty())
+        return;
+
+    cout << "Damaged frames in " << movie_path << ":" << endl;
+
+    for (const ArtDamagedRange& range : damaged) {
+        cout << "  columns " << range.first_column << "-" << range.last_column - 1
+             << ", frames " << range.first_frame << "-" << range.last_frame - 1;
+
+        if (fps > 0.0)
+            cout << fixed << setprecision(1) << " (" << range.first_frame / fps << "s-" << range.last_frame / fps << "s)" << defaultfloat;
+
+        cout << (range.truncated ? ", the movie ends early" : ", filled from the neighbours") << endl;
+    }
+}
@@ -0,0 +1,78 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ART_DAMAGE_H
+#define ART_DAMAGE_H
+
+#include "opencv2/opencv.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A run of consecutive art columns whose frames could not be decoded.
+ */
+struct ArtDamagedRange {
+    int first_column;
+    int last_column;
+    int first_frame;
+    int last_frame;
+
+    // The movie ended before the frames it reports, so there is nothing to the right to fill the columns from.
+    bool truncated;
+};
+
+/**
+ * Collects the columns of a render left without a frame, so they can be filled once the whole image
+ * is rendered and summed up at the end. Several segments of a render may log to the same one at once.
+ */
+class ArtDamageLog {
+public:
+    /**
+     * @param column_id The column left without a frame.
+     * @param frame The frame that could not be decoded for it.
+     * @param truncated Whether the movie ended before that frame.
+     */
+    void AddColumn(int column_id, int frame, bool truncated = false);
+
+    bool IsEmpty();
+    std::vector<ArtDamagedRange> GetRanges();
+
+    /**
+     * Fills the damaged columns with a blend of the closest good columns on each side. Columns of a truncated
+     * end are left alone, there are no frames after them to blend with.
+     *
+     * @param art_image A reference to the image, or the band of rows of it, the columns were logged for.
+     */
+    void FillFromNeighbours(cv::Mat& art_image);
+
+    /**
+     * Prints the damaged ranges, in columns and in frames.
+     *
+     * @param movie_path The path to the movie, to tell the summaries of several movies apart.
+     * @param fps The frame rate of the movie, to print the ranges as times too. Ignored when 0.
+     */
+    void Report(const std::string& movie_path, double fps = 0.0);
+
+private:
+    std::mutex ranges_mutex;
+    std::vector<ArtDamagedRange> ranges;
+};
+
+#endif // !ART_DAMAGE_H
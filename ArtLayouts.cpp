@@ -0,0 +1,329 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "ArtLayouts.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "MovieWallArt.h"
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Waits for the render tasks while refreshing the preview, which only the main thread may do.
+ *
+ * @param jobs The render tasks queued on the thread pool.
+ * @param art_image A reference to the image the tasks are writing to.
+ * @param preview Whether to show the art being rendered. Without it no window is opened, for headless hosts.
+ */
+static void WaitForArtJobs(vector<future<void>>& jobs, Mat& art_image, bool preview) {
+    for (future<void>& job : jobs) {
+        while (preview && job.wait_for(chrono::milliseconds(100)) != future_status::ready) {
+            imshow("RENDERING...", art_image);
+            waitKey(1);
+        }
+
+        job.get();
+    }
+
+    if (preview) {
+        imshow("RENDERING...", art_image);
+        waitKey(1);
+    }
+}
+
+/**
+ * Queues the render of a band of rows of the art, split in column segments so it can spread over several workers.
+ *
+ * @param pool The thread pool that renders the segments.
+ * @param movie_path The path to the movie that is going to be processed.
+ * @param band A reference to the band of rows of the art image.
+ * @param segment The range of movie frames shown by the band.
+ * @param segment_count How many column segments to split the band in.
+ * @param options The style and the decoding settings of the render.
+ * @param jobs The list that receives the queued tasks.
+ */
+static void EnqueueArtBand(ThreadPool& pool, const string& movie_path, Mat& band, const MovieSegment& segment,
+                           int segment_count, const ArtRenderOptions& options, vector<future<void>>& jobs) {
+    int art_w = band.cols;
+    int first_frame = segment.first_frame;
+    int last_frame = segment.last_frame;
+
+    // Worker threads can't show anything, and the segments already keep every worker busy.
+    ArtRenderOptions band_options = options;
+    band_options.preview = false;
+    band_options.parallel_reduction = false;
+
+    segment_count = min(max(segment_count, 1), art_w);
+
+    for (int s = 0; s < segment_count; s++) {
+        int first_column = s * art_w / segment_count;
+        int last_column = (s + 1) * art_w / segment_count;
+
+        jobs.push_back(pool.Enqueue([=]() mutable {
+            RenderArtColumns(movie_path, band, first_column, last_column, band_options, first_frame, last_frame);
+        }));
+    }
+}
+
+vector<MovieSegment> ReadMovieChapters(const string& chapters_path, double fps) {
+    vector<MovieSegment> chapters;
+    ifstream file(chapters_path);
+
+    if (!file.is_open()) {
+        cout << "Error opening chapters file: " << chapters_path << endl;
+        return chapters;
+    }
+
+    string line;
+    bool in_chapter = false;
+    long long timebase_num = 1;
+    long long timebase_den = 1000;
+    long long start = -1;
+    long long end = -1;
+    string title;
+
+    // Chapters are only complete when the next section starts, or at the end of the file.
+    auto close_chapter = [&]() {
+        if (in_chapter && start >= 0 && end > start) {
+            MovieSegment chapter;
+            chapter.first_frame = (int)(start * timebase_num * fps / timebase_den);
+            chapter.last_frame = (int)(end * timebase_num * fps / timebase_den);
+            chapter.title = title;
+            chapters.push_back(chapter);
+        }
+
+        in_chapter = false;
+        timebase_num = 1;
+        timebase_den = 1000;
+        start = -1;
+        end = -1;
+        title.clear();
+    };
+
+    int line_number = 0;
+
+    while (getline(file, line)) {
+        line_number++;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.empty() || line[0] == ';' || line[0] == '#')
+            continue;
+
+        if (line[0] == '[') {
+            close_chapter();
+            in_chapter = line == "[CHAPTER]";
+            continue;
+        }
+
+        if (!in_chapter)
+            continue;
+
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+            continue;
+
+        string key = line.substr(0, equals);
+        string value = line.substr(equals + 1);
+
+        if (key == "TIMEBASE") {
+            char slash;
+            istringstream timebase(value);
+            timebase >> timebase_num >> slash >> timebase_den;
+
+            if (timebase_num <= 0 || timebase_den <= 0) {
+                timebase_num = 1;
+                timebase_den = 1000;
+            }
+        }
+        else if (key == "START" || key == "END") {
+            const char* text = value.c_str();
+            char* parsed_end = nullptr;
+            errno = 0;
+            long long time = strtoll(text, &parsed_end, 10);
+
+            if (parsed_end == text || *parsed_end != '\0' || errno == ERANGE) {
+                cout << "Error reading chapters file " << chapters_path << ", bad time at line " << line_number << ": " << line << endl;
+                return vector<MovieSegment>();
+            }
+
+            if (key == "START")
+                start = time;
+            else
+                end = time;
+        }
+        else if (key == "title") {
+            title = value;
+        }
+    }
+
+    close_chapter();
+
+    return chapters;
+}
+
+vector<MovieSegment> SplitMovieTimeBlocks(int frame_count, double fps, double block_seconds) {
+    vector<MovieSegment> blocks;
+    int block_frames = max(1, (int)(block_seconds * fps));
+
+    for (int first_frame = 0; first_frame < frame_count; first_frame += block_frames) {
+        MovieSegment block;
+        block.first_frame = first_frame;
+        block.last_frame = first_frame + block_frames;
+        blocks.push_back(block);
+    }
+
+    return blocks;
+}
+
+void CreateComparisonWallArt(const vector<string>& movie_paths, Mat& art_image, const ArtRenderOptions& options, const vector<RoiMask>& roi_masks) {
+    if (movie_paths.empty())
+        return;
+
+    ThreadPool& pool = GetSharedThreadPool();
+
+    int movie_count = (int)movie_paths.size();
+    int art_h = art_image.rows;
+
+    // A few segments per worker keep every thread busy until the end, even if one movie seeks slower.
+    int segment_count = (pool.GetThreadCount() * 2 + movie_count - 1) / movie_count;
+
+    vector<future<void>> jobs;
+
+    // Every movie reports its own peak memory and damage. Deques keep them in place while they grow.
+    deque<MemoryJob> memory_jobs;
+    deque<ArtDamageLog> damage_logs;
+    vector<Mat> bands;
+
+    for (int m = 0; m < movie_count; m++) {
+        Mat band = art_image.rowRange(m * art_h / movie_count, (m + 1) * art_h / movie_count);
+
+        MovieSegment whole_movie;
+        whole_movie.first_frame = 0;
+        whole_movie.last_frame = -1;
+
+        ArtRenderOptions movie_options = options;
+        movie_options.roi_mask = m < (int)roi_masks.size() ? &roi_masks[m] : nullptr;
+
+        memory_jobs.emplace_back(movie_paths[m]);
+        movie_options.memory_job = &memory_jobs.back();
+
+        damage_logs.emplace_back();
+        movie_options.damage_log = &damage_logs.back();
+        bands.push_back(band);
+
+        EnqueueArtBand(pool, movie_paths[m], band, whole_movie, segment_count, movie_options, jobs);
+    }
+
+    WaitForArtJobs(jobs, art_image, options.preview);
+
+    // Damaged columns are filled only now, the columns next to them may have been rendered by other segments.
+    for (int m = 0; m < movie_count; m++) {
+        damage_logs[m].FillFromNeighbours(bands[m]);
+        damage_logs[m].Report(movie_paths[m]);
+        memory_jobs[m].Report();
+    }
+}
+
+void CreateGridWallArt(const string& movie_path, const string& chapters_path, double block_seconds, Mat& art_image, const ArtRenderOptions& options) {
+    VideoCapture cap(movie_path);
+
+    if (!cap.isOpened()) {
+        cout << "Error opening video file." << endl;
+        return;
+    }
+
+    double fps = cap.get(CAP_PROP_FPS);
+    int frame_count = cap.get(CAP_PROP_FRAME_COUNT);
+    cap.release();
+
+    vector<MovieSegment> rows;
+
+    if (!chapters_path.empty())
+        rows = ReadMovieChapters(chapters_path, fps);
+
+    if (rows.empty() && block_seconds > 0.0)
+        rows = SplitMovieTimeBlocks(frame_count, fps, block_seconds);
+
+    if (rows.empty()) {
+        cout << "No chapters or time blocks to lay out." << endl;
+        return;
+    }
+
+    ThreadPool& pool = GetSharedThreadPool();
+
+    int row_count = min((int)rows.size(), art_image.rows);
+    int art_h = art_image.rows;
+    int segment_count = (pool.GetThreadCount() * 2 + row_count - 1) / row_count;
+
+    if (row_count < (int)rows.size()) {
+        cout << "The art has only " << art_image.rows << " rows, so the last " << rows.size() - row_count << " of " << rows.size()
+             << " bands are dropped." << endl;
+    }
+
+    vector<future<void>> jobs;
+    deque<ArtDamageLog> damage_logs;
+    vector<Mat> bands;
+
+    for (int r = 0; r < row_count; r++) {
+        Mat band = art_image.rowRange(r * art_h / row_count, (r + 1) * art_h / row_count);
+        MovieSegment row = rows[r];
+
+        // A band past the end of the movie, like the last time block, keeps the time scale of the others
+        // and only renders the columns the movie still covers. The rest stays black.
+        if (frame_count > 0 && row.last_frame > frame_count) {
+            long long frame_range = max(1, row.last_frame - row.first_frame);
+            long long movie_frames = max(0, frame_count - row.first_frame);
+            int movie_columns = (int)((movie_frames * band.cols + frame_range - 1) / frame_range);
+
+            band = band.colRange(0, min(movie_columns, band.cols));
+            row.last_frame = frame_count;
+        }
+
+        ArtRenderOptions row_options = options;
+        damage_logs.emplace_back();
+        row_options.damage_log = &damage_logs.back();
+        bands.push_back(band);
+
+        if (!band.empty())
+            EnqueueArtBand(pool, movie_path, band, row, segment_count, row_options, jobs);
+    }
+
+    WaitForArtJobs(jobs, art_image, options.preview);
+
+    // Every band fills its own damage, a chapter doesn't blend into the next one.
+    for (int r = 0; r < row_count; r++) {
+        if (bands[r].empty())
+            continue;
+
+        damage_logs[r].FillFromNeighbours(bands[r]);
+        damage_logs[r].Report(rows[r].title.empty() ? movie_path : movie_path + " (" + rows[r].title + ")", fps);
+    }
+}
@@ -0,0 +1,88 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ART_LAYOUTS_H
+#define ART_LAYOUTS_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "MovieWallArt.h"
+#include "RoiMask.h"
+
+/**
+ * A contiguous range of movie frames, like a chapter.
+ */
+struct MovieSegment {
+    int first_frame;
+    int last_frame;
+    std::string title;
+};
+
+/**
+ * Reads the chapters of a movie from an FFMETADATA file, which can be exported from the container with
+ * "ffmpeg -i movie.mkv -f ffmetadata chapters.txt".
+ *
+ * @param chapters_path The path to the FFMETADATA file.
+ * @param fps The frame rate of the movie, used to convert the chapter times to frames.
+ * @return The chapters, or none when the file can't be read or has a time that isn't a whole number.
+ */
+std::vector<MovieSegment> ReadMovieChapters(const std::string& chapters_path, double fps);
+
+/**
+ * Splits a movie in blocks of fixed duration. The last block keeps the full duration, so it ends after the movie
+ * and its band keeps the time scale of the others.
+ *
+ * @param frame_count The number of frames of the movie.
+ * @param fps The frame rate of the movie.
+ * @param block_seconds The duration of each block.
+ */
+std::vector<MovieSegment> SplitMovieTimeBlocks(int frame_count, double fps, double block_seconds);
+
+/**
+ * Creates one art image with several movies stacked as bands of rows, aligned by normalized time:
+ * column N of every band shows the same fraction of its own movie.
+ * All movies are decoded at once on the shared thread pool, each one split in column segments, so the
+ * whole render takes about as long as the longest movie alone.
+ *
+ * @param movie_paths The paths to the movies, from the top band to the bottom one.
+ * @param art_image A reference to the new image being created.
+ * @param options The style and the decoding settings of the render.
+ * @param roi_masks Optional masks of the pixels the reducers look at, one per movie.
+ */
+void CreateComparisonWallArt(const std::vector<std::string>& movie_paths, cv::Mat& art_image, const ArtRenderOptions& options,
+                             const std::vector<RoiMask>& roi_masks = std::vector<RoiMask>());
+
+/**
+ * Creates an art image laid out as a grid, where each band of rows covers one chapter or one block of time of the movie.
+ * Chapters are read from chapters_path when given, otherwise the movie is split in blocks of block_seconds.
+ * Every band decodes only its own range of frames, and all bands are rendered at once on the shared thread pool.
+ * The columns of a band past the end of the movie are left untouched, and bands past the rows of the art are dropped.
+ *
+ * @param movie_path The path to the movie that is going to be processed.
+ * @param chapters_path The path to an FFMETADATA file with the chapters, or an empty string.
+ * @param block_seconds The duration covered by each band when there are no chapters.
+ * @param art_image A reference to the new image being created.
+ * @param options The style, the decoding settings and the region of interest of the render.
+ */
+void CreateGridWallArt(const std::string& movie_path, const std::string& chapters_path, double block_seconds, cv::Mat& art_image,
+                       const ArtRenderOptions& options);
+
+#endif // !ART_LAYOUTS_H
@@ -0,0 +1,296 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "ArtVideo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+ArtVideoSink::ArtVideoSink(int mode, Size video_size, double fps, int window_columns)
+    : mode(mode), video_size(video_size), fps(fps), column_px(1), memory_job(nullptr), frame_reservation(0, nullptr, true),
+      dirty_begin(0), dirty_end(0), frames_per_column(1.0), pending_frames(0.0),
+      frames_written(0), encode_seconds(0.0), closing(false) {
+    if (mode == ART_VIDEO_MOVING_BARCODE && window_columns > 0) {
+        column_px = max(1, video_size.width / window_columns);
+    }
+}
+
+ArtVideoSink::~ArtVideoSink() {
+    Close();
+}
+
+bool ArtVideoSink::Open(const string& video_path) {
+    if (mode == ART_VIDEO_NONE)
+        return false;
+
+    writer.open(video_path, VideoWriter::fourcc('m', 'p', '4', 'v'), fps, video_size);
+
+    if (!writer.isOpened()) {
+        cout << "Error opening video output file." << endl;
+        return false;
+    }
+
+    // The barcode keeps the newest column past the right edge, to scroll it in over the frames it lasts.
+    int frame_w = video_size.width + (mode == ART_VIDEO_MOVING_BARCODE ? column_px : 0);
+
+    frame_reservation.Resize((long long)frame_w * video_size.height * 3);
+    video_frame = Mat::zeros(video_size.height, frame_w, CV_8UC3);
+    closing = false;
+    encoder = thread(&ArtVideoSink::EncodeLoop, this);
+
+    return true;
+}
+
+bool ArtVideoSink::IsOpened() const {
+    return writer.isOpened();
+}
+
+void ArtVideoSink::SetMemoryJob(MemoryJob* job) {
+    memory_job = job;
+}
+
+void ArtVideoSink::SyncToMovie(double movie_fps, int sample_interval) {
+    // The build-up keeps one frame per column, otherwise a whole movie would take hours to assemble.
+    if (mode == ART_VIDEO_MOVING_BARCODE && movie_fps > 0.0 && sample_interval > 0) {
+        frames_per_column = fps * sample_interval / movie_fps;
+    }
+}
+
+void ArtVideoSink::AddColumn(const Mat& art_image, int column_id) {
+    if (!IsOpened())
+        return;
+
+    // Mat headers share their data, so this keeps no copy of the art.
+    art_reference = art_image;
+
+    if (mode == ART_VIDEO_BUILD_UP) {
+        if (dirty_begin == dirty_end)
+            dirty_begin = column_id;
+        dirty_end = column_id + 1;
+    }
+    else {
+        PaintBarcode(art_image, column_id);
+    }
+
+    pending_frames += frames_per_column;
+
+    if (pending_frames >= 1.0) {
+        if (mode == ART_VIDEO_BUILD_UP)
+            PaintBuildUp(art_image);
+
+        EmitFrames();
+    }
+}
+
+/**
+ * Resamples only the video columns covering the art columns written since the last frame.
+ */
+void ArtVideoSink::PaintBuildUp(const Mat& art_image) {
+    if (dirty_begin == dirty_end)
+        return;
+
+    int art_w = art_image.cols;
+    int video_w = video_size.width;
+
+    int x0 = (int)((long long)dirty_begin * video_w / art_w);
+    int x1 = (int)(((long long)dirty_end * video_w + art_w - 1) / art_w);
+    x1 = min(max(x1, x0 + 1), video_w);
+
+    int art_x0 = (int)((long long)x0 * art_w / video_w);
+    int art_x1 = (int)(((long long)x1 * art_w + video_w - 1) / video_w);
+    art_x1 = min(max(art_x1, art_x0 + 1), art_w);
+
+    Mat source = art_image(Rect(art_x0, 0, art_x1 - art_x0, art_image.rows));
+    Mat target = video_frame(Rect(x0, 0, x1 - x0, video_size.height));
+
+    if (source.size() == target.size())
+        source.copyTo(target);
+    else
+        resize(source, target, target.size(), 0, 0, INTER_AREA);
+
+    dirty_begin = dirty_end;
+}
+
+/**
+ * Scrolls the barcode left by one column and paints the new art column on its right edge, still out of view.
+ */
+void ArtVideoSink::PaintBarcode(const Mat& art_image, int column_id) {
+    int video_w = video_frame.cols;
+    int video_h = video_size.height;
+    size_t shift_bytes = (size_t)column_px * 3;
+    size_t keep_bytes = (size_t)(video_w - column_px) * 3;
+
+    for (int y = 0; y < video_h; y++) {
+        uchar* row = video_frame.ptr<uchar>(y);
+        memmove(row, row + shift_bytes, keep_bytes);
+    }
+
+    Mat column;
+    if (art_image.rows == video_h)
+        column = art_image.col(column_id);
+    else
+        resize(art_image.col(column_id), column, Size(1, video_h), 0, 0, INTER_AREA);
+
+    for (int y = 0; y < video_h; y++) {
+        Vec3b color = column.at<Vec3b>(y, 0);
+        Vec3b* row = video_frame.ptr<Vec3b>(y) + (video_w - column_px);
+
+        for (int x = 0; x < column_px; x++)
+            row[x] = color;
+    }
+}
+
+/**
+ * Cuts the visible window out of the barcode, progress of the way from the newest column being out of view
+ * to it being fully in. Between two pixels the window is interpolated, so even slow scrolls move every frame.
+ */
+Mat ArtVideoSink::GetBarcodeFrame(double progress) const {
+    double offset = progress * column_px;
+    int left = (int)offset;
+    double fraction = offset - left;
+    Mat frame;
+
+    if (fraction == 0.0)
+        video_frame.colRange(left, left + video_size.width).copyTo(frame);
+    else
+        addWeighted(video_frame.colRange(left, left + video_size.width), 1.0 - fraction, video_frame.colRange(left + 1, left + 1 + video_size.width),
+                    fraction, 0.0, frame);
+
+    return frame;
+}
+
+void ArtVideoSink::EmitFrames() {
+    MemoryGovernor& governor = GetMemoryGovernor();
+    long long snapshot_bytes = (long long)video_size.area() * 3;
+
+    unique_lock<mutex> lock(queue_mutex);
+
+    // Close to the memory budget the queue gets shorter: a new snapshot waits for the encoder to drain it.
+    auto reserve_snapshot = [&]() {
+        queue_cv.wait(lock, [&] {
+            return queue.size() < ART_VIDEO_QUEUE_SIZE && (queue.empty() || governor.TryReserve(snapshot_bytes, memory_job));
+        });
+
+        if (queue.empty())
+            governor.Reserve(snapshot_bytes, memory_job);
+    };
+
+    if (mode == ART_VIDEO_MOVING_BARCODE) {
+        // Every frame scrolls the newest column a bit further in, so each one is a snapshot of its own. The
+        // frames of a column are spread evenly over it, carrying the fraction of a frame left by the last one.
+        while (pending_frames >= 1.0) {
+            reserve_snapshot();
+
+            double progress = 1.0 - (pending_frames - 1.0) / frames_per_column;
+            pending_frames -= 1.0;
+
+            QueuedFrame queued;
+            queued.frame = GetBarcodeFrame(min(max(progress, 0.0), 1.0));
+            queued.reserved_bytes = snapshot_bytes;
+            queue.push_back(queued);
+
+            queue_cv.notify_all();
+        }
+
+        return;
+    }
+
+    reserve_snapshot();
+
+    // Repeated frames share one buffer, the encoder only reads them.
+    Mat snapshot = video_frame.clone();
+
+    while (pending_frames >= 1.0) {
+        queue_cv.wait(lock, [this] { return queue.size() < ART_VIDEO_QUEUE_SIZE; });
+        pending_frames -= 1.0;
+
+        QueuedFrame queued;
+        queued.frame = snapshot;
+        queued.reserved_bytes = pending_frames >= 1.0 ? 0 : snapshot_bytes;
+        queue.push_back(queued);
+
+        queue_cv.notify_all();
+    }
+}
+
+void ArtVideoSink::EncodeLoop() {
+    while (true) {
+        QueuedFrame queued;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return closing || !queue.empty(); });
+
+            if (queue.empty())
+                break;
+
+            queued = queue.front();
+            queue.pop_front();
+            queue_cv.notify_all();
+        }
+
+        int64 start = getTickCount();
+        writer.write(queued.frame);
+        encode_seconds += (getTickCount() - start) / getTickFrequency();
+        frames_written++;
+
+        // The producer may be waiting for this memory to queue its next snapshot.
+        if (queued.reserved_bytes > 0) {
+            queued.frame.release();
+            GetMemoryGovernor().Release(queued.reserved_bytes, memory_job);
+
+            lock_guard<mutex> lock(queue_mutex);
+            queue_cv.notify_all();
+        }
+    }
+}
+
+void ArtVideoSink::Close() {
+    if (!IsOpened())
+        return;
+
+    // Whatever was assembled after the last emitted frame still deserves one.
+    if (mode == ART_VIDEO_BUILD_UP && dirty_begin != dirty_end) {
+        PaintBuildUp(art_reference);
+        pending_frames = max(pending_frames, 1.0);
+    }
+
+    if (pending_frames >= 1.0) {
+        EmitFrames();
+    }
+
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        closing = true;
+    }
+    queue_cv.notify_all();
+
+    if (encoder.joinable())
+        encoder.join();
+
+    writer.release();
+    art_reference.release();
+    video_frame.release();
+    frame_reservation.Release();
+
+    cout << "Video: " << frames_written << " frames encoded in " << encode_seconds << "s." << endl;
+}
@@ -0,0 +1,134 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ART_VIDEO_H
+#define ART_VIDEO_H
+
+#include "opencv2/opencv.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "MemoryGovernor.h"
+
+#define ART_VIDEO_NONE 0
+#define ART_VIDEO_BUILD_UP 1
+#define ART_VIDEO_MOVING_BARCODE 2
+
+// Maximum number of encoded frames waiting for the writer thread.
+#define ART_VIDEO_QUEUE_SIZE 8
+
+/**
+ * Encodes a video out of the art image while it is being rendered.
+ *
+ * The sink never looks at movie frames: it is fed the art columns already written by the reducers,
+ * so the video costs one column copy per art column plus the encoder time, which runs in its own thread.
+ *
+ * ART_VIDEO_BUILD_UP shows the art assembling column by column. Only the video columns covering the
+ * art columns added since the last emitted frame are resampled.
+ * ART_VIDEO_MOVING_BARCODE shows a window of the latest columns scrolling from right to left. The barcode
+ * is shifted in place by a column and only the newest column is painted, then the frames that column lasts
+ * slide the window over it a fraction of a column at a time.
+ */
+class ArtVideoSink {
+public:
+    /**
+     * @param mode ART_VIDEO_BUILD_UP or ART_VIDEO_MOVING_BARCODE.
+     * @param video_size The size of the encoded video frames.
+     * @param fps The frame rate of the encoded video.
+     * @param window_columns How many art columns are visible at once in ART_VIDEO_MOVING_BARCODE.
+     */
+    ArtVideoSink(int mode, cv::Size video_size, double fps, int window_columns);
+    ~ArtVideoSink();
+
+    bool Open(const std::string& video_path);
+    bool IsOpened() const;
+
+    /**
+     * Charges the snapshots waiting for the encoder to a job.
+     */
+    void SetMemoryJob(MemoryJob* job);
+
+    /**
+     * Makes the video last as long as the movie, so a barcode scrolls in sync with it.
+     *
+     * @param movie_fps The frame rate of the movie being rendered.
+     * @param sample_interval How many movie frames each art column covers.
+     */
+    void SyncToMovie(double movie_fps, int sample_interval);
+
+    /**
+     * Signals that a column of the art image has been written and emits the video frames it is due.
+     *
+     * @param art_image A reference to the art image being created.
+     * @param column_id The index of the column that has just been written.
+     */
+    void AddColumn(const cv::Mat& art_image, int column_id);
+
+    /**
+     * Flushes the pending frames and finishes the video file.
+     */
+    void Close();
+
+private:
+    // A snapshot waiting for the encoder. Repeats of a snapshot share its buffer, which is charged
+    // to the governor by the last one, so it stays reserved until the encoder is done with it.
+    struct QueuedFrame {
+        cv::Mat frame;
+        long long reserved_bytes;
+    };
+
+    void PaintBuildUp(const cv::Mat& art_image);
+    void PaintBarcode(const cv::Mat& art_image, int column_id);
+    cv::Mat GetBarcodeFrame(double progress) const;
+    void EmitFrames();
+    void EncodeLoop();
+
+    int mode;
+    cv::Size video_size;
+    double fps;
+    int column_px;
+
+    cv::VideoWriter writer;
+
+    // The moving barcode is one column wider than the video, for the newest column to scroll in from the right.
+    cv::Mat video_frame;
+    cv::Mat art_reference;
+    MemoryJob* memory_job;
+    MemoryReservation frame_reservation;
+
+    // Art columns written since the last emitted frame.
+    int dirty_begin;
+    int dirty_end;
+
+    double frames_per_column;
+    double pending_frames;
+    long long frames_written;
+    double encode_seconds;
+
+    std::thread encoder;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<QueuedFrame> queue;
+    bool closing;
+};
+
+#endif // !ART_VIDEO_H
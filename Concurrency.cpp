@@ -0,0 +1,176 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "Concurrency.h"
+
+#include "opencv2/opencv.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+/**
+ * Reads the CPU quota of a single cgroup, from its cgroup v2 cpu.max, or else from the v1 CFS files of its
+ * directory, when it has one.
+ *
+ * @return The quota in cores, rounded up, or 0 without one.
+ */
+static int ReadCgroupDirectoryQuota(const string& cpu_max_path, const string& cfs_directory) {
+    long long quota = -1;
+    long long period = 0;
+
+    // cgroup v2: "max 100000" or "<quota> <period>".
+    ifstream cpu_max(cpu_max_path);
+
+    if (cpu_max.is_open()) {
+        string quota_text;
+        cpu_max >> quota_text >> period;
+
+        if (cpu_max && quota_text != "max")
+            quota = atoll(quota_text.c_str());
+    }
+    else if (!cfs_directory.empty()) {
+        ifstream cfs_quota(cfs_directory + "/cpu.cfs_quota_us");
+        ifstream cfs_period(cfs_directory + "/cpu.cfs_period_us");
+
+        if (!(cfs_quota >> quota) || !(cfs_period >> period))
+            quota = -1;
+    }
+
+    if (quota <= 0 || period <= 0)
+        return 0;
+
+    return (int)max(1LL, (quota + period - 1) / period);
+}
+
+/**
+ * Keeps the smaller of two quotas, where 0 is no quota.
+ */
+static int GetSmallerQuota(int quota, int other_quota) {
+    if (quota <= 0)
+        return other_quota;
+
+    if (other_quota <= 0)
+        return quota;
+
+    return min(quota, other_quota);
+}
+
+int ReadCgroupQuotaCores(const string& cgroup_root, const string& proc_cgroup_path) {
+    // The cgroups of the process, from lines like "0::/user.slice/app.scope" for v2 and "4:cpu,cpuacct:/docker/id"
+    // for the v1 CPU controller. Without them, only the root is read.
+    string v2_path;
+    string v1_path;
+    ifstream proc_cgroup(proc_cgroup_path);
+    string line;
+
+    while (getline(proc_cgroup, line)) {
+        size_t first_colon = line.find(':');
+        size_t second_colon = first_colon == string::npos ? string::npos : line.find(':', first_colon + 1);
+
+        if (second_colon == string::npos)
+            continue;
+
+        string controllers = "," + line.substr(first_colon + 1, second_colon - first_colon - 1) + ",";
+        string path = line.substr(second_colon + 1);
+
+        if (controllers == ",,")
+            v2_path = path;
+        else if (controllers.find(",cpu,") != string::npos)
+            v1_path = path;
+    }
+
+    // A quota anywhere up the hierarchy limits the process, so the smallest one applies. The root is read last,
+    // which is all there is inside a container with a cgroup namespace of its own.
+    int quota = 0;
+
+    for (string path = v2_path; !path.empty() && path != "/"; path = path.substr(0, path.find_last_of('/')))
+        quota = GetSmallerQuota(quota, ReadCgroupDirectoryQuota(cgroup_root + path + "/cpu.max", ""));
+
+    for (string path = v1_path; !path.empty() && path != "/"; path = path.substr(0, path.find_last_of('/')))
+        quota = GetSmallerQuota(quota, ReadCgroupDirectoryQuota("", cgroup_root + "/cpu" + path));
+
+    return GetSmallerQuota(quota, ReadCgroupDirectoryQuota(cgroup_root + "/cpu.max", cgroup_root + "/cpu"));
+}
+
+int GetAvailableCores(int* quota_cores) {
+    int cores = max(1, (int)thread::hardware_concurrency());
+
+#ifdef __linux__
+    cpu_set_t affinity;
+
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+        cores = min(cores, max(1, CPU_COUNT(&affinity)));
+#endif
+
+    int quota = ReadCgroupQuotaCores();
+
+    if (quota > 0)
+        cores = min(cores, quota);
+
+    if (quota_cores != nullptr)
+        *quota_cores = quota;
+
+    return cores;
+}
+
+ConcurrencyPlan PlanConcurrency(int requested_workers, int requested_decoder_threads, bool concurrent_renders) {
+    ConcurrencyPlan plan;
+    plan.available_cores = GetAvailableCores(&plan.quota_cores);
+
+    int cores = plan.available_cores;
+
+    plan.workers = requested_workers > 0 ? requested_workers : cores;
+
+    if (concurrent_renders) {
+        plan.decoder_threads = requested_decoder_threads > 0 ? requested_decoder_threads : max(1, cores / plan.workers);
+        plan.opencv_threads = 1;
+    }
+    else {
+        plan.decoder_threads = requested_decoder_threads > 0 ? requested_decoder_threads : cores;
+        plan.opencv_threads = cores;
+    }
+
+    return plan;
+}
+
+void ApplyConcurrencyPlan(const ConcurrencyPlan& plan) {
+    SetSharedThreadPoolSize(plan.workers);
+    cv::setNumThreads(plan.opencv_threads);
+}
+
+void PrintConcurrencyPlan(const ConcurrencyPlan& plan) {
+    cout << "Concurrency: " << plan.available_cores << " cores";
+
+    if (plan.quota_cores > 0)
+        cout << " (cgroup quota of " << plan.quota_cores << ")";
+
+    cout << ", " << plan.workers << " workers, " << plan.decoder_threads << " decoder threads per capture, "
+         << plan.opencv_threads << " OpenCV threads." << endl;
+}
@@ -0,0 +1,79 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <string>
+
+/**
+ * How the cores of the process are shared between the render workers, the FFmpeg decoder threads of each
+ * capture and OpenCV's own parallel loops, so that together they don't run more threads than there are cores.
+ */
+struct ConcurrencyPlan {
+    // Cores the process may use, after the cgroup quota and the CPU affinity.
+    int available_cores = 1;
+
+    // The cgroup CPU quota in cores, rounded up, or 0 without one.
+    int quota_cores = 0;
+
+    int workers = 1;
+    int decoder_threads = 1;
+    int opencv_threads = 1;
+};
+
+/**
+ * Reads the CPU quota of the cgroup of the process, v2 first and then v1. The cgroup is found in the cgroup
+ * list of the process, and the smallest quota of it and of every cgroup above it applies.
+ *
+ * @param cgroup_root Where the cgroup filesystem is mounted.
+ * @param proc_cgroup_path The cgroup list of the process.
+ * @return The quota in cores, rounded up, or 0 without one.
+ */
+int ReadCgroupQuotaCores(const std::string& cgroup_root = "/sys/fs/cgroup", const std::string& proc_cgroup_path = "/proc/self/cgroup");
+
+/**
+ * Get the cores the process may use. Containers often get a CPU quota smaller than the host, which
+ * std::thread::hardware_concurrency() doesn't know about.
+ *
+ * @param quota_cores Receives the cgroup CPU quota in cores, or 0 without one.
+ */
+int GetAvailableCores(int* quota_cores = nullptr);
+
+/**
+ * Splits the available cores.
+ *
+ * Concurrent renders, like the comparison and grid layouts, run a render per worker, so each decoder gets
+ * its share of the cores and OpenCV runs single threaded inside the workers. A single render decodes and
+ * reduces in turn, so the decoder and the reducers each get every core.
+ *
+ * @param requested_workers The workers asked for, or 0 to pick.
+ * @param requested_decoder_threads The decoder threads asked for, or 0 to pick.
+ * @param concurrent_renders Whether several renders run at once.
+ */
+ConcurrencyPlan PlanConcurrency(int requested_workers, int requested_decoder_threads, bool concurrent_renders);
+
+/**
+ * Sizes the shared thread pool and OpenCV's thread count. Has to run before the shared pool is first used.
+ */
+void ApplyConcurrencyPlan(const ConcurrencyPlan& plan);
+
+void PrintConcurrencyPlan(const ConcurrencyPlan& plan);
+
+#endif // !CONCURRENCY_H
@@ -0,0 +1,115 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "DcAverage.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+
+#include "MovieWallArt.h"
+
+using namespace cv;
+using namespace std;
+
+bool IsDcDecodable(VideoCapture& cap) {
+    int fourcc = (int)cap.get(CAP_PROP_FOURCC);
+    string code;
+
+    for (int i = 0; i < 4; i++)
+        code += (char)toupper((fourcc >> (8 * i)) & 0xFF);
+
+    return code == "MJPG" || code == "MJPA" || code == "JPEG" || code == "AVRN";
+}
+
+bool EnableDcDecoding(VideoCapture& cap) {
+    return cap.set(CAP_PROP_FORMAT, -1);
+}
+
+bool DecodeDcFrame(const Mat& packet, Mat& dc_frame) {
+    if (packet.empty())
+        return false;
+
+    // The 1/8 scale makes libjpeg keep only the DC coefficient of every block.
+    dc_frame = imdecode(packet, IMREAD_REDUCED_COLOR_8);
+
+    return !dc_frame.empty();
+}
+
+DcValidationReport ValidateDcAverage(const string& movie_path, int sample_count) {
+    DcValidationReport report;
+
+    VideoCapture full_cap(movie_path);
+    VideoCapture dc_cap(movie_path, CAP_FFMPEG);
+
+    if (!full_cap.isOpened() || !dc_cap.isOpened() || !IsDcDecodable(dc_cap) || !EnableDcDecoding(dc_cap))
+        return report;
+
+    int frame_count = (int)full_cap.get(CAP_PROP_FRAME_COUNT);
+    sample_count = min(sample_count, frame_count);
+
+    double error_sum = 0.0;
+    Mat frame;
+    Mat packet;
+    Mat dc_frame;
+
+    for (int i = 0; i < sample_count; i++) {
+        int target_frame = (int)((long long)i * frame_count / sample_count);
+
+        int64 start = getTickCount();
+        full_cap.set(CAP_PROP_POS_FRAMES, target_frame);
+        bool decoded = full_cap.read(frame) && !frame.empty();
+        Vec3b full_color = decoded ? GetFrameAverageColor(frame) : Vec3b();
+        report.full_seconds += (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        dc_cap.set(CAP_PROP_POS_FRAMES, target_frame);
+        bool dc_decoded = dc_cap.grab() && dc_cap.retrieve(packet) && DecodeDcFrame(packet, dc_frame);
+        Vec3b dc_color = dc_decoded ? GetFrameAverageColor(dc_frame) : Vec3b();
+        report.dc_seconds += (getTickCount() - start) / getTickFrequency();
+
+        if (!decoded || !dc_decoded)
+            continue;
+
+        for (int c = 0; c < 3; c++) {
+            double error = abs((int)full_color[c] - (int)dc_color[c]);
+            error_sum += error;
+            report.max_error = max(report.max_error, error);
+        }
+
+        report.frame_count++;
+    }
+
+    if (report.frame_count > 0)
+        report.mean_error = error_sum / (report.frame_count * 3);
+
+    return report;
+}
+
+void PrintDcValidationReport(const DcValidationReport& report) {
+    if (report.frame_count == 0) {
+        cout << "DC average: the movie can't be read as DC frames." << endl;
+        return;
+    }
+
+    cout << "DC average: " << report.frame_count << " frames, mean error " << report.mean_error
+         << ", max error " << report.max_error << " levels, " << report.full_seconds / max(report.dc_seconds, 1e-9)
+         << "x faster than full decoding." << endl;
+}
@@ -0,0 +1,80 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef DC_AVERAGE_H
+#define DC_AVERAGE_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+
+/**
+ * Experimental: the average color and pixel strip styles only need block means, which intra coded frames
+ * already carry as the DC coefficients of their 8x8 blocks.
+ *
+ * Only MJPEG is read this way. libjpeg decodes at 1/8 scale from the DC coefficients alone, skipping the
+ * inverse DCT, so the compressed packets give a "DC frame" with one pixel per block. MPEG-2 and H.264
+ * I-frames would need a bitstream parser OpenCV doesn't expose, so they are always fully decoded.
+ */
+
+/**
+ * Whether the frames of a capture are intra coded JPEGs whose DC coefficients can be read.
+ */
+bool IsDcDecodable(cv::VideoCapture& cap);
+
+/**
+ * Switches a capture to hand out compressed packets instead of decoded frames.
+ *
+ * @return Whether the backend supports it.
+ */
+bool EnableDcDecoding(cv::VideoCapture& cap);
+
+/**
+ * Decodes the DC coefficients of a compressed frame.
+ *
+ * @param packet The compressed frame, as retrieved from a capture with DC decoding enabled.
+ * @param dc_frame Receives a frame 1/8 the size of the movie, each pixel the mean of its block.
+ */
+bool DecodeDcFrame(const cv::Mat& packet, cv::Mat& dc_frame);
+
+/**
+ * How the DC frames compare with full decoding.
+ */
+struct DcValidationReport {
+    int frame_count = 0;
+
+    // Per channel, in 0-255 levels, between the average colors of the DC frames and of the decoded frames.
+    double mean_error = 0.0;
+    double max_error = 0.0;
+
+    double full_seconds = 0.0;
+    double dc_seconds = 0.0;
+};
+
+/**
+ * Samples frames of a movie both ways and compares GetFrameAverageColor on the decoded frames with it on the DC frames.
+ *
+ * @param movie_path The path to an MJPEG movie.
+ * @param sample_count How many frames to compare, spread over the movie.
+ * @return The report, with no frames when the movie can't be read as DC frames.
+ */
+DcValidationReport ValidateDcAverage(const std::string& movie_path, int sample_count);
+
+void PrintDcValidationReport(const DcValidationReport& report);
+
+#endif // !DC_AVERAGE_H
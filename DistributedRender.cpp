@@ -0,0 +1,273 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "DistributedRender.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "Concurrency.h"
+
+using namespace cv;
+using namespace std;
+
+bool RenderShardFragment(const string& movie_path, Size art_size, const RenderShard& shard, const ArtRenderOptions& options, const string& fragment_path) {
+    if (shard.first_column < 0 || shard.last_column > art_size.width || shard.first_column >= shard.last_column)
+        return false;
+
+    // Only the columns of the shard are allocated, sampled at the interval of the whole width.
+    Mat fragment = Mat::zeros(art_size.height, shard.last_column - shard.first_column, CV_8UC3);
+
+    ArtRenderOptions shard_options = options;
+    shard_options.preview = false;
+    shard_options.damage_log = nullptr;
+
+    RenderArtColumns(movie_path, fragment, shard.first_column, shard.last_column, shard_options, 0, -1, art_size.width);
+
+    return imwrite(fragment_path, fragment);
+}
+
+string GetShardFragmentPath(const string& fragment_prefix, const RenderShard& shard) {
+    ostringstream path;
+    path << fragment_prefix << ".columns-" << shard.first_column << "-" << shard.last_column << ".png";
+
+    return path.str();
+}
+
+/**
+ * Quotes an argument for the shell that system() runs it on.
+ *
+ * On Windows the program splits its own command line, where backslashes are literal unless they come before
+ * a quote, so only those are doubled and paths keep theirs. Elsewhere single quotes keep the shell from
+ * expanding anything, and a quote inside ends them and is escaped on its own.
+ */
+static string QuoteCommandArgument(const string& argument) {
+#ifdef _WIN32
+    string quoted = "\"";
+    size_t backslashes = 0;
+
+    for (char c : argument) {
+        if (c == '\\') {
+            backslashes++;
+        }
+        else {
+            if (c == '"')
+                quoted.append(backslashes + 1, '\\');
+
+            backslashes = 0;
+        }
+
+        quoted += c;
+    }
+
+    // The closing quote mustn't be escaped by a trailing backslash.
+    quoted.append(backslashes, '\\');
+
+    return quoted + "\"";
+#else
+    string quoted = "'";
+
+    for (char c : argument) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+
+    return quoted + "'";
+#endif
+}
+
+ProcessShardTransport::ProcessShardTransport(const string& executable_path, const vector<string>& arguments,
+                                             const vector<string>& worker_commands, int local_workers)
+    : executable_path(executable_path), arguments(arguments) {
+    // The local workers share the cores of this host. Given first, so the settings of the render still win.
+    int worker_cores = max(1, GetAvailableCores() / max(local_workers, 1));
+    local_arguments = { "--threads", to_string(worker_cores), "--decoder-threads", to_string(worker_cores) };
+
+    for (int i = 0; i < local_workers; i++)
+        slot_commands.push_back("");
+
+    for (const string& command : worker_commands)
+        slot_commands.push_back(command);
+}
+
+int ProcessShardTransport::GetWorkerCount() const {
+    return (int)slot_commands.size();
+}
+
+bool ProcessShardTransport::RunShard(int worker, const RenderShard& shard, const string& fragment_path) {
+    ostringstream command;
+
+    if (!slot_commands[worker].empty())
+        command << slot_commands[worker] << " ";
+
+    command << QuoteCommandArgument(executable_path);
+
+    if (slot_commands[worker].empty()) {
+        for (const string& argument : local_arguments)
+            command << " " << QuoteCommandArgument(argument);
+    }
+
+    for (const string& argument : arguments)
+        command << " " << QuoteCommandArgument(argument);
+
+    command << " --worker-shard " << shard.first_column << "," << shard.last_column
+            << " --fragment " << QuoteCommandArgument(fragment_path)
+            << " --preview false";
+
+#ifdef _WIN32
+    // cmd.exe drops the first and the last quote of a command that starts with one, so the whole command
+    // gets a pair of its own.
+    return system(("\"" + command.str() + "\"").c_str()) == 0;
+#else
+    return system(command.str().c_str()) == 0;
+#endif
+}
+
+LoopbackShardTransport::LoopbackShardTransport(const string& movie_path, Size art_size, const ArtRenderOptions& options, int worker_count)
+    : movie_path(movie_path), art_size(art_size), options(options), worker_count(max(worker_count, 1)) {
+}
+
+int LoopbackShardTransport::GetWorkerCount() const {
+    return worker_count;
+}
+
+bool LoopbackShardTransport::RunShard(int /*worker*/, const RenderShard& shard, const string& fragment_path) {
+    return RenderShardFragment(movie_path, art_size, shard, options, fragment_path);
+}
+
+/**
+ * Copies a fragment into its columns of the art image, if it has the size of the shard.
+ */
+static bool MergeShardFragment(Mat& art_image, const RenderShard& shard, const string& fragment_path) {
+    Mat fragment = imread(fragment_path, IMREAD_COLOR);
+
+    if (fragment.empty() || fragment.rows != art_image.rows || fragment.cols != shard.last_column - shard.first_column)
+        return false;
+
+    // Shards never share columns, so the workers can copy into the image at the same time.
+    fragment.copyTo(art_image.colRange(shard.first_column, shard.last_column));
+
+    return true;
+}
+
+DistributedRenderReport RunDistributedRender(Mat& art_image, ShardTransport& transport, const DistributedRenderOptions& options) {
+    DistributedRenderReport report;
+    report.worker_count = transport.GetWorkerCount();
+
+    if (report.worker_count <= 0 || art_image.cols == 0)
+        return report;
+
+    int shard_columns = options.shard_columns > 0 ? options.shard_columns : max(1, art_image.cols / (report.worker_count * 4));
+
+    deque<RenderShard> pending;
+
+    for (int first_column = 0; first_column < art_image.cols; first_column += shard_columns) {
+        RenderShard shard;
+        shard.index = report.shard_count++;
+        shard.first_column = first_column;
+        shard.last_column = min(first_column + shard_columns, art_image.cols);
+        pending.push_back(shard);
+    }
+
+    mutex shards_mutex;
+    condition_variable shards_cv;
+    int running = 0;
+
+    int64 start = getTickCount();
+
+    // One thread per worker slot. A failed shard goes back to the queue, so a slot only stops once
+    // nothing is queued and no other slot may still queue a retry.
+    auto run_slot = [&](int worker) {
+        unique_lock<mutex> lock(shards_mutex);
+
+        while (true) {
+            shards_cv.wait(lock, [&] { return !pending.empty() || running == 0; });
+
+            if (pending.empty())
+                break;
+
+            RenderShard shard = pending.front();
+            pending.pop_front();
+            shard.attempts++;
+            running++;
+            lock.unlock();
+
+            string fragment_path = GetShardFragmentPath(options.fragment_prefix, shard);
+            remove(fragment_path.c_str());
+
+            int64 shard_start = getTickCount();
+            bool merged = transport.RunShard(worker, shard, fragment_path) && MergeShardFragment(art_image, shard, fragment_path);
+            double seconds = (getTickCount() - shard_start) / getTickFrequency();
+
+            if (!options.keep_fragments)
+                remove(fragment_path.c_str());
+
+            lock.lock();
+            running--;
+
+            if (merged) {
+                report.shard_seconds += seconds;
+            }
+            else if (shard.attempts < options.max_attempts) {
+                cout << "Shard of columns " << shard.first_column << "-" << shard.last_column << " failed on worker " << worker
+                     << ", retrying." << endl;
+
+                if (shard.attempts == 1)
+                    report.retried_shards++;
+
+                pending.push_back(shard);
+            }
+            else {
+                cout << "Shard of columns " << shard.first_column << "-" << shard.last_column << " failed " << shard.attempts
+                     << " times, its columns are left black." << endl;
+                report.failed_shards++;
+            }
+
+            shards_cv.notify_all();
+        }
+    };
+
+    vector<thread> slots;
+
+    for (int worker = 0; worker < report.worker_count; worker++)
+        slots.push_back(thread(run_slot, worker));
+
+    for (thread& slot : slots)
+        slot.join();
+
+    report.wall_seconds = (getTickCount() - start) / getTickFrequency();
+
+    return report;
+}
+
+void PrintDistributedRenderReport(const DistributedRenderReport& report) {
+    double speedup = report.shard_seconds / max(report.wall_seconds, 1e-9);
+
+    cout << "Distributed render: " << report.shard_count << " shards on " << report.worker_count << " workers, "
+         << report.retried_shards << " retried, " << report.failed_shards << " failed, in " << report.wall_seconds << "s. "
+         << speedup << "x the speed of one worker, " << 100.0 * speedup / max(report.worker_count, 1) << "% scaling efficiency." << endl;
+}
@@ -0,0 +1,170 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef DISTRIBUTED_RENDER_H
+#define DISTRIBUTED_RENDER_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "MovieWallArt.h"
+
+/**
+ * A range of columns of the art image rendered by one worker.
+ */
+struct RenderShard {
+    int index = 0;
+    int first_column = 0;
+    int last_column = 0;
+    int attempts = 0;
+};
+
+/**
+ * Renders the columns of a shard and writes them as a fragment, an image as tall as the art and as wide
+ * as the shard. The whole art is sampled, so the columns are the same as in a render of the whole image.
+ * Damaged columns repeat the column on their left within the shard.
+ *
+ * @param movie_path The path to the movie.
+ * @param art_size The size of the whole art image.
+ * @param shard The columns to render.
+ * @param options The style and the decoding settings of the render.
+ * @param fragment_path Where to write the fragment, as a PNG.
+ */
+bool RenderShardFragment(const std::string& movie_path, cv::Size art_size, const RenderShard& shard, const ArtRenderOptions& options, const std::string& fragment_path);
+
+/**
+ * Get where the fragment of a shard is written.
+ *
+ * @param fragment_prefix The path the fragments start with, like the path to the art or to a shared directory.
+ */
+std::string GetShardFragmentPath(const std::string& fragment_prefix, const RenderShard& shard);
+
+/**
+ * How the coordinator gets a shard rendered. Every worker slot runs one shard at a time, and slots run
+ * at the same time, so RunShard has to be safe to call from several threads for different slots.
+ */
+class ShardTransport {
+public:
+    virtual ~ShardTransport() {}
+
+    virtual int GetWorkerCount() const = 0;
+
+    /**
+     * Renders a shard and waits for its fragment.
+     *
+     * @param worker The slot running the shard, from 0 to GetWorkerCount() - 1.
+     * @return Whether the worker says it wrote the fragment. The coordinator still checks it.
+     */
+    virtual bool RunShard(int worker, const RenderShard& shard, const std::string& fragment_path) = 0;
+};
+
+/**
+ * Runs every shard as a new process of this program, given the same settings plus --worker-shard and
+ * --fragment. A worker command is put in front of the program, like "ssh render2", to run it on another
+ * host, which must see the movie and the fragments at the same paths.
+ */
+class ProcessShardTransport : public ShardTransport {
+public:
+    /**
+     * @param executable_path The path to this program.
+     * @param arguments The settings of the render, as given on the command line.
+     * @param worker_commands One per remote worker slot.
+     * @param local_workers How many worker slots run on this host.
+     */
+    ProcessShardTransport(const std::string& executable_path, const std::vector<std::string>& arguments,
+                          const std::vector<std::string>& worker_commands, int local_workers);
+
+    int GetWorkerCount() const override;
+
+    bool RunShard(int worker, const RenderShard& shard, const std::string& fragment_path) override;
+
+private:
+    std::string executable_path;
+    std::vector<std::string> arguments;
+
+    // Thread counts of the local workers, so together they don't run more threads than the host has cores.
+    std::vector<std::string> local_arguments;
+
+    // The command put in front of the program for each slot, empty for the local ones.
+    std::vector<std::string> slot_commands;
+};
+
+/**
+ * Runs the shards in this process on worker threads, the same way a worker process would.
+ * Used by the tests, and to check a distributed setup on one machine.
+ */
+class LoopbackShardTransport : public ShardTransport {
+public:
+    LoopbackShardTransport(const std::string& movie_path, cv::Size art_size, const ArtRenderOptions& options, int worker_count);
+
+    int GetWorkerCount() const override;
+
+    bool RunShard(int worker, const RenderShard& shard, const std::string& fragment_path) override;
+
+private:
+    std::string movie_path;
+    cv::Size art_size;
+    ArtRenderOptions options;
+    int worker_count;
+};
+
+struct DistributedRenderOptions {
+    // Columns per shard, or 0 for four shards per worker, so the workers that finish first take more of them.
+    int shard_columns = 0;
+
+    // Times a shard is tried before its columns are left black.
+    int max_attempts = 3;
+
+    std::string fragment_prefix;
+    bool keep_fragments = false;
+};
+
+/**
+ * What a distributed render did.
+ */
+struct DistributedRenderReport {
+    int shard_count = 0;
+    int retried_shards = 0;
+    int failed_shards = 0;
+    int worker_count = 0;
+
+    double wall_seconds = 0.0;
+
+    // Time the workers spent on shards that succeeded, summed.
+    double shard_seconds = 0.0;
+};
+
+/**
+ * Splits the art image in shards, has the transport render them, retrying the failed ones, and merges
+ * the fragments into the image.
+ *
+ * @param art_image A reference to the image being created.
+ * @param transport Renders the shards.
+ * @param options How to split the image and where the fragments go.
+ * @return The report. The render is complete when no shard failed.
+ */
+DistributedRenderReport RunDistributedRender(cv::Mat& art_image, ShardTransport& transport, const DistributedRenderOptions& options);
+
+/**
+ * Prints the shards, the retries and the scaling efficiency: the shard time over the wall time of all the workers.
+ */
+void PrintDistributedRenderReport(const DistributedRenderReport& report);
+
+#endif // !DISTRIBUTED_RENDER_H
@@ -0,0 +1,100 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "FrameEnergy.h"
+
+using namespace cv;
+using namespace std;
+
+// Energies that map to full brightness or saturation. Real footage rarely gets past them.
+#define EDGE_ENERGY_FULL_SCALE 96.0f
+#define DETAIL_DENSITY_FULL_SCALE 0.5f
+#define DETAIL_LAPLACIAN_THRESHOLD 24
+#define MOTION_ENERGY_FULL_SCALE 24.0f
+
+static float ClampEnergy(float energy) {
+    return min(max(energy, 0.0f), 1.0f);
+}
+
+void GetFrameEnergyPlanes(const Mat& frame, Mat& small_frame, Mat& luma) {
+    int small_w = min(ENERGY_LUMA_WIDTH, frame.cols);
+    int small_h = max(1, (int)((long long)frame.rows * small_w / frame.cols));
+
+    // Downscaling the color frame first keeps the color conversion on the small plane.
+    resize(frame, small_frame, Size(small_w, small_h), 0, 0, INTER_AREA);
+    cvtColor(small_frame, luma, COLOR_BGR2GRAY);
+}
+
+float GetFrameEdgeEnergy(const Mat& luma) {
+    Mat gradient_x;
+    Mat gradient_y;
+
+    Sobel(luma, gradient_x, CV_16S, 1, 0, 3);
+    Sobel(luma, gradient_y, CV_16S, 0, 1, 3);
+
+    // |gx| + |gy| is close enough to the magnitude and stays in the vectorized 8-bit paths.
+    convertScaleAbs(gradient_x, gradient_x);
+    convertScaleAbs(gradient_y, gradient_y);
+
+    float energy = (float)(mean(gradient_x)[0] + mean(gradient_y)[0]);
+
+    return ClampEnergy(energy / EDGE_ENERGY_FULL_SCALE);
+}
+
+float GetFrameDetailDensity(const Mat& luma) {
+    Mat laplacian;
+
+    Laplacian(luma, laplacian, CV_16S, 3);
+    convertScaleAbs(laplacian, laplacian);
+    threshold(laplacian, laplacian, DETAIL_LAPLACIAN_THRESHOLD, 255, THRESH_BINARY);
+
+    float density = (float)countNonZero(laplacian) / (float)laplacian.total();
+
+    return ClampEnergy(density / DETAIL_DENSITY_FULL_SCALE);
+}
+
+float GetFrameMotionEnergy(const Mat& luma, const Mat& following_luma) {
+    if (following_luma.empty() || following_luma.size() != luma.size())
+        return 0.0f;
+
+    Mat difference;
+    absdiff(luma, following_luma, difference);
+
+    return ClampEnergy((float)mean(difference)[0] / MOTION_ENERGY_FULL_SCALE);
+}
+
+Vec3b EncodeEnergyAsBrightness(const Vec3b& color, float energy) {
+    Mat pixel(1, 1, CV_8UC3, Scalar(color[0], color[1], color[2]));
+
+    cvtColor(pixel, pixel, COLOR_BGR2HSV);
+    pixel.at<Vec3b>(0, 0)[2] = saturate_cast<uchar>(energy * 255.0f);
+    cvtColor(pixel, pixel, COLOR_HSV2BGR);
+
+    return pixel.at<Vec3b>(0, 0);
+}
+
+Vec3b EncodeEnergyAsSaturation(const Vec3b& color, float energy) {
+    Mat pixel(1, 1, CV_8UC3, Scalar(color[0], color[1], color[2]));
+
+    cvtColor(pixel, pixel, COLOR_BGR2HSV);
+    pixel.at<Vec3b>(0, 0)[1] = saturate_cast<uchar>(energy * 255.0f);
+    cvtColor(pixel, pixel, COLOR_HSV2BGR);
+
+    return pixel.at<Vec3b>(0, 0);
+}
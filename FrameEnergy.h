@@ -0,0 +1,62 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef FRAME_ENERGY_H
+#define FRAME_ENERGY_H
+
+#include "opencv2/opencv.hpp"
+
+// Width of the luma plane the energies are measured on. Detail finer than this is not worth the decode rate.
+#define ENERGY_LUMA_WIDTH 320
+
+/**
+ * Downscales a frame once for the energy styles.
+ *
+ * @param frame A reference to the current frame of the movie.
+ * @param small_frame Receives the downscaled color frame.
+ * @param luma Receives the downscaled luma plane.
+ */
+void GetFrameEnergyPlanes(const cv::Mat& frame, cv::Mat& small_frame, cv::Mat& luma);
+
+/**
+ * How strong the edges of a frame are: the mean Sobel gradient magnitude, from 0 (flat) to 1.
+ */
+float GetFrameEdgeEnergy(const cv::Mat& luma);
+
+/**
+ * How much of a frame is covered with fine detail: the share of pixels with a strong Laplacian response, from 0 to 1.
+ */
+float GetFrameDetailDensity(const cv::Mat& luma);
+
+/**
+ * How much changes from a frame to the next one: their mean absolute difference, from 0 (still) to 1.
+ */
+float GetFrameMotionEnergy(const cv::Mat& luma, const cv::Mat& following_luma);
+
+/**
+ * Keeps the hue and saturation of a color and sets its brightness from an energy.
+ */
+cv::Vec3b EncodeEnergyAsBrightness(const cv::Vec3b& color, float energy);
+
+/**
+ * Keeps the hue and brightness of a color and sets its saturation from an energy.
+ */
+cv::Vec3b EncodeEnergyAsSaturation(const cv::Vec3b& color, float energy);
+
+#endif // !FRAME_ENERGY_H
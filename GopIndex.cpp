@@ -0,0 +1,209 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "GopIndex.h"
+
+#include "opencv2/opencv.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+using namespace cv;
+using namespace std;
+
+#define GOP_INDEX_HEADER "MovieWallArt GOP index 1"
+
+GopIndex::GopIndex() : frame_count(0) {
+}
+
+bool GopIndex::Build(const string& movie_path) {
+    VideoCapture cap(movie_path, CAP_FFMPEG);
+
+    if (!cap.isOpened())
+        return false;
+
+    // Raw mode hands out the packets as they are read from the file, without decoding them.
+    if (!cap.set(CAP_PROP_FORMAT, -1)) {
+        cout << "GOP index: the backend can't read raw packets, seeking to every sample instead." << endl;
+        return false;
+    }
+
+    int64 start = getTickCount();
+
+    keyframes.clear();
+    frame_count = 0;
+
+    // Packets come in decoding order. A keyframe is decoded before the frames that reference it, so its position
+    // matches its frame index, give or take the reordering delay of the codec, which a seek makes up for.
+    while (cap.grab()) {
+        if (cap.get(CAP_PROP_LRF_HAS_KEY_FRAME) != 0.0)
+            keyframes.push_back(frame_count);
+
+        frame_count++;
+    }
+
+    cap.release();
+
+    if (frame_count == 0) {
+        keyframes.clear();
+        return false;
+    }
+
+    if (keyframes.empty() || keyframes[0] != 0)
+        keyframes.insert(keyframes.begin(), 0);
+
+    cout << "GOP index: " << keyframes.size() << " keyframes in " << frame_count << " frames, read in "
+         << (getTickCount() - start) / getTickFrequency() << "s." << endl;
+
+    return true;
+}
+
+bool GopIndex::Load(const string& index_path, long long movie_bytes) {
+    ifstream file(index_path);
+
+    if (!file.is_open())
+        return false;
+
+    string header;
+    getline(file, header);
+
+    string size_key;
+    string frames_key;
+    string keyframes_key;
+    long long indexed_bytes = -1;
+    int keyframe_count = 0;
+
+    file >> size_key >> indexed_bytes >> frames_key >> frame_count >> keyframes_key >> keyframe_count;
+
+    if (!file || header != GOP_INDEX_HEADER || size_key != "size" || frames_key != "frames" || keyframes_key != "keyframes")
+        return false;
+
+    // The movie was replaced after it was indexed.
+    if (indexed_bytes != movie_bytes || keyframe_count <= 0)
+        return false;
+
+    keyframes.resize(keyframe_count);
+
+    for (int i = 0; i < keyframe_count; i++) {
+        if (!(file >> keyframes[i])) {
+            keyframes.clear();
+            return false;
+        }
+    }
+
+    return !keyframes.empty();
+}
+
+bool GopIndex::Save(const string& index_path, long long movie_bytes) const {
+    ofstream file(index_path);
+
+    if (!file.is_open())
+        return false;
+
+    file << GOP_INDEX_HEADER << "\n"
+         << "size " << movie_bytes << "\n"
+         << "frames " << frame_count << "\n"
+         << "keyframes " << keyframes.size() << "\n";
+
+    for (int keyframe : keyframes)
+        file << keyframe << "\n";
+
+    return (bool)file;
+}
+
+bool GopIndex::IsEmpty() const {
+    return keyframes.empty();
+}
+
+int GopIndex::GetFrameCount() const {
+    return frame_count;
+}
+
+int GopIndex::GetKeyframeCount() const {
+    return (int)keyframes.size();
+}
+
+int GopIndex::GetKeyframeBefore(int frame) const {
+    vector<int>::const_iterator after = upper_bound(keyframes.begin(), keyframes.end(), frame);
+
+    if (after == keyframes.begin())
+        return 0;
+
+    return *(after - 1);
+}
+
+string GetGopIndexPath(const string& movie_path) {
+    return movie_path + ".gopidx";
+}
+
+static long long GetFileBytes(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+
+    if (!file.is_open())
+        return -1;
+
+    return (long long)file.tellg();
+}
+
+/**
+ * The index of a movie, and the lock its build holds.
+ */
+struct CachedGopIndex {
+    mutex build_mutex;
+    shared_ptr<const GopIndex> index;
+};
+
+shared_ptr<const GopIndex> GetMovieGopIndex(const string& movie_path) {
+    static mutex indexes_mutex;
+    static map<string, shared_ptr<CachedGopIndex>> indexes;
+
+    shared_ptr<CachedGopIndex> cached;
+
+    {
+        lock_guard<mutex> lock(indexes_mutex);
+        shared_ptr<CachedGopIndex>& entry = indexes[movie_path];
+
+        if (entry == nullptr)
+            entry = make_shared<CachedGopIndex>();
+
+        cached = entry;
+    }
+
+    // Held while building, so the segments of a render don't all scan the same movie at once, while
+    // renders of other movies find or build their own indexes.
+    lock_guard<mutex> lock(cached->build_mutex);
+
+    if (cached->index != nullptr)
+        return cached->index;
+
+    shared_ptr<GopIndex> index = make_shared<GopIndex>();
+    long long movie_bytes = GetFileBytes(movie_path);
+    string index_path = GetGopIndexPath(movie_path);
+
+    if (!index->Load(index_path, movie_bytes) && index->Build(movie_path)) {
+        if (!index->Save(index_path, movie_bytes))
+            cout << "GOP index: could not save " << index_path << ", it will be built again next time." << endl;
+    }
+
+    cached->index = index;
+
+    return index;
+}
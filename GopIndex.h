@@ -0,0 +1,76 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef GOP_INDEX_H
+#define GOP_INDEX_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * The keyframes of a movie, so the sampler knows which frames share a group of pictures (GOP) and can
+ * decode all the samples of a GOP in one pass instead of seeking to each of them.
+ *
+ * The index is built by reading the packets of the movie without decoding them, and saved next to the movie
+ * as <movie>.gopidx, so later runs only read the small file.
+ */
+class GopIndex {
+public:
+    GopIndex();
+
+    /**
+     * Scans the packets of a movie for its keyframes. Needs the FFmpeg backend of OpenCV.
+     *
+     * @return Whether the keyframes could be read.
+     */
+    bool Build(const std::string& movie_path);
+
+    /**
+     * @param index_path The path to the index file.
+     * @param movie_bytes The size of the movie file, the index is stale when it doesn't match.
+     */
+    bool Load(const std::string& index_path, long long movie_bytes);
+    bool Save(const std::string& index_path, long long movie_bytes) const;
+
+    bool IsEmpty() const;
+    int GetFrameCount() const;
+    int GetKeyframeCount() const;
+
+    /**
+     * Get the last keyframe at or before a frame, which is where decoding must start to reach it.
+     */
+    int GetKeyframeBefore(int frame) const;
+
+private:
+    int frame_count;
+    std::vector<int> keyframes;
+};
+
+std::string GetGopIndexPath(const std::string& movie_path);
+
+/**
+ * Get the index of a movie, loading it from next to the movie or building and saving it on first use.
+ * Indexes are kept for the whole process, and concurrent renders of one movie wait for the same build.
+ *
+ * @return The index, empty when the keyframes can't be read.
+ */
+std::shared_ptr<const GopIndex> GetMovieGopIndex(const std::string& movie_path);
+
+#endif // !GOP_INDEX_H
@@ -0,0 +1,224 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "MemoryGovernor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+MemoryJob::MemoryJob(const string& name) : name(name), current_bytes(0), peak_bytes(0) {
+}
+
+const string& MemoryJob::GetName() const {
+    return name;
+}
+
+long long MemoryJob::GetPeakBytes() const {
+    return peak_bytes;
+}
+
+void MemoryJob::Report() const {
+    cout << "Memory: " << name << " peaked at " << (int)(peak_bytes / BYTES_PER_MB) << " MB." << endl;
+}
+
+MemoryGovernor::MemoryGovernor() : budget_bytes(0), untracked_bytes(0), reserved_bytes(0), resident_bytes(0), peak_reserved_bytes(0) {
+}
+
+void MemoryGovernor::SetBudget(long long budget) {
+    lock_guard<mutex> lock(budget_mutex);
+
+    budget_bytes = max(0LL, budget);
+    untracked_bytes = budget_bytes > 0 ? GetProcessResidentBytes() : 0;
+
+    if (budget_bytes > 0 && untracked_bytes >= budget_bytes)
+        cout << "Memory: the process already uses more than the budget, renders will run one at a time." << endl;
+
+    budget_cv.notify_all();
+}
+
+bool MemoryGovernor::Fits(long long bytes) const {
+    // Resident memory is never released while the renders run, so waiting for it would never end.
+    return budget_bytes == 0 || reserved_bytes == resident_bytes || untracked_bytes + reserved_bytes + bytes <= budget_bytes;
+}
+
+void MemoryGovernor::Charge(long long bytes, MemoryJob* job) {
+    reserved_bytes += bytes;
+    peak_reserved_bytes = max(peak_reserved_bytes, reserved_bytes);
+
+    if (job != nullptr) {
+        job->current_bytes += bytes;
+        job->peak_bytes = max(job->peak_bytes, job->current_bytes);
+    }
+}
+
+void MemoryGovernor::Reserve(long long bytes, MemoryJob* job) {
+    unique_lock<mutex> lock(budget_mutex);
+    budget_cv.wait(lock, [this, bytes] { return Fits(bytes); });
+    Charge(bytes, job);
+}
+
+bool MemoryGovernor::TryReserve(long long bytes, MemoryJob* job) {
+    lock_guard<mutex> lock(budget_mutex);
+
+    if (!Fits(bytes))
+        return false;
+
+    Charge(bytes, job);
+    return true;
+}
+
+void MemoryGovernor::Release(long long bytes, MemoryJob* job) {
+    {
+        lock_guard<mutex> lock(budget_mutex);
+        reserved_bytes -= bytes;
+
+        if (job != nullptr)
+            job->current_bytes -= bytes;
+    }
+    budget_cv.notify_all();
+}
+
+void MemoryGovernor::ReserveResident(long long bytes, MemoryJob* job) {
+    lock_guard<mutex> lock(budget_mutex);
+    resident_bytes += bytes;
+    Charge(bytes, job);
+}
+
+void MemoryGovernor::ReleaseResident(long long bytes, MemoryJob* job) {
+    {
+        lock_guard<mutex> lock(budget_mutex);
+        resident_bytes -= bytes;
+    }
+    Release(bytes, job);
+}
+
+long long MemoryGovernor::GetReservedBytes() {
+    lock_guard<mutex> lock(budget_mutex);
+    return reserved_bytes;
+}
+
+long long MemoryGovernor::GetPeakReservedBytes() {
+    lock_guard<mutex> lock(budget_mutex);
+    return peak_reserved_bytes;
+}
+
+void MemoryGovernor::Report() {
+    long long peak_reserved = GetPeakReservedBytes();
+    long long peak_resident = GetProcessPeakResidentBytes();
+
+    cout << "Memory: " << (int)(peak_reserved / BYTES_PER_MB) << " MB reserved at the peak";
+
+    if (peak_resident > 0)
+        cout << ", " << (int)(peak_resident / BYTES_PER_MB) << " MB resident";
+
+    if (budget_bytes > 0)
+        cout << ", budget of " << (int)(budget_bytes / BYTES_PER_MB) << " MB";
+
+    cout << "." << endl;
+}
+
+MemoryGovernor& GetMemoryGovernor() {
+    static MemoryGovernor governor;
+    return governor;
+}
+
+MemoryReservation::MemoryReservation() : bytes(0), job(nullptr), resident(false) {
+}
+
+MemoryReservation::MemoryReservation(long long bytes, MemoryJob* job, bool resident) : bytes(0), job(job), resident(resident) {
+    Resize(bytes);
+}
+
+MemoryReservation::~MemoryReservation() {
+    Release();
+}
+
+void MemoryReservation::Resize(long long new_bytes) {
+    if (new_bytes > bytes && resident)
+        GetMemoryGovernor().ReserveResident(new_bytes - bytes, job);
+    else if (new_bytes > bytes)
+        GetMemoryGovernor().Reserve(new_bytes - bytes, job);
+    else if (new_bytes < bytes && resident)
+        GetMemoryGovernor().ReleaseResident(bytes - new_bytes, job);
+    else if (new_bytes < bytes)
+        GetMemoryGovernor().Release(bytes - new_bytes, job);
+
+    bytes = new_bytes;
+}
+
+void MemoryReservation::Release() {
+    Resize(0);
+}
+
+long long GetProcessResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (long long)counters.WorkingSetSize;
+
+    return 0;
+#elif defined(__linux__)
+    ifstream statm("/proc/self/statm");
+    long long total_pages = 0;
+    long long resident_pages = 0;
+
+    if (!(statm >> total_pages >> resident_pages))
+        return 0;
+
+    return resident_pages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+long long GetProcessPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (long long)counters.PeakWorkingSetSize;
+
+    return 0;
+#elif defined(__linux__)
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    // Linux reports it in kilobytes.
+    return (long long)usage.ru_maxrss * 1024;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,162 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+/**
+ * The memory charged to one job, like the render of a movie, to report how much it needed at its peak.
+ */
+class MemoryJob {
+public:
+    explicit MemoryJob(const std::string& name);
+
+    const std::string& GetName() const;
+    long long GetPeakBytes() const;
+
+    /**
+     * Prints the peak memory of the job.
+     */
+    void Report() const;
+
+private:
+    friend class MemoryGovernor;
+
+    std::string name;
+    long long current_bytes;
+    long long peak_bytes;
+};
+
+/**
+ * Keeps the memory of the concurrent renders of the process within a budget.
+ *
+ * The big buffers, like decoded frames, decoder pools, encoder queues and art images, are reserved before
+ * they are allocated. A reservation that doesn't fit waits until others are released, so decoders and queues
+ * throttle themselves when the process gets close to the budget. A reservation is always granted when
+ * nothing but resident memory is reserved, so a single job bigger than the budget still runs, alone.
+ */
+class MemoryGovernor {
+public:
+    MemoryGovernor();
+
+    /**
+     * Sets the resident memory the process should stay within. The memory already resident when the budget is set,
+     * like the code and the libraries, is taken out of it.
+     *
+     * @param budget_bytes The budget, or 0 for no limit.
+     */
+    void SetBudget(long long budget_bytes);
+
+    /**
+     * Reserves memory, waiting until it fits in the budget.
+     *
+     * @param bytes How much memory is about to be allocated.
+     * @param job Optional job the memory is charged to.
+     */
+    void Reserve(long long bytes, MemoryJob* job = nullptr);
+
+    /**
+     * Reserves memory only if it fits in the budget right away.
+     *
+     * @return Whether the memory was reserved.
+     */
+    bool TryReserve(long long bytes, MemoryJob* job = nullptr);
+
+    void Release(long long bytes, MemoryJob* job = nullptr);
+
+    /**
+     * Reserves memory that stays allocated while the renders run, like the art image. Nothing would release
+     * memory for it to wait for, so it is charged right away, and it doesn't keep a render from running alone.
+     */
+    void ReserveResident(long long bytes, MemoryJob* job = nullptr);
+
+    void ReleaseResident(long long bytes, MemoryJob* job = nullptr);
+
+    long long GetReservedBytes();
+    long long GetPeakReservedBytes();
+
+    /**
+     * Prints the peak reserved and resident memory of the process.
+     */
+    void Report();
+
+private:
+    bool Fits(long long bytes) const;
+    void Charge(long long bytes, MemoryJob* job);
+
+    std::mutex budget_mutex;
+    std::condition_variable budget_cv;
+
+    long long budget_bytes;
+    long long untracked_bytes;
+    long long reserved_bytes;
+    long long resident_bytes;
+    long long peak_reserved_bytes;
+};
+
+/**
+ * The governor shared by every render in the process.
+ */
+MemoryGovernor& GetMemoryGovernor();
+
+/**
+ * Holds a reservation of the shared governor while it is in scope.
+ */
+class MemoryReservation {
+public:
+    MemoryReservation();
+    /**
+     * @param bytes How much memory is about to be allocated.
+     * @param job Optional job the memory is charged to.
+     * @param resident Whether the memory stays allocated while the renders run. See MemoryGovernor::ReserveResident.
+     */
+    MemoryReservation(long long bytes, MemoryJob* job = nullptr, bool resident = false);
+    ~MemoryReservation();
+
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    /**
+     * Changes the size of the reservation, waiting for the budget when it grows.
+     */
+    void Resize(long long bytes);
+
+    void Release();
+
+private:
+    long long bytes;
+    MemoryJob* job;
+    bool resident;
+};
+
+/**
+ * Get the resident memory of the process, or 0 where it can't be read.
+ */
+long long GetProcessResidentBytes();
+
+/**
+ * Get the peak resident memory of the process, or 0 where it can't be read.
+ */
+long long GetProcessPeakResidentBytes();
+
+#endif // !MEMORY_GOVERNOR_H
@@ -0,0 +1,357 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "MotionVectors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#ifdef MOVIE_WALL_ART_FFMPEG
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/motion_vector.h>
+}
+#endif
+
+using namespace cv;
+using namespace std;
+
+MotionSummary::MotionSummary() {
+    Clear();
+}
+
+void MotionSummary::Clear() {
+    energy = 0.0;
+    frame_count = 0;
+
+    for (int i = 0; i < MOTION_DIRECTION_BINS; i++)
+        direction_histogram[i] = 0.0;
+}
+
+Vec3b EncodeMotionSummary(const MotionSummary& summary, bool show_directions) {
+    double motion = summary.frame_count > 0 ? summary.energy / summary.frame_count : 0.0;
+
+    // Slow pans and fast action both stay readable on a logarithmic scale.
+    double brightness = min(1.0, log1p(motion) / log1p(MOTION_VECTOR_FULL_SCALE));
+    uchar value = saturate_cast<uchar>(brightness * 255.0);
+
+    if (!show_directions)
+        return Vec3b(value, value, value);
+
+    int main_direction = 0;
+    double total = 0.0;
+
+    for (int i = 0; i < MOTION_DIRECTION_BINS; i++) {
+        total += summary.direction_histogram[i];
+
+        if (summary.direction_histogram[i] > summary.direction_histogram[main_direction])
+            main_direction = i;
+    }
+
+    double agreement = total > 0.0 ? summary.direction_histogram[main_direction] / total : 0.0;
+
+    // OpenCV hues go from 0 to 180.
+    Mat hsv(1, 1, CV_8UC3, Scalar(main_direction * 180 / MOTION_DIRECTION_BINS, saturate_cast<uchar>(agreement * 255.0), value));
+    Mat bgr;
+    cvtColor(hsv, bgr, COLOR_HSV2BGR);
+
+    return bgr.at<Vec3b>(0, 0);
+}
+
+#ifdef MOVIE_WALL_ART_FFMPEG
+
+bool IsMotionVectorSupported() {
+    return true;
+}
+
+struct MotionVectorReader::Decoder {
+    AVFormatContext* format = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+    int stream_index = -1;
+
+    double fps = 0.0;
+    double time_base = 0.0;
+    int64_t start_pts = 0;
+    int frame_count = 0;
+    int frame_pixels = 1;
+
+    // Frames before this one only bring the decoder up to a seek target.
+    int first_frame = 0;
+    bool draining = false;
+
+    // A frame decoded past the end of the last range, kept for the next one.
+    bool has_pending = false;
+    int pending_index = 0;
+    MotionSummary pending;
+
+    ~Decoder() {
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+
+    bool Open(const string& movie_path) {
+        if (avformat_open_input(&format, movie_path.c_str(), nullptr, nullptr) < 0)
+            return false;
+
+        if (avformat_find_stream_info(format, nullptr) < 0)
+            return false;
+
+        const AVCodec* video_codec = nullptr;
+        stream_index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &video_codec, 0);
+
+        if (stream_index < 0 || video_codec == nullptr)
+            return false;
+
+        // Intra only codecs, like MJPEG, have no motion vectors to read.
+        const AVCodecDescriptor* descriptor = avcodec_descriptor_get(video_codec->id);
+
+        if (descriptor != nullptr && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY) != 0)
+            return false;
+
+        AVStream* stream = format->streams[stream_index];
+        codec = avcodec_alloc_context3(video_codec);
+
+        if (codec == nullptr || avcodec_parameters_to_context(codec, stream->codecpar) < 0)
+            return false;
+
+        // The vectors don't depend on the loop filter, only the pixels do.
+        codec->skip_loop_filter = AVDISCARD_ALL;
+        codec->thread_count = 0;
+
+        AVDictionary* decoder_options = nullptr;
+        av_dict_set(&decoder_options, "flags2", "+export_mvs", 0);
+        int opened = avcodec_open2(codec, video_codec, &decoder_options);
+        av_dict_free(&decoder_options);
+
+        if (opened < 0)
+            return false;
+
+        packet = av_packet_alloc();
+        frame = av_frame_alloc();
+
+        fps = av_q2d(stream->avg_frame_rate);
+        time_base = av_q2d(stream->time_base);
+        start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        frame_pixels = max(1, codec->width * codec->height);
+
+        if (stream->nb_frames > 0)
+            frame_count = (int)stream->nb_frames;
+        else if (format->duration > 0 && fps > 0.0)
+            frame_count = (int)(format->duration * fps / AV_TIME_BASE);
+
+        return packet != nullptr && frame != nullptr && fps > 0.0;
+    }
+
+    /**
+     * Decodes the next frame and sums up its motion vectors.
+     */
+    bool NextFrame(int& index, MotionSummary& motion) {
+        while (true) {
+            int received = avcodec_receive_frame(codec, frame);
+
+            if (received == 0) {
+                int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+                index = (int)llround((pts - start_pts) * time_base * fps);
+
+                motion.Clear();
+                ReadMotionVectors(motion);
+                av_frame_unref(frame);
+                return true;
+            }
+
+            if (received != AVERROR(EAGAIN) || draining)
+                return false;
+
+            if (av_read_frame(format, packet) < 0) {
+                avcodec_send_packet(codec, nullptr);
+                draining = true;
+                continue;
+            }
+
+            // A damaged packet is only a frame without vectors, the next keyframe brings the decoder back.
+            if (packet->stream_index == stream_index)
+                avcodec_send_packet(codec, packet);
+
+            av_packet_unref(packet);
+        }
+    }
+
+    void ReadMotionVectors(MotionSummary& motion) {
+        // Intra frames have no vectors, counting them would show a still moment at every keyframe.
+        if (frame->pict_type == AV_PICTURE_TYPE_I)
+            return;
+
+        AVFrameSideData* side_data = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+        motion.frame_count = 1;
+
+        if (side_data == nullptr)
+            return;
+
+        const AVMotionVector* vectors = (const AVMotionVector*)side_data->data;
+        size_t vector_count = side_data->size / sizeof(AVMotionVector);
+        double moved = 0.0;
+
+        for (size_t i = 0; i < vector_count; i++) {
+            const AVMotionVector& vector = vectors[i];
+
+            // Vectors pointing to a future reference are flipped, so every vector points along the motion.
+            double dx = vector.dst_x - vector.src_x;
+            double dy = vector.dst_y - vector.src_y;
+
+            if (vector.source > 0) {
+                dx = -dx;
+                dy = -dy;
+            }
+
+            double length = sqrt(dx * dx + dy * dy);
+
+            if (length == 0.0)
+                continue;
+
+            double weighted = length * vector.w * vector.h;
+            moved += weighted;
+
+            // The y axis points down, so a positive angle turns clockwise.
+            int bin = (int)lround(atan2(dy, dx) * MOTION_DIRECTION_BINS / (2.0 * CV_PI));
+            motion.direction_histogram[(bin + MOTION_DIRECTION_BINS) % MOTION_DIRECTION_BINS] += weighted / frame_pixels;
+        }
+
+        motion.energy = moved / frame_pixels;
+    }
+};
+
+MotionVectorReader::MotionVectorReader(const string& movie_path) : decoder(new Decoder()) {
+    if (!decoder->Open(movie_path)) {
+        cout << "Error reading the motion vectors of " << movie_path << endl;
+        decoder.reset();
+    }
+}
+
+MotionVectorReader::~MotionVectorReader() {
+}
+
+bool MotionVectorReader::IsOpened() const {
+    return decoder != nullptr;
+}
+
+int MotionVectorReader::GetFrameCount() const {
+    return decoder != nullptr ? decoder->frame_count : 0;
+}
+
+double MotionVectorReader::GetFps() const {
+    return decoder != nullptr ? decoder->fps : 0.0;
+}
+
+void MotionVectorReader::Seek(int frame) {
+    if (decoder == nullptr)
+        return;
+
+    decoder->first_frame = frame;
+    decoder->has_pending = false;
+    decoder->draining = false;
+
+    if (frame == 0)
+        return;
+
+    int64_t timestamp = decoder->start_pts + (int64_t)(frame / decoder->fps / decoder->time_base);
+    av_seek_frame(decoder->format, decoder->stream_index, timestamp, AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(decoder->codec);
+}
+
+static void AddMotion(MotionSummary& summary, const MotionSummary& motion) {
+    summary.energy += motion.energy;
+    summary.frame_count += motion.frame_count;
+
+    for (int i = 0; i < MOTION_DIRECTION_BINS; i++)
+        summary.direction_histogram[i] += motion.direction_histogram[i];
+}
+
+bool MotionVectorReader::Accumulate(int end_frame, MotionSummary& summary) {
+    if (decoder == nullptr)
+        return false;
+
+    if (decoder->has_pending) {
+        if (decoder->pending_index >= end_frame)
+            return true;
+
+        AddMotion(summary, decoder->pending);
+        decoder->has_pending = false;
+    }
+
+    int index;
+    MotionSummary motion;
+
+    while (decoder->NextFrame(index, motion)) {
+        if (index < decoder->first_frame)
+            continue;
+
+        if (index >= end_frame) {
+            decoder->has_pending = true;
+            decoder->pending_index = index;
+            decoder->pending = motion;
+            return true;
+        }
+
+        AddMotion(summary, motion);
+    }
+
+    return false;
+}
+
+#else
+
+bool IsMotionVectorSupported() {
+    return false;
+}
+
+struct MotionVectorReader::Decoder {
+};
+
+MotionVectorReader::MotionVectorReader(const string& /*movie_path*/) {
+}
+
+MotionVectorReader::~MotionVectorReader() {
+}
+
+bool MotionVectorReader::IsOpened() const {
+    return false;
+}
+
+int MotionVectorReader::GetFrameCount() const {
+    return 0;
+}
+
+double MotionVectorReader::GetFps() const {
+    return 0.0;
+}
+
+void MotionVectorReader::Seek(int /*frame*/) {
+}
+
+bool MotionVectorReader::Accumulate(int /*end_frame*/, MotionSummary& /*summary*/) {
+    return false;
+}
+
+#endif // MOVIE_WALL_ART_FFMPEG
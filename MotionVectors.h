@@ -0,0 +1,95 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef MOTION_VECTORS_H
+#define MOTION_VECTORS_H
+
+#include "opencv2/opencv.hpp"
+#include <memory>
+#include <string>
+
+// Directions the motion of a column is binned in, 45 degrees each, starting to the right and turning clockwise.
+#define MOTION_DIRECTION_BINS 8
+
+// Average motion, in pixels per frame, shown at full brightness.
+#define MOTION_VECTOR_FULL_SCALE 16.0
+
+/**
+ * The motion of the frames covered by one art column, read from the motion vectors of the codec.
+ */
+struct MotionSummary {
+    MotionSummary();
+
+    void Clear();
+
+    // The sum over the frames of how far their pixels moved on average, in pixels.
+    double energy;
+    int frame_count;
+
+    // How far the pixels moved in each direction, in pixels.
+    double direction_histogram[MOTION_DIRECTION_BINS];
+};
+
+/**
+ * Get the color of a column out of its motion: brighter the more the picture moves and, with directions,
+ * with the hue of the main direction, more saturated the more the motion agrees on it.
+ */
+cv::Vec3b EncodeMotionSummary(const MotionSummary& summary, bool show_directions);
+
+/**
+ * Whether this build reads motion vectors. They come from FFmpeg's "export_mvs" decoder flag, which OpenCV
+ * doesn't expose, so the program has to be built with MOVIE_WALL_ART_FFMPEG and linked to libavformat,
+ * libavcodec and libavutil.
+ */
+bool IsMotionVectorSupported();
+
+/**
+ * Reads the motion vectors a decoder exports for every frame of a movie. The pixels are still reconstructed
+ * by the decoder, but the loop filter is skipped and the frames are never converted or copied, so it runs
+ * close to the demuxing speed.
+ */
+class MotionVectorReader {
+public:
+    explicit MotionVectorReader(const std::string& movie_path);
+    ~MotionVectorReader();
+
+    bool IsOpened() const;
+    int GetFrameCount() const;
+    double GetFps() const;
+
+    /**
+     * Moves to a frame. The frames decoded from the keyframe before it are not accumulated.
+     */
+    void Seek(int frame);
+
+    /**
+     * Adds the motion of the frames from the current one up to a frame to a summary.
+     *
+     * @param end_frame The frame after the last one to add.
+     * @param summary Receives the motion of the frames.
+     * @return Whether the movie goes on after the frames, false at its end.
+     */
+    bool Accumulate(int end_frame, MotionSummary& summary);
+
+private:
+    struct Decoder;
+    std::unique_ptr<Decoder> decoder;
+};
+
+#endif // !MOTION_VECTORS_H
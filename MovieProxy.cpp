@@ -0,0 +1,349 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "MovieProxy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "SharedDecode.h"
+
+using namespace cv;
+using namespace std;
+
+// The first line of a proxy index, changed whenever the format of the proxy changes.
+#define MOVIE_PROXY_INDEX_HEADER "MovieWallArt proxy 1"
+
+// Frame rate written into the proxy. Nothing plays it, the index says which frame each one is.
+#define MOVIE_PROXY_FPS 25
+
+string GetMovieProxyPath(const string& movie_path) {
+    return movie_path + ".proxy.avi";
+}
+
+string GetMovieProxyIndexPath(const string& movie_path) {
+    return movie_path + ".proxy.txt";
+}
+
+MovieProxyWriter::MovieProxyWriter() : frame_count(0) {
+}
+
+bool MovieProxyWriter::Open(const string& movie_path, Size frame_size, int frame_count) {
+    this->movie_path = movie_path;
+    this->frame_size = frame_size;
+    this->frame_count = frame_count;
+    sample_frames.clear();
+
+    // Without its index, a proxy left behind by a render that didn't finish is never loaded.
+    remove(GetMovieProxyIndexPath(movie_path).c_str());
+
+    if (frame_size.width <= 0 || frame_size.height <= 0)
+        return false;
+
+    // MJPEG wants even sizes.
+    Size reduced_size = GetReducedFrameSize(frame_size, MOVIE_PROXY_WIDTH);
+    proxy_size = Size(max(2, reduced_size.width & ~1), max(2, reduced_size.height & ~1));
+
+    writer.open(GetMovieProxyPath(movie_path), VideoWriter::fourcc('M', 'J', 'P', 'G'), MOVIE_PROXY_FPS, proxy_size,
+                { VIDEOWRITER_PROP_QUALITY, MOVIE_PROXY_QUALITY });
+
+    if (!writer.isOpened())
+        cout << "Error opening the proxy file: " << GetMovieProxyPath(movie_path) << endl;
+
+    return writer.isOpened();
+}
+
+bool MovieProxyWriter::IsOpened() const {
+    return writer.isOpened();
+}
+
+void MovieProxyWriter::AddSample(int frame_index, const Mat& frame) {
+    if (!writer.isOpened() || frame.empty())
+        return;
+
+    // The same frame twice, when the image is wider than the movie is long, is only kept once.
+    if (!sample_frames.empty() && frame_index <= sample_frames.back())
+        return;
+
+    resize(frame, proxy_frame, proxy_size, 0, 0, INTER_AREA);
+    writer << proxy_frame;
+    sample_frames.push_back(frame_index);
+}
+
+bool MovieProxyWriter::Close() {
+    if (!writer.isOpened())
+        return false;
+
+    writer.release();
+
+    if (sample_frames.empty()) {
+        remove(GetMovieProxyPath(movie_path).c_str());
+        return false;
+    }
+
+    ofstream index(GetMovieProxyIndexPath(movie_path));
+
+    index << MOVIE_PROXY_INDEX_HEADER << endl
+          << GetMovieFingerprint(movie_path) << " " << frame_count << " " << frame_size.width << " " << frame_size.height << endl
+          << sample_frames.size() << endl;
+
+    for (int sample_frame : sample_frames)
+        index << sample_frame << endl;
+
+    if (!index) {
+        cout << "Error writing the proxy index: " << GetMovieProxyIndexPath(movie_path) << endl;
+        return false;
+    }
+
+    cout << "Proxy: " << sample_frames.size() << " frames of " << proxy_size.width << "x" << proxy_size.height
+         << " written to " << GetMovieProxyPath(movie_path) << endl;
+
+    return true;
+}
+
+MovieProxy::MovieProxy() : frame_count(0), position(-1) {
+}
+
+bool MovieProxy::Load(const string& movie_path) {
+    sample_frames.clear();
+    position = -1;
+
+    ifstream index(GetMovieProxyIndexPath(movie_path));
+    string header;
+
+    if (!getline(index, header) || header != MOVIE_PROXY_INDEX_HEADER)
+        return false;
+
+    string fingerprint;
+    size_t sample_count = 0;
+
+    if (!(index >> fingerprint >> frame_count >> frame_size.width >> frame_size.height >> sample_count))
+        return false;
+
+    if (fingerprint != GetMovieFingerprint(movie_path)) {
+        cout << "Proxy: " << movie_path << " changed since its proxy was written, it isn't used." << endl;
+        return false;
+    }
+
+    sample_frames.resize(sample_count);
+
+    for (size_t i = 0; i < sample_count; i++) {
+        if (!(index >> sample_frames[i])) {
+            sample_frames.clear();
+            return false;
+        }
+    }
+
+    if (sample_frames.empty() || !cap.open(GetMovieProxyPath(movie_path))) {
+        sample_frames.clear();
+        return false;
+    }
+
+    position = 0;
+
+    return true;
+}
+
+int MovieProxy::GetFrameCount() const {
+    return frame_count;
+}
+
+Size MovieProxy::GetFrameSize() const {
+    return frame_size;
+}
+
+int MovieProxy::GetSampleCount() const {
+    return (int)sample_frames.size();
+}
+
+int MovieProxy::GetSampleFrame(int sample) const {
+    return sample_frames[sample];
+}
+
+int MovieProxy::GetNearestSample(int frame_index) const {
+    vector<int>::const_iterator after = lower_bound(sample_frames.begin(), sample_frames.end(), frame_index);
+
+    if (after == sample_frames.end())
+        return (int)sample_frames.size() - 1;
+
+    int sample = (int)(after - sample_frames.begin());
+
+    if (sample > 0 && frame_index - sample_frames[sample - 1] < *after - frame_index)
+        sample--;
+
+    return sample;
+}
+
+bool MovieProxy::ReadSample(int sample, Mat& frame) {
+    if (sample < 0 || sample >= (int)sample_frames.size())
+        return false;
+
+    // Every MJPEG frame is a keyframe, so a seek costs a single decode.
+    if (sample != position)
+        cap.set(CAP_PROP_POS_FRAMES, sample);
+
+    if (!cap.read(frame) || frame.empty()) {
+        position = -1;
+        return false;
+    }
+
+    position = sample + 1;
+
+    return true;
+}
+
+/**
+ * Whether a style can be rendered from the proxy, which has a single frame per column.
+ */
+static bool CanRenderFromProxy(int style) {
+    return style != ART_STYLE_MOTION_VECTORS && !ArtStyleNeedsFollowingFrame(style);
+}
+
+/**
+ * Scales a proxy frame back to the size the reducers see in a render of the movie, so the styles that
+ * depend on the frame size, like the pixel strip, split it the same way.
+ */
+static void ExpandProxyFrame(const Mat& proxy_frame, Mat& frame, Size frame_size, int reduction_width) {
+    resize(proxy_frame, frame, GetReducedFrameSize(frame_size, reduction_width), 0, 0, INTER_LINEAR);
+}
+
+bool RenderArtFromProxy(const string& movie_path, Mat& art_image, const ArtRenderOptions& options) {
+    if (!CanRenderFromProxy(options.style))
+        return false;
+
+    MovieProxy proxy;
+
+    if (!proxy.Load(movie_path))
+        return false;
+
+    ArtColumnContext context;
+    context.roi_mask = options.roi_mask;
+    context.sparse_log = options.sparse_log;
+
+    int frame_count = proxy.GetFrameCount();
+    int sample_interval = frame_count / art_image.cols;
+    int current_sample = -1;
+
+    Mat proxy_frame;
+    Mat frame;
+
+    for (int column_id = 0; column_id < art_image.cols; column_id++) {
+        int current_frame = column_id * sample_interval;
+
+        if (sample_interval == 0)
+            current_frame = (int)((long long)column_id * frame_count / art_image.cols);
+
+        int sample = proxy.GetNearestSample(current_frame);
+
+        // Images narrower than the proxy skip samples, wider ones repeat them without reading them again.
+        if (sample != current_sample) {
+            if (!proxy.ReadSample(sample, proxy_frame)) {
+                if (column_id > 0)
+                    art_image.col(column_id - 1).copyTo(art_image.col(column_id));
+                continue;
+            }
+
+            ExpandProxyFrame(proxy_frame, frame, proxy.GetFrameSize(), options.reduction_width);
+            current_sample = sample;
+        }
+
+        CreateArtColumn(frame, art_image, column_id, options.style, options.preview, &context);
+    }
+
+    if (options.preview)
+        waitKey(0);
+
+    return true;
+}
+
+ProxyValidationReport ValidateMovieProxy(const string& movie_path, int art_height, const ArtRenderOptions& options, int sample_count) {
+    ProxyValidationReport report;
+
+    MovieProxy proxy;
+    VideoCapture cap;
+
+    if (!CanRenderFromProxy(options.style) || !proxy.Load(movie_path) || !OpenMovieCapture(cap, movie_path, options))
+        return report;
+
+    // Every sample is read on its own, which is what seeking does best.
+    ArtRenderOptions full_options = options;
+    full_options.sampling = ART_SAMPLING_SEEK;
+    full_options.dc_average = false;
+
+    ArtFrameSampler sampler(cap, full_options);
+    ArtColumnContext context;
+    context.roi_mask = options.roi_mask;
+
+    sample_count = min(sample_count, proxy.GetSampleCount());
+
+    Mat full_column(art_height, 1, CV_8UC3);
+    Mat proxy_column(art_height, 1, CV_8UC3);
+    Mat proxy_frame;
+    Mat frame;
+    Mat difference;
+    double error_sum = 0.0;
+
+    for (int i = 0; i < sample_count; i++) {
+        int sample = (int)((long long)i * proxy.GetSampleCount() / sample_count);
+        int target_frame = proxy.GetSampleFrame(sample);
+
+        int64 start = getTickCount();
+        bool decoded = sampler.Read(target_frame, context) == ART_FRAME_OK
+            && CreateArtColumn(sampler.GetFrame(), full_column, 0, options.style, false, &context) == ART_COLUMN_OK;
+        report.full_seconds += (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        bool proxy_decoded = proxy.ReadSample(sample, proxy_frame);
+
+        if (proxy_decoded) {
+            ExpandProxyFrame(proxy_frame, frame, proxy.GetFrameSize(), options.reduction_width);
+            proxy_decoded = CreateArtColumn(frame, proxy_column, 0, options.style, false, &context) == ART_COLUMN_OK;
+        }
+
+        report.proxy_seconds += (getTickCount() - start) / getTickFrequency();
+
+        if (!decoded || !proxy_decoded)
+            continue;
+
+        absdiff(full_column, proxy_column, difference);
+        Scalar channel_error = mean(difference);
+        error_sum += channel_error[0] + channel_error[1] + channel_error[2];
+        report.max_error = max(report.max_error, norm(difference.reshape(1), NORM_INF));
+
+        report.column_count++;
+    }
+
+    if (report.column_count > 0)
+        report.mean_error = error_sum / (report.column_count * 3);
+
+    return report;
+}
+
+void PrintProxyValidationReport(const ProxyValidationReport& report) {
+    if (report.column_count == 0) {
+        cout << "Proxy: the movie has no proxy for this style." << endl;
+        return;
+    }
+
+    cout << "Proxy: " << report.column_count << " columns, mean error " << report.mean_error
+         << ", max error " << report.max_error << " levels, " << report.full_seconds / max(report.proxy_seconds, 1e-9)
+         << "x faster than the movie." << endl;
+}
@@ -0,0 +1,159 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef MOVIE_PROXY_H
+#define MOVIE_PROXY_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "MovieWallArt.h"
+
+// Width of the proxy frames. The height keeps the aspect ratio of the movie.
+#define MOVIE_PROXY_WIDTH 160
+
+// JPEG quality of the proxy frames.
+#define MOVIE_PROXY_QUALITY 90
+
+// Samples compared between the proxy and the movie by proxy-validate.
+#define MOVIE_PROXY_VALIDATION_SAMPLES 48
+
+/**
+ * A proxy is a tiny MJPEG movie of the frames a render sampled, next to the movie as "<movie>.proxy.avi",
+ * with an index of which movie frame each proxy frame is, "<movie>.proxy.txt". Later renders in any size
+ * or style read their columns from the nearest proxy frame instead of decoding the movie, upscaled back
+ * to the size the reducers expect.
+ */
+std::string GetMovieProxyPath(const std::string& movie_path);
+
+std::string GetMovieProxyIndexPath(const std::string& movie_path);
+
+/**
+ * Writes the proxy of a movie while it is rendered. Samples have to come in the order of the movie.
+ */
+class MovieProxyWriter {
+public:
+    MovieProxyWriter();
+
+    /**
+     * @param movie_path The path to the movie.
+     * @param frame_size The size of the decoded movie frames.
+     * @param frame_count The frames of the movie.
+     */
+    bool Open(const std::string& movie_path, cv::Size frame_size, int frame_count);
+
+    bool IsOpened() const;
+
+    /**
+     * @param frame_index The movie frame of the sample.
+     * @param frame The sample, at full or reduced resolution.
+     */
+    void AddSample(int frame_index, const cv::Mat& frame);
+
+    /**
+     * Finishes the proxy and writes its index. A proxy without samples is not kept.
+     */
+    bool Close();
+
+private:
+    std::string movie_path;
+    cv::VideoWriter writer;
+    cv::Size frame_size;
+    cv::Size proxy_size;
+    int frame_count;
+    std::vector<int> sample_frames;
+    cv::Mat proxy_frame;
+};
+
+/**
+ * Reads the proxy of a movie.
+ */
+class MovieProxy {
+public:
+    MovieProxy();
+
+    /**
+     * Loads the proxy of a movie, unless there is none or the movie changed since it was written.
+     */
+    bool Load(const std::string& movie_path);
+
+    int GetFrameCount() const;
+    cv::Size GetFrameSize() const;
+    int GetSampleCount() const;
+    int GetSampleFrame(int sample) const;
+
+    /**
+     * Get the sample closest to a movie frame.
+     */
+    int GetNearestSample(int frame_index) const;
+
+    /**
+     * Reads a sample. Reading the samples in order never seeks.
+     */
+    bool ReadSample(int sample, cv::Mat& frame);
+
+private:
+    cv::VideoCapture cap;
+    cv::Size frame_size;
+    int frame_count;
+    std::vector<int> sample_frames;
+
+    // The next sample the capture reads.
+    int position;
+};
+
+/**
+ * Renders an art image from the proxy of its movie.
+ *
+ * @param movie_path The path to the movie.
+ * @param art_image A reference to the image being created.
+ * @param options The style and the settings of the render.
+ * @return False when the movie has no proxy or the style needs more than one frame per column, without touching the image.
+ */
+bool RenderArtFromProxy(const std::string& movie_path, cv::Mat& art_image, const ArtRenderOptions& options);
+
+/**
+ * How columns made from the proxy compare with columns made from the decoded movie.
+ */
+struct ProxyValidationReport {
+    int column_count = 0;
+
+    // Per channel, in 0-255 levels, between the colors of the columns.
+    double mean_error = 0.0;
+    double max_error = 0.0;
+
+    double full_seconds = 0.0;
+    double proxy_seconds = 0.0;
+};
+
+/**
+ * Makes columns of some proxy samples both ways and compares them.
+ *
+ * @param movie_path The path to a movie with a proxy.
+ * @param art_height The height of the columns.
+ * @param options The style and the settings of the render.
+ * @param sample_count How many samples to compare, spread over the proxy.
+ * @return The report, with no columns when the movie has no proxy.
+ */
+ProxyValidationReport ValidateMovieProxy(const std::string& movie_path, int art_height, const ArtRenderOptions& options, int sample_count);
+
+void PrintProxyValidationReport(const ProxyValidationReport& report);
+
+#endif // !MOVIE_PROXY_H
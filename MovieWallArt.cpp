@@ -0,0 +1,1146 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* 
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023       
+*/
+
+#include "MovieWallArt.h"
+
+#include <climits>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "Concurrency.h"
+#include "DcAverage.h"
+#include "FrameEnergy.h"
+#include "MovieProxy.h"
+#include "PipelineTrace.h"
+#include "SparseAverage.h"
+
+using namespace cv;
+using namespace std;
+
+// Frames an FFmpeg decoder keeps for reference and reordering, besides one per decoding thread.
+#define ART_DECODER_BUFFERED_FRAMES 16
+
+// Failed grabs in a row after damage before the movie is taken as ended. Every grab already reads through
+// many packets looking for a frame.
+#define ART_DAMAGE_MAX_FAILED_GRABS 8
+
+// Smaller frames are reduced on the calling thread even with parallel reduction, waking the workers would take longer.
+#define ART_PARALLEL_REDUCTION_MIN_PIXELS (1280 * 720)
+
+/**
+ * Get the average color of the pixels of a frame kept by a mask, walking only the spans of each row.
+ */
+static Vec3b GetMaskedFrameAverageColor(Mat& frame, const RoiMask& roi_mask) {
+    long long pixel_color_b = 0;
+    long long pixel_color_g = 0;
+    long long pixel_color_r = 0;
+
+    for (int y = 0; y < frame.rows; y++) {
+        const Vec3b* row = frame.ptr<Vec3b>(y);
+
+        for (const RoiSpan* span = roi_mask.RowSpansBegin(y); span != roi_mask.RowSpansEnd(y); span++) {
+            for (int x = span->begin; x < span->end; x++) {
+                pixel_color_b += row[x][0];
+                pixel_color_g += row[x][1];
+                pixel_color_r += row[x][2];
+            }
+        }
+    }
+
+    long long kept_pixels = roi_mask.GetKeptPixels();
+
+    return Vec3b((uchar)(pixel_color_b / kept_pixels), (uchar)(pixel_color_g / kept_pixels), (uchar)(pixel_color_r / kept_pixels));
+}
+
+/**
+ * Get the pixel strip of the pixels of a frame kept by a mask.
+ * The strip segments cover the same pixels as in GetFramePixelStrip, so masked frames keep the same layout,
+ * but masked runs of each column are skipped over instead of read. Segments left with no pixels repeat the previous color.
+ */
+static vector<Vec3b> GetMaskedFramePixelStrip(Mat& frame, int strip_size, const RoiMask& roi_mask) {
+    vector<Vec3b> pixel_strip(strip_size);
+
+    int frame_h = frame.rows;
+    int frame_w = frame.cols;
+    long long frame_dimension = (long long)frame_h * frame_w;
+
+    long long segment_size = frame_dimension / strip_size + 1;
+    int strip_interval = (int)(frame_dimension / strip_size / strip_size);
+    int strip_index = 0;
+
+    long long position = 0;
+    long long segment_end = segment_size;
+    long long count = 0;
+    long long b = 0;
+    long long g = 0;
+    long long r = 0;
+    Vec3b color;
+
+    auto close_segment = [&]() {
+        if (count > 0)
+            color = Vec3b((uchar)(b / count), (uchar)(g / count), (uchar)(r / count));
+
+        for (int i = 0; i < strip_interval && strip_index < strip_size; i++)
+            pixel_strip[strip_index++] = color;
+
+        segment_end += segment_size;
+        count = 0;
+        b = 0;
+        g = 0;
+        r = 0;
+    };
+
+    auto skip = [&](long long pixels) {
+        while (pixels > 0) {
+            long long step = min(pixels, segment_end - position);
+            position += step;
+            pixels -= step;
+
+            if (position == segment_end)
+                close_segment();
+        }
+    };
+
+    for (int x = 0; x < frame_w && strip_index < strip_size; x++) {
+        int y = 0;
+
+        for (const RoiSpan* span = roi_mask.ColumnSpansBegin(x); span != roi_mask.ColumnSpansEnd(x); span++) {
+            skip(span->begin - y);
+
+            for (y = span->begin; y < span->end; y++) {
+                const Vec3b& pixel = frame.at<Vec3b>(y, x);
+                b += pixel[0];
+                g += pixel[1];
+                r += pixel[2];
+                count++;
+                position++;
+
+                if (position == segment_end)
+                    close_segment();
+            }
+        }
+
+        skip(frame_h - y);
+    }
+
+    return pixel_strip;
+}
+
+/**
+ * Sums the pixels of a frame column by column in integers, exactly like the parallel and masked sums, so the
+ * color doesn't depend on the path. A frame size known at compile time lets the compiler unroll the loops.
+ * Zero for either dimension reads it from the frame at run time.
+ */
+template<int kFrameW, int kFrameH>
+static Vec3b SumFrameAverageColor(const Mat& frame) {
+    const int frame_w = kFrameW > 0 ? kFrameW : frame.cols;
+    const int frame_h = kFrameH > 0 ? kFrameH : frame.rows;
+    const unsigned long long frame_dimension = (unsigned long long)frame_h * frame_w;
+    const size_t step = frame.step;
+
+    unsigned long long pixel_color_b = 0;
+    unsigned long long pixel_color_g = 0;
+    unsigned long long pixel_color_r = 0;
+
+    for (int w = 0; w < frame_w; w++) {
+        const uchar* pixel = frame.data + (size_t)w * 3;
+
+        for (int h = 0; h < frame_h; h++) {
+            pixel_color_b += pixel[0];
+            pixel_color_g += pixel[1];
+            pixel_color_r += pixel[2];
+            pixel += step;
+        }
+    }
+
+    return Vec3b((uchar)(pixel_color_b / frame_dimension), (uchar)(pixel_color_g / frame_dimension), (uchar)(pixel_color_r / frame_dimension));
+}
+
+/**
+ * Splits a frame in strip_size segments, walking it column by column, and averages each one.
+ * Zero for any of the sizes reads it at run time.
+ */
+template<int kFrameW, int kFrameH, int kStripSize>
+static vector<Vec3b> SumFramePixelStrip(const Mat& frame, int runtime_strip_size) {
+    const int frame_w = kFrameW > 0 ? kFrameW : frame.cols;
+    const int frame_h = kFrameH > 0 ? kFrameH : frame.rows;
+    const int strip_size = kStripSize > 0 ? kStripSize : runtime_strip_size;
+    const int frame_dimension = frame_h * frame_w;
+    const size_t step = frame.step;
+
+    vector<Vec3b> pixel_strip(strip_size);
+
+    const int sample_interval = frame_dimension / strip_size;
+    const int strip_interval = sample_interval / strip_size;
+    int count = 0;
+    int strip_index = 0;
+
+    float g = 0.0f;
+    float b = 0.0f;
+    float r = 0.0f;
+
+    for (int x = 0; x < frame_w; x++) {
+        const uchar* pixel = frame.data + (size_t)x * 3;
+
+        for (int y = 0; y < frame_h; y++) {
+            g += pixel[0];
+            b += pixel[1];
+            r += pixel[2];
+            pixel += step;
+
+            count++;
+
+            if (count > sample_interval) {
+                g = g / count;
+                b = b / count;
+                r = r / count;
+
+                for (int i = 0; i < strip_interval; i++) {
+                    if (strip_index < strip_size) {
+                        pixel_strip[strip_index] = Vec3b(g, b, r);
+                        strip_index++;
+                    }
+                }
+
+                count = 0;
+                g = 0.0f;
+                b = 0.0f;
+                r = 0.0f;
+            }
+        }
+    }
+
+    return pixel_strip;
+}
+
+template<int kFrameW, int kFrameH>
+static vector<Vec3b> SumFramePixelStripForArtHeight(const Mat& frame, int strip_size) {
+    if (strip_size == 1080)
+        return SumFramePixelStrip<kFrameW, kFrameH, 1080>(frame, strip_size);
+
+    if (strip_size == 2160)
+        return SumFramePixelStrip<kFrameW, kFrameH, 2160>(frame, strip_size);
+
+    return SumFramePixelStrip<kFrameW, kFrameH, 0>(frame, strip_size);
+}
+
+/**
+ * Get the average color of a frame with its rows split in bands among the workers of a pool. The sums of the
+ * bands are integers, so the color is the same however many workers there are, and the same as SumFrameAverageColor.
+ */
+static Vec3b SumFrameAverageColorParallel(const Mat& frame, ThreadPool& pool) {
+    const int band_count = min(frame.rows, pool.GetThreadCount() + 1);
+    const size_t row_bytes = (size_t)frame.cols * 3;
+
+    // Three channel sums per band.
+    vector<unsigned long long> band_sums((size_t)band_count * 3);
+
+    pool.ParallelFor(band_count, [&](int band) {
+        int first_row = (int)((long long)band * frame.rows / band_count);
+        int last_row = (int)((long long)(band + 1) * frame.rows / band_count);
+
+        unsigned long long b = 0;
+        unsigned long long g = 0;
+        unsigned long long r = 0;
+
+        for (int y = first_row; y < last_row; y++) {
+            const uchar* pixel = frame.ptr<uchar>(y);
+            const uchar* row_end = pixel + row_bytes;
+
+            for (; pixel < row_end; pixel += 3) {
+                b += pixel[0];
+                g += pixel[1];
+                r += pixel[2];
+            }
+        }
+
+        band_sums[band * 3] = b;
+        band_sums[band * 3 + 1] = g;
+        band_sums[band * 3 + 2] = r;
+    });
+
+    unsigned long long sum[3] = { 0, 0, 0 };
+
+    for (int band = 0; band < band_count; band++) {
+        for (int c = 0; c < 3; c++)
+            sum[c] += band_sums[band * 3 + c];
+    }
+
+    unsigned long long frame_dimension = (unsigned long long)frame.rows * frame.cols;
+
+    return Vec3b((uchar)(sum[0] / frame_dimension), (uchar)(sum[1] / frame_dimension), (uchar)(sum[2] / frame_dimension));
+}
+
+/**
+ * Get the pixel strip of a frame with its segments split among the workers of a pool. Each segment is summed
+ * by one worker in the same order as SumFramePixelStrip, so the strip is exactly the same as without the pool.
+ */
+static vector<Vec3b> SumFramePixelStripParallel(const Mat& frame, int strip_size, ThreadPool& pool) {
+    const int frame_w = frame.cols;
+    const int frame_h = frame.rows;
+    const int frame_dimension = frame_h * frame_w;
+    const size_t step = frame.step;
+
+    vector<Vec3b> pixel_strip(strip_size);
+
+    const int sample_interval = frame_dimension / strip_size;
+    const int strip_interval = sample_interval / strip_size;
+
+    if (strip_interval == 0)
+        return pixel_strip;
+
+    // A segment closes after sample_interval + 1 pixels, and only the ones that reach the strip are read.
+    const int segment_size = sample_interval + 1;
+    const int segment_count = min(frame_dimension / segment_size, (strip_size + strip_interval - 1) / strip_interval);
+    const int chunk_count = min(segment_count, pool.GetThreadCount() + 1);
+
+    pool.ParallelFor(chunk_count, [&](int chunk) {
+        int first_segment = (int)((long long)chunk * segment_count / chunk_count);
+        int last_segment = (int)((long long)(chunk + 1) * segment_count / chunk_count);
+
+        for (int segment = first_segment; segment < last_segment; segment++) {
+            int position = segment * segment_size;
+            int x = position / frame_h;
+            int y = position % frame_h;
+            const uchar* pixel = frame.data + (size_t)y * step + (size_t)x * 3;
+
+            float g = 0.0f;
+            float b = 0.0f;
+            float r = 0.0f;
+
+            for (int i = 0; i < segment_size; i++) {
+                g += pixel[0];
+                b += pixel[1];
+                r += pixel[2];
+                pixel += step;
+
+                if (++y == frame_h) {
+                    y = 0;
+                    x++;
+                    pixel = frame.data + (size_t)x * 3;
+                }
+            }
+
+            g = g / segment_size;
+            b = b / segment_size;
+            r = r / segment_size;
+
+            for (int i = 0; i < strip_interval; i++) {
+                int strip_index = segment * strip_interval + i;
+
+                if (strip_index < strip_size)
+                    pixel_strip[strip_index] = Vec3b(g, b, r);
+            }
+        }
+    });
+
+    return pixel_strip;
+}
+
+/**
+ * Get the pixel strip of a frame too small for the layout of SumFramePixelStrip, whose segments fill whole
+ * colors of the strip and need strip_size² pixels or more, like the reduced frames of a reduction width or of
+ * DC decoding. Walking the frame column by column, each color averages the pixels whose position scales to it,
+ * so any frame size fills the strip. Colors left with no pixels, masked or past a tiny frame, repeat the previous one.
+ */
+static vector<Vec3b> GetScaledFramePixelStrip(const Mat& frame, int strip_size, const RoiMask* roi_mask, ThreadPool* pool) {
+    const int frame_h = frame.rows;
+    const long long frame_dimension = (long long)frame_h * frame.cols;
+
+    // Blue, green, red and pixel count of every color.
+    vector<long long> sums((size_t)strip_size * 4, 0);
+
+    auto add_pixel = [&](long long entry, const uchar* pixel) {
+        long long* sum = &sums[(size_t)entry * 4];
+        sum[0] += pixel[0];
+        sum[1] += pixel[1];
+        sum[2] += pixel[2];
+        sum[3]++;
+    };
+
+    // The positions of colors [first_entry, last_entry), which no other range of colors shares.
+    auto add_entries = [&](int first_entry, int last_entry) {
+        long long position = (first_entry * frame_dimension + strip_size - 1) / strip_size;
+        long long last_position = (last_entry * frame_dimension + strip_size - 1) / strip_size;
+
+        for (; position < last_position; position++) {
+            int x = (int)(position / frame_h);
+            int y = (int)(position % frame_h);
+            add_pixel(position * strip_size / frame_dimension, frame.ptr<uchar>(y) + (size_t)x * 3);
+        }
+    };
+
+    if (roi_mask != nullptr) {
+        for (int x = 0; x < frame.cols; x++) {
+            for (const RoiSpan* span = roi_mask->ColumnSpansBegin(x); span != roi_mask->ColumnSpansEnd(x); span++) {
+                for (int y = span->begin; y < span->end; y++)
+                    add_pixel(((long long)x * frame_h + y) * strip_size / frame_dimension, frame.ptr<uchar>(y) + (size_t)x * 3);
+            }
+        }
+    }
+    else if (pool != nullptr && frame.total() >= ART_PARALLEL_REDUCTION_MIN_PIXELS) {
+        const int chunk_count = min(strip_size, pool->GetThreadCount() + 1);
+
+        pool->ParallelFor(chunk_count, [&](int chunk) {
+            add_entries((int)((long long)chunk * strip_size / chunk_count), (int)((long long)(chunk + 1) * strip_size / chunk_count));
+        });
+    }
+    else {
+        add_entries(0, strip_size);
+    }
+
+    vector<Vec3b> pixel_strip(strip_size);
+    Vec3b color;
+
+    for (int i = 0; i < strip_size; i++) {
+        const long long* sum = &sums[(size_t)i * 4];
+
+        if (sum[3] > 0)
+            color = Vec3b((uchar)(sum[0] / sum[3]), (uchar)(sum[1] / sum[3]), (uchar)(sum[2] / sum[3]));
+
+        pixel_strip[i] = color;
+    }
+
+    return pixel_strip;
+}
+
+/**
+ * Get the average color of a frame.
+ *
+ * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
+ * @param roi_mask Optional mask of the pixels to look at. Masked pixels are never read.
+ * @param pool Optional pool to split frames of ART_PARALLEL_REDUCTION_MIN_PIXELS or more among.
+ */
+Vec3b GetFrameAverageColor(Mat& frame, const RoiMask* roi_mask, ThreadPool* pool) {
+    if (roi_mask != nullptr && roi_mask->Fits(frame))
+        return GetMaskedFrameAverageColor(frame, *roi_mask);
+
+    if (pool != nullptr && frame.total() >= ART_PARALLEL_REDUCTION_MIN_PIXELS)
+        return SumFrameAverageColorParallel(frame, *pool);
+
+    if (frame.cols == 1920 && frame.rows == 1080)
+        return SumFrameAverageColor<1920, 1080>(frame);
+
+    if (frame.cols == 3840 && frame.rows == 2160)
+        return SumFrameAverageColor<3840, 2160>(frame);
+
+    if (frame.cols == 1280 && frame.rows == 720)
+        return SumFrameAverageColor<1280, 720>(frame);
+
+    return SumFrameAverageColor<0, 0>(frame);
+}
+
+/**
+ * Get the pixel strip of a frame.
+ *
+ * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
+ * @param roi_mask Optional mask of the pixels to look at. Masked pixels are never read.
+ * @param pool Optional pool to split frames of ART_PARALLEL_REDUCTION_MIN_PIXELS or more among.
+ */
+vector<Vec3b> GetFramePixelStrip(Mat& frame, int strip_size, const RoiMask* roi_mask, ThreadPool* pool) {
+    bool masked = roi_mask != nullptr && roi_mask->Fits(frame);
+
+    // Frames under strip_size² pixels would leave the strip of the segment layout black.
+    if ((long long)frame.total() / strip_size / strip_size == 0)
+        return GetScaledFramePixelStrip(frame, strip_size, masked ? roi_mask : nullptr, pool);
+
+    if (masked)
+        return GetMaskedFramePixelStrip(frame, strip_size, *roi_mask);
+
+    if (pool != nullptr && frame.total() >= ART_PARALLEL_REDUCTION_MIN_PIXELS)
+        return SumFramePixelStripParallel(frame, strip_size, *pool);
+
+    if (frame.cols == 1920 && frame.rows == 1080)
+        return SumFramePixelStripForArtHeight<1920, 1080>(frame, strip_size);
+
+    if (frame.cols == 3840 && frame.rows == 2160)
+        return SumFramePixelStripForArtHeight<3840, 2160>(frame, strip_size);
+
+    if (frame.cols == 1280 && frame.rows == 720)
+        return SumFramePixelStripForArtHeight<1280, 720>(frame, strip_size);
+
+    return SumFramePixelStripForArtHeight<0, 0>(frame, strip_size);
+}
+
+/**
+ * Whether a style looks at the frame after the sampled one, which then has to be decoded too.
+ */
+bool ArtStyleNeedsFollowingFrame(int style) {
+    return style == ART_STYLE_MOTION_ENERGY;
+}
+
+/**
+ * Get the color of a frame for the energy styles: its average color with the brightness, or the saturation
+ * for motion, set by how much detail or motion the frame has.
+ */
+static Vec3b GetFrameEnergyColor(Mat& frame, int style, ArtColumnContext* context) {
+    Mat small_frame;
+    Mat luma;
+    GetFrameEnergyPlanes(frame, small_frame, luma);
+
+    Scalar average = mean(small_frame);
+    Vec3b average_color((uchar)average[0], (uchar)average[1], (uchar)average[2]);
+
+    if (style == ART_STYLE_EDGE_ENERGY)
+        return EncodeEnergyAsBrightness(average_color, GetFrameEdgeEnergy(luma));
+
+    if (style == ART_STYLE_DETAIL_DENSITY)
+        return EncodeEnergyAsBrightness(average_color, GetFrameDetailDensity(luma));
+
+    Mat following_luma;
+    if (context != nullptr && !context->following_frame.empty()) {
+        Mat following_small;
+        GetFrameEnergyPlanes(context->following_frame, following_small, following_luma);
+    }
+
+    return EncodeEnergyAsSaturation(average_color, GetFrameMotionEnergy(luma, following_luma));
+}
+
+/**
+ * Paints a column of the art image with one color, or with one color per row when colors is given.
+ * Zero rows reads the height of the art at run time.
+ */
+template<int kRows>
+static void FillArtColumn(Mat& art_image, int column_id, Vec3b color, const Vec3b* colors) {
+    const int rows = kRows > 0 ? kRows : art_image.rows;
+    const size_t step = art_image.step;
+    uchar* pixel = art_image.data + (size_t)column_id * 3;
+
+    for (int i = 0; i < rows; i++) {
+        *(Vec3b*)pixel = colors != nullptr ? colors[i] : color;
+        pixel += step;
+    }
+}
+
+static void FillArtColumn(Mat& art_image, int column_id, Vec3b color, const Vec3b* colors = nullptr) {
+    if (art_image.rows == 1080)
+        FillArtColumn<1080>(art_image, column_id, color, colors);
+    else if (art_image.rows == 2160)
+        FillArtColumn<2160>(art_image, column_id, color, colors);
+    else
+        FillArtColumn<0>(art_image, column_id, color, colors);
+}
+
+/**
+ * Create a column in the art image.
+ *
+ * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
+ * @param art_image A reference to the new image being created.
+ * @param column_id The index of the column in the new image.
+ * @param style The style to render the new image. It can be any of the ART_STYLE_* constants.
+ * @param preview Whether to show the frame and the art being rendered. Only the main thread can show them.
+ * @param context Optional state of the render, like the region of interest or the following frame.
+ *                ART_STYLE_MOTION_VECTORS ignores the frame and needs the motion of the column here.
+ * @return ART_COLUMN_OK, or why the column was left untouched.
+ */
+int CreateArtColumn(Mat& frame, Mat& art_image, int column_id, int style, bool preview, ArtColumnContext* context) {
+    const RoiMask* roi_mask = context != nullptr ? context->roi_mask : nullptr;
+    ThreadPool* reduction_pool = context != nullptr ? context->reduction_pool : nullptr;
+
+    if (style == ART_STYLE_MOTION_VECTORS) {
+        if (context == nullptr || context->motion == nullptr)
+            return ART_COLUMN_INVALID_FRAME;
+
+        FillArtColumn(art_image, column_id, EncodeMotionSummary(*context->motion, context->motion_directions));
+
+        if (preview) {
+            TraceSpan span("preview", -1, column_id);
+            imshow("RENDERING...", art_image);
+            waitKey(1);
+        }
+
+        return ART_COLUMN_OK;
+    }
+
+    // Checked up front, so nothing in the reducers has to throw on a bad frame.
+    if (frame.empty() || frame.type() != CV_8UC3)
+        return ART_COLUMN_INVALID_FRAME;
+
+    {
+        TraceSpan span("reduce", -1, column_id);
+
+        if (style == ART_STYLE_CENTER_PIXEL) {
+            int frame_h = frame.size[0];
+            int frame_w = frame.size[1];
+
+            Vec3b column_color;
+
+            column_color = frame.at<Vec3b>(frame_h / 2, frame_w / 2);
+
+            FillArtColumn(art_image, column_id, column_color);
+        }
+        else  if (style == ART_STYLE_AVERAGE_COLOR) {
+            Vec3b column_color = GetFrameAverageColor(frame, roi_mask, reduction_pool);
+
+            FillArtColumn(art_image, column_id, column_color);
+        }
+        else if (style == ART_STYLE_SPARSE_AVERAGE) {
+            SparseAverageEstimate estimate = EstimateFrameAverageColor(frame, roi_mask);
+
+            FillArtColumn(art_image, column_id, estimate.color);
+
+            if (context != nullptr && context->sparse_log != nullptr)
+                context->sparse_log->AddColumn(column_id, estimate);
+        }
+        else if (style == ART_STYLE_PIXEL_STRIP) {
+            vector<Vec3b> column_colors = GetFramePixelStrip(frame, art_image.rows, roi_mask, reduction_pool);
+
+            FillArtColumn(art_image, column_id, Vec3b(), column_colors.data());
+        }
+        else if (style == ART_STYLE_EDGE_ENERGY || style == ART_STYLE_DETAIL_DENSITY || style == ART_STYLE_MOTION_ENERGY) {
+            Vec3b column_color = GetFrameEnergyColor(frame, style, context);
+
+            FillArtColumn(art_image, column_id, column_color);
+        }
+        else {
+            return ART_COLUMN_UNKNOWN_STYLE;
+        }
+    }
+
+    if (preview) {
+        TraceSpan span("preview", -1, column_id);
+        imshow("FRAME", frame);
+        imshow("RENDERING...", art_image);
+        waitKey(1);
+    }
+
+    return ART_COLUMN_OK;
+}
+
+/**
+ * Get the size frames are reduced to before the reducers look at them.
+ *
+ * @param frame_size The size of the decoded frames.
+ * @param reduction_width The width to reduce the frames to, or 0 to keep them at full resolution.
+ */
+Size GetReducedFrameSize(Size frame_size, int reduction_width) {
+    if (reduction_width <= 0 || reduction_width >= frame_size.width)
+        return frame_size;
+
+    int reduced_h = max(1, (int)((long long)frame_size.height * reduction_width / frame_size.width));
+
+    return Size(reduction_width, reduced_h);
+}
+
+/**
+ * Get an estimate of the memory a render holds while decoding: the frames pooled by the decoder, in 4:2:0,
+ * the converted frames the sampler reads, and their reduced copies.
+ *
+ * @param frame_size The size of the decoded frames.
+ * @param options The options of the render.
+ */
+long long EstimateRenderMemory(Size frame_size, const ArtRenderOptions& options) {
+    long long pixels = (long long)frame_size.width * frame_size.height;
+    int decoder_threads = options.decoder_threads > 0 ? options.decoder_threads : GetAvailableCores();
+    int sampled_frames = ArtStyleNeedsFollowingFrame(options.style) ? 2 : 1;
+
+    long long decoder_bytes = (ART_DECODER_BUFFERED_FRAMES + decoder_threads) * pixels * 3 / 2;
+    long long sampler_bytes = sampled_frames * pixels * 3;
+
+    Size reduced_size = GetReducedFrameSize(frame_size, options.reduction_width);
+
+    if (reduced_size != frame_size)
+        sampler_bytes += sampled_frames * (long long)reduced_size.width * reduced_size.height * 3;
+
+    return decoder_bytes + sampler_bytes;
+}
+
+/**
+ * Opens a movie with the decoder settings of a render.
+ *
+ * @param cap A reference to the capture to open.
+ * @param movie_path The path to the movie.
+ * @param options The options of the render.
+ */
+bool OpenMovieCapture(VideoCapture& cap, const string& movie_path, const ArtRenderOptions& options) {
+    if (options.decoder_threads > 0)
+        cap.open(movie_path, CAP_ANY, { CAP_PROP_N_THREADS, options.decoder_threads });
+    else
+        cap.open(movie_path);
+
+    return cap.isOpened();
+}
+
+ArtFrameSampler::ArtFrameSampler(VideoCapture& cap, const ArtRenderOptions& options, shared_ptr<const GopIndex> gop_index)
+    : cap(cap), options(options), gop_index(gop_index), position(-1), damaged_until(-1), dc_mode(false) {
+    frame_count = (int)cap.get(CAP_PROP_FRAME_COUNT);
+
+    if (options.dc_average && (options.style == ART_STYLE_AVERAGE_COLOR || options.style == ART_STYLE_PIXEL_STRIP))
+        dc_mode = IsDcDecodable(cap) && EnableDcDecoding(cap);
+
+    if (this->gop_index != nullptr && this->gop_index->IsEmpty())
+        this->gop_index = nullptr;
+}
+
+/**
+ * Whether decoding on from the current position reaches a frame at least as fast as seeking to it.
+ */
+bool ArtFrameSampler::CanDecodeForward(int target_frame) const {
+    if (position < 0 || target_frame < position)
+        return false;
+
+    if (options.sampling == ART_SAMPLING_SEQUENTIAL)
+        return true;
+
+    // A seek decodes from the keyframe before the target anyway, so the frames from the current position on are free
+    // as long as that keyframe isn't past it. Every sample of a GOP then comes out of a single pass.
+    if (options.sampling == ART_SAMPLING_GOP && gop_index != nullptr)
+        return gop_index->GetKeyframeBefore(target_frame) <= position;
+
+    return false;
+}
+
+int ArtFrameSampler::Read(int target_frame, ArtColumnContext& context) {
+    // Frames before the point the decoder recovered at fail right away, without decoding them again.
+    if (target_frame < damaged_until)
+        return ART_FRAME_DAMAGED;
+
+    // Grabbing decodes without converting the frame, which beats seeking when the samples are close together.
+    if (!CanDecodeForward(target_frame)) {
+        // Seeking right onto the keyframe decodes nothing before it, the samples of its GOP are then grabbed in order.
+        int seek_frame = options.sampling == ART_SAMPLING_GOP && gop_index != nullptr ? gop_index->GetKeyframeBefore(target_frame) : target_frame;
+
+        TraceSpan span("seek", target_frame);
+        cap.set(CAP_PROP_POS_FRAMES, seek_frame);
+        position = seek_frame;
+    }
+
+    {
+        TraceSpan span("decode", target_frame);
+
+        while (position < target_frame) {
+            if (!cap.grab())
+                return SkipDamage(position);
+            position++;
+        }
+
+        // DC frames are already 1/8 of the movie size, and the styles read this way don't look at the following frame.
+        if (dc_mode) {
+            if (!cap.read(packet) || !DecodeDcFrame(packet, frame))
+                return SkipDamage(target_frame);
+
+            position++;
+            return ART_FRAME_OK;
+        }
+
+        if (!cap.read(decoded) || decoded.empty())
+            return SkipDamage(target_frame);
+
+        position++;
+
+        if (ArtStyleNeedsFollowingFrame(options.style)) {
+            // Without a following frame the motion is measured as none, which is no reason to drop the column.
+            if (cap.read(decoded_following))
+                position++;
+            else {
+                decoded_following.release();
+                position = -1;
+            }
+        }
+    }
+
+    TraceSpan span("convert", target_frame);
+    Size reduced_size = GetReducedFrameSize(decoded.size(), options.reduction_width);
+
+    if (reduced_size == decoded.size()) {
+        frame = decoded;
+        context.following_frame = decoded_following;
+    }
+    else {
+        resize(decoded, frame, reduced_size, 0, 0, INTER_AREA);
+
+        if (!decoded_following.empty())
+            resize(decoded_following, context.following_frame, reduced_size, 0, 0, INTER_AREA);
+        else
+            context.following_frame.release();
+    }
+
+    return ART_FRAME_OK;
+}
+
+/**
+ * Moves the decoder past a damaged frame. A decoder gives frames again from the next keyframe on,
+ * so the first frame grabbed after the damage marks where the reads can start again.
+ *
+ * @param failed_frame The frame that could not be decoded.
+ * @return ART_FRAME_DAMAGED, or ART_FRAME_END_OF_MOVIE when no frame comes after it.
+ */
+int ArtFrameSampler::SkipDamage(int failed_frame) {
+    position = -1;
+
+    if (failed_frame >= frame_count) {
+        damaged_until = INT_MAX;
+        return ART_FRAME_END_OF_MOVIE;
+    }
+
+    for (int i = 0; i < ART_DAMAGE_MAX_FAILED_GRABS; i++) {
+        if (cap.grab()) {
+            int recovered_frame = (int)cap.get(CAP_PROP_POS_FRAMES) - 1;
+            damaged_until = max(failed_frame + 1, recovered_frame);
+            return ART_FRAME_DAMAGED;
+        }
+    }
+
+    damaged_until = INT_MAX;
+    return ART_FRAME_END_OF_MOVIE;
+}
+
+Mat& ArtFrameSampler::GetFrame() {
+    return frame;
+}
+
+/**
+ * Records a column left without a frame. Without a log, the column repeats the one on its left right away.
+ *
+ * @param art_image A reference to the image being created.
+ * @param column_id The column left without a frame.
+ * @param frame The frame that could not be used.
+ * @param damage_log Optional log that fills the column later, when the columns on both sides are done.
+ * @param first_column The first column of the range being rendered, the ones before it may not be done yet.
+ * @param column_offset The column of the whole image the first column of art_image is.
+ */
+static void LogDamagedColumn(Mat& art_image, int column_id, int frame, ArtDamageLog* damage_log, int first_column, int column_offset = 0) {
+    if (damage_log != nullptr)
+        damage_log->AddColumn(column_id, frame);
+    else if (column_id > first_column)
+        art_image.col(column_id - column_offset - 1).copyTo(art_image.col(column_id - column_offset));
+}
+
+/**
+ * Records the columns a render can't reach because the movie ended before their frames, from the first one
+ * it failed on to the end of its range.
+ *
+ * @param damage_log Optional log of the render.
+ * @param column_id The first column the movie ended before.
+ * @param last_column The index after the last column of the range being rendered.
+ * @param first_frame The movie frame shown by the first column of the image.
+ * @param frame_range The frames shown by the whole image.
+ * @param image_columns The width of the whole image.
+ * @param frame_count The frame count the movie reports.
+ */
+static void LogTruncatedColumns(ArtDamageLog* damage_log, int column_id, int last_column, int first_frame, int frame_range, int image_columns, int frame_count) {
+    if (damage_log == nullptr)
+        return;
+
+    int sample_interval = frame_range / image_columns;
+
+    for (; column_id < last_column; column_id++) {
+        int frame = first_frame + column_id * sample_interval;
+
+        if (sample_interval == 0)
+            frame = first_frame + (int)((long long)column_id * frame_range / image_columns);
+
+        if (frame >= frame_count)
+            break;
+
+        // Frame counts are estimated from the duration, so missing the very last sample is no damage.
+        if (frame + max(sample_interval, 1) < frame_count)
+            damage_log->AddColumn(column_id, frame, true);
+    }
+}
+
+/**
+ * Whether a render can use ART_STYLE_MOTION_VECTORS. Otherwise it falls back to ART_STYLE_MOTION_ENERGY,
+ * which decodes the sampled frames and compares them with the next ones.
+ */
+static bool CanRenderMotionVectors(const string& movie_path, MotionVectorReader& reader) {
+    static once_flag unsupported_warning;
+
+    if (!IsMotionVectorSupported()) {
+        call_once(unsupported_warning, []() {
+            cout << "Motion vectors need a build with MOVIE_WALL_ART_FFMPEG, using the motion energy style instead." << endl;
+        });
+        return false;
+    }
+
+    if (!reader.IsOpened() || reader.GetFrameCount() <= 0) {
+        cout << "Motion vectors can't be read from " << movie_path << ", using the motion energy style instead." << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Renders a range of columns with ART_STYLE_MOTION_VECTORS. Every frame of the movie is read, but only
+ * the motion vectors the decoder exports for it are looked at, and each column sums up all the frames
+ * up to the next one instead of a single sample.
+ *
+ * @param reader The opened motion vector reader of the movie.
+ * @param art_image A reference to the image, or to a band of rows of it, being created.
+ * @param first_column The index of the first column to render.
+ * @param last_column The index after the last column to render.
+ * @param options The options of the render.
+ * @param first_frame The movie frame shown by the first column of the image.
+ * @param last_frame The movie frame after the one shown by the last column of the image, or -1 for the end of the movie.
+ * @param damage_log Receives the columns left without frames.
+ * @param video_sink Optional sink that encodes a video out of the columns as they are created.
+ * @param image_width The width of the whole image when art_image only holds the columns of the range, or 0.
+ */
+static void RenderMotionVectorColumns(MotionVectorReader& reader, Mat& art_image, int first_column, int last_column, const ArtRenderOptions& options,
+                                      int first_frame, int last_frame, ArtDamageLog* damage_log, ArtVideoSink* video_sink, int image_width = 0) {
+    int frame_count = reader.GetFrameCount();
+    int image_columns = image_width > 0 ? image_width : art_image.cols;
+    int column_offset = image_width > 0 ? first_column : 0;
+
+    if (last_frame < 0)
+        last_frame = frame_count;
+
+    int frame_range = last_frame - first_frame;
+    int sample_interval = frame_range / image_columns;
+
+    MotionSummary summary;
+    ArtColumnContext context;
+    context.motion = &summary;
+    context.motion_directions = options.motion_directions;
+
+    Mat no_frame;
+    bool movie_goes_on = true;
+
+    reader.Seek(first_frame + first_column * sample_interval);
+
+    for (int column_id = first_column; column_id < last_column; column_id++) {
+        int current_frame = first_frame + column_id * sample_interval;
+        int end_frame = current_frame + max(sample_interval, 1);
+
+        if (current_frame >= frame_count)
+            break;
+
+        summary.Clear();
+
+        if (movie_goes_on) {
+            TraceSpan span("decode", current_frame, column_id);
+            movie_goes_on = reader.Accumulate(end_frame, summary);
+        }
+
+        if (summary.frame_count == 0 && !movie_goes_on) {
+            LogTruncatedColumns(damage_log, column_id, last_column, first_frame, frame_range, image_columns, frame_count);
+            break;
+        }
+
+        // No frame of the column could be decoded, or they were all keyframes, which carry no motion.
+        if (summary.frame_count == 0)
+            LogDamagedColumn(art_image, column_id, current_frame, damage_log, first_column, column_offset);
+        else
+            CreateArtColumn(no_frame, art_image, column_id - column_offset, options.style, options.preview, &context);
+
+        if (video_sink != nullptr) {
+            TraceSpan span("write column", current_frame, column_id);
+            video_sink->AddColumn(art_image, column_id);
+        }
+    }
+}
+
+/**
+ * Renders a range of columns of the art image with a video capture of its own.
+ * Nothing is shown while rendering, so several ranges can be rendered at once by worker threads.
+ *
+ * @param movie_path The path to the movie that is going to be processed.
+ * @param art_image A reference to the image, or to a band of rows of it, being created.
+ * @param first_column The index of the first column to render.
+ * @param last_column The index after the last column to render.
+ * @param options The style and the decoding settings of the render.
+ * @param first_frame The movie frame shown by the first column of the image.
+ * @param last_frame The movie frame after the one shown by the last column of the image, or -1 for the end of the movie.
+ * @param image_width The width of the whole image when art_image only holds the columns from first_column to last_column,
+ *                    like the fragment of a shard, or 0 when it is the whole image. The damage log gets the columns of
+ *                    the whole image, the sparse average log the columns of art_image.
+ */
+void RenderArtColumns(string movie_path, Mat& art_image, int first_column, int last_column, const ArtRenderOptions& options, int first_frame, int last_frame,
+                      int image_width) {
+    if (options.style == ART_STYLE_MOTION_VECTORS) {
+        MotionVectorReader reader(movie_path);
+
+        if (CanRenderMotionVectors(movie_path, reader)) {
+            RenderMotionVectorColumns(reader, art_image, first_column, last_column, options, first_frame, last_frame, options.damage_log, nullptr, image_width);
+            return;
+        }
+
+        ArtRenderOptions fallback_options = options;
+        fallback_options.style = ART_STYLE_MOTION_ENERGY;
+        RenderArtColumns(movie_path, art_image, first_column, last_column, fallback_options, first_frame, last_frame, image_width);
+        return;
+    }
+
+    VideoCapture cap;
+
+    if (!OpenMovieCapture(cap, movie_path, options)) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return;
+    }
+
+    int frame_count = cap.get(CAP_PROP_FRAME_COUNT);
+    Size frame_size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+
+    // Waits here while the other renders use up the memory budget, before the decoder fills its pool.
+    MemoryReservation reservation(EstimateRenderMemory(frame_size, options), options.memory_job);
+
+    ArtFrameSampler sampler(cap, options, options.sampling == ART_SAMPLING_GOP ? GetMovieGopIndex(movie_path) : nullptr);
+    ArtColumnContext context;
+    context.roi_mask = options.roi_mask;
+    context.sparse_log = options.sparse_log;
+    context.reduction_pool = options.parallel_reduction ? &GetSharedThreadPool() : nullptr;
+
+    if (last_frame < 0)
+        last_frame = frame_count;
+
+    // The sample interval is the one of the whole image, so a fragment shows the same frames as its columns of it.
+    int image_columns = image_width > 0 ? image_width : art_image.cols;
+    int column_offset = image_width > 0 ? first_column : 0;
+    int frame_range = last_frame - first_frame;
+    int sample_interval = frame_range / image_columns;
+
+    for (int column_id = first_column; column_id < last_column; column_id++) {
+        int current_frame = first_frame + column_id * sample_interval;
+
+        // Ranges shorter than the image repeat frames instead of showing the ones after the range.
+        if (sample_interval == 0)
+            current_frame = first_frame + (int)((long long)column_id * frame_range / image_columns);
+
+        if (current_frame >= frame_count)
+            break;
+
+        int status = sampler.Read(current_frame, context);
+
+        if (status == ART_FRAME_OK && CreateArtColumn(sampler.GetFrame(), art_image, column_id - column_offset, options.style, false, &context) != ART_COLUMN_OK)
+            status = ART_FRAME_DAMAGED;
+
+        if (status == ART_FRAME_END_OF_MOVIE) {
+            LogTruncatedColumns(options.damage_log, column_id, last_column, first_frame, frame_range, image_columns, frame_count);
+            break;
+        }
+
+        if (status == ART_FRAME_DAMAGED)
+            LogDamagedColumn(art_image, column_id, current_frame, options.damage_log, first_column, column_offset);
+    }
+
+    cap.release();
+}
+
+/**
+ * Starts the process of creating a new art image.
+ *
+ * @param movie_path The path to the movie that is going to be processed to generate the new art.
+ * @param art_image A reference to the new image being created.
+ * @param options The style and the decoding settings of the render.
+ * @param video_sink Optional sink that encodes a video out of the columns as they are created.
+ */
+void CreateMovieWallArt(string movie_path, Mat& art_image, const ArtRenderOptions& options, ArtVideoSink* video_sink) {
+    if (options.style == ART_STYLE_MOTION_VECTORS) {
+        MotionVectorReader reader(movie_path);
+
+        if (CanRenderMotionVectors(movie_path, reader)) {
+            ArtDamageLog damage_log;
+
+            if (video_sink != nullptr)
+                video_sink->SyncToMovie(reader.GetFps(), reader.GetFrameCount() / art_image.cols);
+
+            RenderMotionVectorColumns(reader, art_image, 0, art_image.cols, options, 0, -1, &damage_log, video_sink);
+
+            damage_log.FillFromNeighbours(art_image);
+            damage_log.Report(movie_path, reader.GetFps());
+
+            if (options.preview)
+                waitKey(0);
+            return;
+        }
+
+        ArtRenderOptions fallback_options = options;
+        fallback_options.style = ART_STYLE_MOTION_ENERGY;
+        CreateMovieWallArt(movie_path, art_image, fallback_options, video_sink);
+        return;
+    }
+
+    VideoCapture cap;
+
+    if (!OpenMovieCapture(cap, movie_path, options)) {
+        cout << "Error opening video file." << endl;
+    }
+    else {
+        Size frame_size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+        MemoryReservation reservation(EstimateRenderMemory(frame_size, options), options.memory_job);
+
+        // Getting the first frame guarantees that the properties are read correctly.
+        Mat frame(frame_size.height, frame_size.width, CV_8UC3, USAGE_ALLOCATE_HOST_MEMORY);
+        cap >> frame;
+
+        int frame_count = cap.get(CAP_PROP_FRAME_COUNT);
+        int sample_interval = frame_count / art_image.cols;
+        int current_frame = 0;
+        int column_id = 0;
+
+        ArtFrameSampler sampler(cap, options, options.sampling == ART_SAMPLING_GOP ? GetMovieGopIndex(movie_path) : nullptr);
+        ArtColumnContext context;
+        context.roi_mask = options.roi_mask;
+        context.sparse_log = options.sparse_log;
+        context.reduction_pool = options.parallel_reduction ? &GetSharedThreadPool() : nullptr;
+
+        ArtDamageLog damage_log;
+
+        if (video_sink != nullptr)
+            video_sink->SyncToMovie(cap.get(CAP_PROP_FPS), sample_interval);
+
+        if (options.proxy_writer != nullptr && !options.proxy_writer->IsOpened())
+            options.proxy_writer->Open(movie_path, frame_size, frame_count);
+
+        while (current_frame < frame_count && column_id < art_image.cols)
+        {
+            int status = sampler.Read(current_frame, context);
+
+            if (status == ART_FRAME_OK && options.proxy_writer != nullptr)
+                options.proxy_writer->AddSample(current_frame, sampler.GetFrame());
+
+            if (status == ART_FRAME_OK && CreateArtColumn(sampler.GetFrame(), art_image, column_id, options.style, options.preview, &context) != ART_COLUMN_OK)
+                status = ART_FRAME_DAMAGED;
+
+            if (status == ART_FRAME_END_OF_MOVIE) {
+                LogTruncatedColumns(&damage_log, column_id, art_image.cols, 0, frame_count, art_image.cols, frame_count);
+                break;
+            }
+
+            if (status == ART_FRAME_DAMAGED) {
+                damage_log.AddColumn(column_id, current_frame);
+
+                // Holds the last color until the damage can be blended, so the preview and the video don't flash black.
+                if (column_id > 0)
+                    art_image.col(column_id - 1).copyTo(art_image.col(column_id));
+            }
+
+            if (video_sink != nullptr) {
+                TraceSpan span("write column", current_frame, column_id);
+                video_sink->AddColumn(art_image, column_id);
+            }
+
+            current_frame += sample_interval;
+            column_id++;
+        }
+
+        damage_log.FillFromNeighbours(art_image);
+        damage_log.Report(movie_path, cap.get(CAP_PROP_FPS));
+
+        if (options.proxy_writer != nullptr)
+            options.proxy_writer->Close();
+
+        cap.release();
+
+        if (options.preview)
+            waitKey(0);
+    }
+}
@@ -0,0 +1,194 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef MOVIE_WALL_ART_H
+#define MOVIE_WALL_ART_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "ArtDamage.h"
+#include "ArtVideo.h"
+#include "GopIndex.h"
+#include "MemoryGovernor.h"
+#include "MotionVectors.h"
+#include "RoiMask.h"
+#include "ThreadPool.h"
+
+class MovieProxyWriter;
+class SparseAverageLog;
+
+#define ART_STYLE_CENTER_PIXEL 1
+#define ART_STYLE_AVERAGE_COLOR 2
+#define ART_STYLE_PIXEL_STRIP 3
+#define ART_STYLE_EDGE_ENERGY 4
+#define ART_STYLE_DETAIL_DENSITY 5
+#define ART_STYLE_MOTION_ENERGY 6
+#define ART_STYLE_MOTION_VECTORS 7
+#define ART_STYLE_SPARSE_AVERAGE 8
+
+#define ART_SAMPLING_SEEK 1
+#define ART_SAMPLING_SEQUENTIAL 2
+#define ART_SAMPLING_GOP 3
+
+// What reading a sampled frame gives.
+#define ART_FRAME_OK 0
+#define ART_FRAME_DAMAGED 1
+#define ART_FRAME_END_OF_MOVIE 2
+
+// What creating a column gives.
+#define ART_COLUMN_OK 0
+#define ART_COLUMN_INVALID_FRAME 1
+#define ART_COLUMN_UNKNOWN_STYLE 2
+
+/**
+ * How a render reads the movie and reduces its frames.
+ */
+struct ArtRenderOptions {
+    int style = ART_STYLE_PIXEL_STRIP;
+
+    // FFmpeg decoding threads of each capture, or 0 for the backend default.
+    int decoder_threads = 0;
+
+    // ART_SAMPLING_SEEK seeks to every sampled frame, ART_SAMPLING_SEQUENTIAL decodes through the frames in between,
+    // ART_SAMPLING_GOP seeks once per GOP, following the keyframe index of the movie, and decodes all its samples in one pass.
+    int sampling = ART_SAMPLING_SEEK;
+
+    // Frames are downscaled to this width before the reducers look at them, or 0 to keep them at full resolution.
+    int reduction_width = 0;
+
+    // Experimental: the average color and pixel strip styles read MJPEG movies from the DC coefficients of their
+    // blocks instead of decoding them. See DcAverage.h.
+    bool dc_average = false;
+
+    // ART_STYLE_MOTION_VECTORS colors the columns by the main direction of the motion instead of leaving them gray.
+    bool motion_directions = false;
+
+    // Splits every frame of the average color and pixel strip styles among the workers of the shared pool,
+    // for the lowest latency per frame when a single render is running.
+    bool parallel_reduction = false;
+
+    const RoiMask* roi_mask = nullptr;
+    bool preview = true;
+
+    // Optional job the decoding memory of the render is charged to.
+    MemoryJob* memory_job = nullptr;
+
+    // Optional log of the columns left without a frame, filled once every segment of the image is done.
+    // Without one, a damaged column repeats the column on its left.
+    ArtDamageLog* damage_log = nullptr;
+
+    // Optional writer of a proxy of the sampled frames, filled by CreateMovieWallArt. See MovieProxy.h.
+    MovieProxyWriter* proxy_writer = nullptr;
+
+    // Optional log of the samples and the error bound of every column of ART_STYLE_SPARSE_AVERAGE.
+    SparseAverageLog* sparse_log = nullptr;
+};
+
+/**
+ * What CreateArtColumn needs besides the current frame. Every render keeps its own.
+ */
+struct ArtColumnContext {
+    const RoiMask* roi_mask = nullptr;
+
+    // The frame right after the current one, read only for the styles that measure motion.
+    cv::Mat following_frame;
+
+    // Optional pool the reducers split large frames among.
+    ThreadPool* reduction_pool = nullptr;
+
+    // The motion of the frames of the column, for ART_STYLE_MOTION_VECTORS, which needs no frame.
+    const MotionSummary* motion = nullptr;
+    bool motion_directions = false;
+
+    SparseAverageLog* sparse_log = nullptr;
+};
+
+bool ArtStyleNeedsFollowingFrame(int style);
+
+cv::Vec3b GetFrameAverageColor(cv::Mat& frame, const RoiMask* roi_mask = nullptr, ThreadPool* pool = nullptr);
+
+std::vector<cv::Vec3b> GetFramePixelStrip(cv::Mat& frame, int strip_size, const RoiMask* roi_mask = nullptr, ThreadPool* pool = nullptr);
+
+int CreateArtColumn(cv::Mat& frame, cv::Mat& art_image, int column_id, int style = ART_STYLE_AVERAGE_COLOR, bool preview = true, ArtColumnContext* context = nullptr);
+
+cv::Size GetReducedFrameSize(cv::Size frame_size, int reduction_width);
+
+long long EstimateRenderMemory(cv::Size frame_size, const ArtRenderOptions& options);
+
+bool OpenMovieCapture(cv::VideoCapture& cap, const std::string& movie_path, const ArtRenderOptions& options);
+
+/**
+ * Reads the sampled frames of a render, following the sampling strategy and reduction resolution of its options.
+ *
+ * A frame that can't be decoded makes the sampler skip ahead until the decoder gives frames again, which happens
+ * at the next keyframe. The samples in between fail right away instead of decoding the damaged frames again.
+ */
+class ArtFrameSampler {
+public:
+    /**
+     * @param cap A reference to the opened capture of the movie.
+     * @param options The options of the render.
+     * @param gop_index The keyframe index of the movie, needed by ART_SAMPLING_GOP. Without one it seeks to every sample.
+     */
+    ArtFrameSampler(cv::VideoCapture& cap, const ArtRenderOptions& options, std::shared_ptr<const GopIndex> gop_index = nullptr);
+
+    /**
+     * Reads a frame, and the one after it when the style needs it.
+     *
+     * @param target_frame The index of the frame to read.
+     * @param context Receives the following frame.
+     * @return ART_FRAME_OK, ART_FRAME_DAMAGED or ART_FRAME_END_OF_MOVIE.
+     */
+    int Read(int target_frame, ArtColumnContext& context);
+
+    cv::Mat& GetFrame();
+
+private:
+    int SkipDamage(int failed_frame);
+
+    bool CanDecodeForward(int target_frame) const;
+
+    cv::VideoCapture& cap;
+    const ArtRenderOptions& options;
+    std::shared_ptr<const GopIndex> gop_index;
+
+    // The index of the next frame the capture decodes, or -1 when it is unknown and the next read seeks.
+    int position;
+    int frame_count;
+
+    // Frames before this one are known to be damaged.
+    int damaged_until;
+
+    // The capture hands out compressed packets, and frames are made of their DC coefficients.
+    bool dc_mode;
+    cv::Mat packet;
+
+    cv::Mat decoded;
+    cv::Mat decoded_following;
+    cv::Mat frame;
+};
+
+void RenderArtColumns(std::string movie_path, cv::Mat& art_image, int first_column, int last_column, const ArtRenderOptions& options, int first_frame = 0, int last_frame = -1,
+                      int image_width = 0);
+
+void CreateMovieWallArt(std::string movie_path, cv::Mat& art_image, const ArtRenderOptions& options, ArtVideoSink* video_sink = nullptr);
+
+#endif // !MOVIE_WALL_ART_H
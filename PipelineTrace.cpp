@@ -0,0 +1,140 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "PipelineTrace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+struct TraceEvent {
+    const char* name;
+    int frame;
+    int column;
+    long long start_us;
+    long long duration_us;
+};
+
+struct TraceBuffer {
+    int thread_id;
+    vector<TraceEvent> events;
+};
+
+static atomic<bool> trace_enabled(false);
+static chrono::steady_clock::time_point trace_start;
+
+// Owns the buffer of every thread that recorded a span, so the spans outlive the worker threads.
+static mutex trace_buffers_mutex;
+static vector<unique_ptr<TraceBuffer>> trace_buffers;
+
+static long long GetTraceMicroseconds() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - trace_start).count();
+}
+
+static TraceBuffer& GetThreadTraceBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+
+    // Only the first span of a thread takes the lock.
+    if (buffer == nullptr) {
+        lock_guard<mutex> lock(trace_buffers_mutex);
+        trace_buffers.push_back(unique_ptr<TraceBuffer>(new TraceBuffer()));
+        buffer = trace_buffers.back().get();
+        buffer->thread_id = (int)trace_buffers.size();
+    }
+
+    return *buffer;
+}
+
+void EnablePipelineTrace() {
+    trace_start = chrono::steady_clock::now();
+    trace_enabled = true;
+}
+
+bool IsPipelineTraceEnabled() {
+    return trace_enabled.load(memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* name, int frame, int column) : name(name), frame(frame), column(column), start_us(-1) {
+    if (IsPipelineTraceEnabled())
+        start_us = GetTraceMicroseconds();
+}
+
+TraceSpan::~TraceSpan() {
+    if (start_us < 0)
+        return;
+
+    TraceEvent event;
+    event.name = name;
+    event.frame = frame;
+    event.column = column;
+    event.start_us = start_us;
+    event.duration_us = GetTraceMicroseconds() - start_us;
+
+    GetThreadTraceBuffer().events.push_back(event);
+}
+
+bool WriteChromeTrace(const string& trace_path) {
+    ofstream file(trace_path);
+
+    if (!file.is_open()) {
+        cout << "Error writing the trace " << trace_path << endl;
+        return false;
+    }
+
+    lock_guard<mutex> lock(trace_buffers_mutex);
+    size_t event_count = 0;
+    bool first = true;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (const unique_ptr<TraceBuffer>& buffer : trace_buffers) {
+        file << (first ? "\n" : ",\n")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+             << ",\"args\":{\"name\":\"thread " << buffer->thread_id << "\"}}";
+        first = false;
+
+        // Complete events, one per span, with the frame and the column as arguments.
+        for (const TraceEvent& event : buffer->events) {
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                 << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << ",\"args\":{";
+
+            if (event.frame >= 0)
+                file << "\"frame\":" << event.frame << (event.column >= 0 ? "," : "");
+
+            if (event.column >= 0)
+                file << "\"column\":" << event.column;
+
+            file << "}}";
+        }
+
+        event_count += buffer->events.size();
+    }
+
+    file << "\n]}\n";
+
+    cout << "Trace: " << event_count << " spans on " << trace_buffers.size() << " threads written to " << trace_path << endl;
+
+    return (bool)file;
+}
@@ -0,0 +1,70 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef PIPELINE_TRACE_H
+#define PIPELINE_TRACE_H
+
+#include <string>
+
+/**
+ * Optional timeline of the render pipeline: one span per frame and stage, like seeking, decoding or reducing,
+ * written as Chrome trace events that chrome://tracing and Perfetto load.
+ *
+ * Every thread records into a buffer of its own, so recording takes no lock. The buffers are only read by
+ * WriteChromeTrace, once the renders are done.
+ */
+
+/**
+ * Starts recording spans. Spans started before are dropped.
+ */
+void EnablePipelineTrace();
+
+bool IsPipelineTraceEnabled();
+
+/**
+ * Writes every recorded span as Chrome trace event JSON. No render may be running.
+ *
+ * @param trace_path Where to write the trace.
+ */
+bool WriteChromeTrace(const std::string& trace_path);
+
+/**
+ * Records the time from its creation to the end of its scope, when tracing is enabled.
+ */
+class TraceSpan {
+public:
+    /**
+     * @param name The stage, which has to outlive the trace, like a string literal.
+     * @param frame The frame the stage works on, or -1.
+     * @param column The column of the art the stage works on, or -1.
+     */
+    explicit TraceSpan(const char* name, int frame = -1, int column = -1);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    int frame;
+    int column;
+    long long start_us;
+};
+
+#endif // !PIPELINE_TRACE_H
@@ -0,0 +1,114 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "QualityControl.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+FrameRunAnalyzer::FrameRunAnalyzer(const string& name, int interval, double min_seconds)
+    : name(name), interval(max(1, interval)), min_seconds(min_seconds), fps(0.0) {
+}
+
+bool FrameRunAnalyzer::Begin(const FrameBusInfo& info, FrameSubscription& subscription) {
+    movie_path = info.movie_path;
+    fps = info.fps;
+    ranges.clear();
+
+    subscription.interval = interval;
+    subscription.width = QC_ANALYSIS_WIDTH;
+
+    return true;
+}
+
+void FrameRunAnalyzer::Analyze(int frame_index, const Mat& frame) {
+    cvtColor(frame, luma, COLOR_BGR2GRAY);
+
+    if (!IsFlagged(luma))
+        return;
+
+    // A frame right after a run extends it.
+    if (!ranges.empty() && ranges.back().last_frame + interval >= frame_index)
+        ranges.back().last_frame = frame_index;
+    else
+        ranges.push_back({ frame_index, frame_index });
+}
+
+void FrameRunAnalyzer::Finish() {
+    if (fps <= 0.0)
+        return;
+
+    int min_frames = (int)(min_seconds * fps);
+
+    // Every frame looked at stands for the ones up to the next.
+    ranges.erase(remove_if(ranges.begin(), ranges.end(), [&](const FrameRange& range) {
+        return range.last_frame - range.first_frame + interval < min_frames;
+    }), ranges.end());
+}
+
+const vector<FrameRange>& FrameRunAnalyzer::GetRanges() const {
+    return ranges;
+}
+
+void FrameRunAnalyzer::Report() const {
+    cout << movie_path << ": " << ranges.size() << " runs of " << name << "." << endl;
+
+    for (const FrameRange& range : ranges) {
+        cout << "  frames " << range.first_frame << " to " << range.last_frame;
+
+        if (fps > 0.0)
+            cout << " (" << range.first_frame / fps << "s to " << (range.last_frame + interval) / fps << "s)";
+
+        cout << endl;
+    }
+}
+
+BlackFrameAnalyzer::BlackFrameAnalyzer(int interval) : FrameRunAnalyzer("black frames", interval, QC_MIN_BLACK_SECONDS) {
+}
+
+bool BlackFrameAnalyzer::IsFlagged(const Mat& luma) {
+    int bright_pixels = countNonZero(luma > QC_BLACK_PIXEL_LEVEL);
+
+    return bright_pixels <= (1.0 - QC_BLACK_FRAME_RATIO) * luma.total();
+}
+
+FreezeFrameAnalyzer::FreezeFrameAnalyzer(int interval) : FrameRunAnalyzer("frozen frames", interval, QC_MIN_FREEZE_SECONDS) {
+}
+
+bool FreezeFrameAnalyzer::Begin(const FrameBusInfo& info, FrameSubscription& subscription) {
+    previous_luma.release();
+
+    return FrameRunAnalyzer::Begin(info, subscription);
+}
+
+bool FreezeFrameAnalyzer::IsFlagged(const Mat& luma) {
+    bool frozen = false;
+
+    if (!previous_luma.empty() && previous_luma.size() == luma.size()) {
+        absdiff(luma, previous_luma, difference);
+        frozen = mean(difference)[0] < QC_FREEZE_MAX_DIFFERENCE;
+    }
+
+    luma.copyTo(previous_luma);
+
+    return frozen;
+}
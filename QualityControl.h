@@ -0,0 +1,118 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef QUALITY_CONTROL_H
+#define QUALITY_CONTROL_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "AnalyzerBus.h"
+
+// Width the quality control analyzers look at the frames in.
+#define QC_ANALYSIS_WIDTH 64
+
+// Luma up to which a pixel counts as black, and the part of a frame that has to be black for the frame to be.
+#define QC_BLACK_PIXEL_LEVEL 32
+#define QC_BLACK_FRAME_RATIO 0.98
+
+// Mean luma difference, in levels, under which a frame counts as the same as the one analyzed before it.
+#define QC_FREEZE_MAX_DIFFERENCE 0.5
+
+// Shortest runs reported, in seconds.
+#define QC_MIN_BLACK_SECONDS 0.5
+#define QC_MIN_FREEZE_SECONDS 2.0
+
+/**
+ * A run of frames, both ends included.
+ */
+struct FrameRange {
+    int first_frame;
+    int last_frame;
+};
+
+/**
+ * Finds the runs of frames a quality control check flags, like black or frozen frames.
+ */
+class FrameRunAnalyzer : public FrameAnalyzer {
+public:
+    /**
+     * @param name What the runs are, for the report.
+     * @param interval Frames between the frames looked at, 1 to look at every frame.
+     * @param min_seconds The shortest runs reported.
+     */
+    FrameRunAnalyzer(const std::string& name, int interval, double min_seconds);
+
+    bool Begin(const FrameBusInfo& info, FrameSubscription& subscription) override;
+    void Analyze(int frame_index, const cv::Mat& frame) override;
+    void Finish() override;
+
+    const std::vector<FrameRange>& GetRanges() const;
+
+    /**
+     * Prints the runs, in frames and as times.
+     */
+    void Report() const;
+
+protected:
+    /**
+     * Whether a frame is flagged.
+     *
+     * @param luma The frame, converted to gray.
+     */
+    virtual bool IsFlagged(const cv::Mat& luma) = 0;
+
+private:
+    std::string name;
+    int interval;
+    double min_seconds;
+
+    std::string movie_path;
+    double fps;
+    std::vector<FrameRange> ranges;
+    cv::Mat luma;
+};
+
+class BlackFrameAnalyzer : public FrameRunAnalyzer {
+public:
+    explicit BlackFrameAnalyzer(int interval = 1);
+
+protected:
+    bool IsFlagged(const cv::Mat& luma) override;
+};
+
+/**
+ * Flags frames that are the same as the frame looked at before them.
+ */
+class FreezeFrameAnalyzer : public FrameRunAnalyzer {
+public:
+    explicit FreezeFrameAnalyzer(int interval = 1);
+
+    bool Begin(const FrameBusInfo& info, FrameSubscription& subscription) override;
+
+protected:
+    bool IsFlagged(const cv::Mat& luma) override;
+
+private:
+    cv::Mat previous_luma;
+    cv::Mat difference;
+};
+
+#endif // !QUALITY_CONTROL_H
@@ -0,0 +1,234 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "RangeRender.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+RangeRenderer::RangeRenderer(const string& movie_path, int art_height, const ArtRenderOptions& options, long long cache_bytes)
+    : movie_path(movie_path), art_height(art_height), options(options), frame_count(0), fps(0.0), cache_bytes(cache_bytes), used_bytes(0),
+      use_clock(0) {
+    // The segments are rendered on their own and in any order, so nothing is logged or written along.
+    this->options.preview = false;
+    this->options.damage_log = nullptr;
+    this->options.proxy_writer = nullptr;
+    this->options.sparse_log = nullptr;
+
+    VideoCapture cap;
+
+    if (OpenMovieCapture(cap, movie_path, options)) {
+        frame_count = (int)cap.get(CAP_PROP_FRAME_COUNT);
+        fps = cap.get(CAP_PROP_FPS);
+    }
+}
+
+int RangeRenderer::GetFrameCount() const {
+    return frame_count;
+}
+
+double RangeRenderer::GetFps() const {
+    return fps;
+}
+
+int RangeRenderer::GetSegmentFrames(int level) const {
+    return RANGE_SEGMENT_COLUMNS << level;
+}
+
+Mat RangeRenderer::FindSegment(int level, int index) {
+    lock_guard<mutex> lock(cache_mutex);
+
+    auto found = segments.find(make_pair(level, index));
+
+    if (found == segments.end())
+        return Mat();
+
+    found->second.last_use = ++use_clock;
+
+    return found->second.columns;
+}
+
+void RangeRenderer::StoreSegment(int level, int index, const Mat& columns) {
+    lock_guard<mutex> lock(cache_mutex);
+
+    Segment& segment = segments[make_pair(level, index)];
+
+    if (!segment.columns.empty())
+        used_bytes -= (long long)segment.columns.total() * segment.columns.elemSize();
+
+    segment.columns = columns;
+    segment.last_use = ++use_clock;
+    used_bytes += (long long)columns.total() * columns.elemSize();
+
+    while (used_bytes > cache_bytes && segments.size() > 1) {
+        auto oldest = min_element(segments.begin(), segments.end(), [](const decltype(segments)::value_type& a, const decltype(segments)::value_type& b) {
+            return a.second.last_use < b.second.last_use;
+        });
+
+        used_bytes -= (long long)oldest->second.columns.total() * oldest->second.columns.elemSize();
+        segments.erase(oldest);
+    }
+}
+
+/**
+ * Builds a segment out of the two segments of the level below it, whose every other column it is, looking
+ * further down for the ones that aren't cached either.
+ */
+bool RangeRenderer::DeriveSegment(int level, int index, int depth, Mat& columns) {
+    if (level == 0 || depth == 0)
+        return false;
+
+    Mat children[2];
+
+    for (int i = 0; i < 2; i++) {
+        int child_index = index * 2 + i;
+
+        // Past the end of the movie there is nothing to decode.
+        if ((long long)child_index * GetSegmentFrames(level - 1) >= frame_count) {
+            children[i] = Mat::zeros(art_height, RANGE_SEGMENT_COLUMNS, CV_8UC3);
+            continue;
+        }
+
+        children[i] = FindSegment(level - 1, child_index);
+
+        if (children[i].empty()) {
+            if (!DeriveSegment(level - 1, child_index, depth - 1, children[i]))
+                return false;
+
+            StoreSegment(level - 1, child_index, children[i]);
+        }
+    }
+
+    columns = Mat(art_height, RANGE_SEGMENT_COLUMNS, CV_8UC3);
+
+    for (int column = 0; column < RANGE_SEGMENT_COLUMNS; column++) {
+        int child_column = column * 2;
+        children[child_column / RANGE_SEGMENT_COLUMNS].col(child_column % RANGE_SEGMENT_COLUMNS).copyTo(columns.col(column));
+    }
+
+    return true;
+}
+
+Mat RangeRenderer::DecodeSegment(int level, int index) {
+    ArtRenderOptions segment_options = options;
+
+    if (segment_options.sampling == ART_SAMPLING_SEEK && (1 << level) <= RANGE_SEQUENTIAL_INTERVAL)
+        segment_options.sampling = ART_SAMPLING_SEQUENTIAL;
+
+    // The range of the segment is exactly RANGE_SEGMENT_COLUMNS samples of 2^level frames.
+    int first_frame = index * GetSegmentFrames(level);
+    Mat columns = Mat::zeros(art_height, RANGE_SEGMENT_COLUMNS, CV_8UC3);
+    RenderArtColumns(movie_path, columns, 0, RANGE_SEGMENT_COLUMNS, segment_options, first_frame, first_frame + GetSegmentFrames(level));
+
+    return columns;
+}
+
+bool RangeRenderer::Render(double first_seconds, double last_seconds, Mat& art_image, RangeRenderStats* stats) {
+    if (frame_count <= 0 || fps <= 0.0) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return false;
+    }
+
+    int first_frame = (int)max(0LL, llround(first_seconds * fps));
+    int last_frame = (int)min((long long)frame_count, llround(last_seconds * fps));
+
+    if (last_frame <= first_frame || art_image.rows != art_height || art_image.cols <= 0) {
+        cout << "Error: the range " << first_seconds << "s to " << last_seconds << "s isn't in the movie." << endl;
+        return false;
+    }
+
+    int64 start = getTickCount();
+    RangeRenderStats render_stats;
+
+    // The coarsest level that still samples a frame per column, or every frame of short ranges.
+    int frame_range = last_frame - first_frame;
+    int level = 0;
+
+    while (level < RANGE_MAX_LEVEL && (2LL << level) * art_image.cols <= frame_range)
+        level++;
+
+    int segment_frames = GetSegmentFrames(level);
+    int first_segment = first_frame / segment_frames;
+    int last_segment = (last_frame - 1) / segment_frames;
+    vector<Mat> range_segments(last_segment - first_segment + 1);
+    vector<int> missing_segments;
+
+    for (int i = 0; i < (int)range_segments.size(); i++) {
+        range_segments[i] = FindSegment(level, first_segment + i);
+
+        if (!range_segments[i].empty())
+            render_stats.cached_segments++;
+        else if (DeriveSegment(level, first_segment + i, RANGE_DERIVE_LEVELS, range_segments[i])) {
+            StoreSegment(level, first_segment + i, range_segments[i]);
+            render_stats.derived_segments++;
+        }
+        else
+            missing_segments.push_back(i);
+    }
+
+    GetSharedThreadPool().ParallelFor((int)missing_segments.size(), [&](int missing_id) {
+        int i = missing_segments[missing_id];
+        range_segments[i] = DecodeSegment(level, first_segment + i);
+        StoreSegment(level, first_segment + i, range_segments[i]);
+    });
+
+    render_stats.decoded_segments = (int)missing_segments.size();
+
+    // Every column shows the sample of the level at or right before its frame.
+    for (int column = 0; column < art_image.cols; column++) {
+        int frame = first_frame + (int)((long long)column * frame_range / art_image.cols);
+        int sample = frame >> level;
+        const Mat& segment = range_segments[sample / RANGE_SEGMENT_COLUMNS - first_segment];
+
+        segment.col(sample % RANGE_SEGMENT_COLUMNS).copyTo(art_image.col(column));
+    }
+
+    render_stats.level = level;
+    render_stats.seconds = (getTickCount() - start) / getTickFrequency();
+
+    if (stats != nullptr)
+        *stats = render_stats;
+
+    return true;
+}
+
+string GetRangeArtPath(const string& art_path, int range_id) {
+    size_t dot = art_path.find_last_of('.');
+    size_t slash = art_path.find_last_of("/\\");
+    bool has_extension = dot != string::npos && (slash == string::npos || dot > slash);
+
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "-%03d", range_id);
+
+    return has_extension ? art_path.substr(0, dot) + suffix + art_path.substr(dot) : art_path + suffix;
+}
+
+void PrintRangeRenderStats(double first_seconds, double last_seconds, const RangeRenderStats& stats) {
+    cout << "Range " << first_seconds << "s to " << last_seconds << "s: a sample every " << (1 << stats.level) << " frames, "
+         << stats.cached_segments << " segments cached, " << stats.derived_segments << " derived, " << stats.decoded_segments
+         << " decoded, in " << stats.seconds * 1000.0 << " ms." << endl;
+}
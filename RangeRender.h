@@ -0,0 +1,128 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef RANGE_RENDER_H
+#define RANGE_RENDER_H
+
+#include "opencv2/opencv.hpp"
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "MovieWallArt.h"
+
+// Columns of a cached segment. A segment of level n samples every 2^n frames, so it spans 2^n times as many frames.
+#define RANGE_SEGMENT_COLUMNS 256
+
+// The coarsest level, one sample every 2^20 frames, past anything a zoom needs.
+#define RANGE_MAX_LEVEL 20
+
+// Levels below a missing segment searched for cached segments to build it from instead of decoding it.
+#define RANGE_DERIVE_LEVELS 4
+
+// Sample intervals, in frames, up to which decoding through the frames in between is cheaper than seeking.
+#define RANGE_SEQUENTIAL_INTERVAL 32
+
+#define RANGE_CACHE_MAX_BYTES (256LL * 1024 * 1024)
+
+/**
+ * Where the segments of a range render came from.
+ */
+struct RangeRenderStats {
+    int cached_segments = 0;
+
+    // Built from the cached segments of finer levels, without decoding.
+    int derived_segments = 0;
+
+    int decoded_segments = 0;
+    int level = 0;
+    double seconds = 0.0;
+};
+
+/**
+ * Renders the art of time ranges of a movie, like a zoom into a few minutes of it, sampling as many frames as
+ * the art has columns.
+ *
+ * The columns are kept in a cache of segments, indexed by level and time. Level n samples every 2^n frames,
+ * and its segments are aligned to multiples of RANGE_SEGMENT_COLUMNS samples, so overlapping zooms share them.
+ * A segment of a coarser level is every other column of the two segments below it, so zooming out after
+ * zooming in rarely decodes anything. Only the missing segments are decoded, each one on its own capture.
+ */
+class RangeRenderer {
+public:
+    /**
+     * @param movie_path The path to the movie.
+     * @param art_height The height of the art of every range, which the cached columns have.
+     * @param options The style and the decoding settings of the renders.
+     * @param cache_bytes The memory the cached segments may take. The least recently used ones go first.
+     */
+    RangeRenderer(const std::string& movie_path, int art_height, const ArtRenderOptions& options, long long cache_bytes = RANGE_CACHE_MAX_BYTES);
+
+    /**
+     * Renders a range of the movie.
+     *
+     * @param first_seconds The start of the range.
+     * @param last_seconds The end of the range.
+     * @param art_image The art, as wide as the columns wanted and art_height high.
+     * @param stats Optional stats of the render.
+     */
+    bool Render(double first_seconds, double last_seconds, cv::Mat& art_image, RangeRenderStats* stats = nullptr);
+
+    int GetFrameCount() const;
+
+    double GetFps() const;
+
+private:
+    struct Segment {
+        cv::Mat columns;
+        long long last_use;
+    };
+
+    int GetSegmentFrames(int level) const;
+
+    cv::Mat FindSegment(int level, int index);
+
+    void StoreSegment(int level, int index, const cv::Mat& columns);
+
+    bool DeriveSegment(int level, int index, int depth, cv::Mat& columns);
+
+    cv::Mat DecodeSegment(int level, int index);
+
+    std::string movie_path;
+    int art_height;
+    ArtRenderOptions options;
+    int frame_count;
+    double fps;
+
+    std::mutex cache_mutex;
+    std::map<std::pair<int, int>, Segment> segments;
+    long long cache_bytes;
+    long long used_bytes;
+    long long use_clock;
+};
+
+/**
+ * Get the path of the art of a range when several are rendered, like art-001.png for art.png.
+ */
+std::string GetRangeArtPath(const std::string& art_path, int range_id);
+
+void PrintRangeRenderStats(double first_seconds, double last_seconds, const RangeRenderStats& stats);
+
+#endif // !RANGE_RENDER_H
@@ -0,0 +1,232 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "RoiMask.h"
+
+#include <iostream>
+
+#include "MovieWallArt.h"
+
+using namespace cv;
+using namespace std;
+
+// Frames compared by the static overlay detector, and how much a constant pixel may flicker with compression noise.
+#define STATIC_OVERLAY_SAMPLES 24
+#define STATIC_OVERLAY_TOLERANCE 10
+
+RoiMask::RoiMask() : kept_pixels(0) {
+}
+
+RoiMask::RoiMask(const Mat& keep_mask) : frame_size(keep_mask.cols, keep_mask.rows), kept_pixels(0) {
+    int mask_h = keep_mask.rows;
+    int mask_w = keep_mask.cols;
+
+    row_offsets.reserve(mask_h + 1);
+
+    for (int y = 0; y < mask_h; y++) {
+        const uchar* row = keep_mask.ptr<uchar>(y);
+        row_offsets.push_back((int)row_spans.size());
+
+        int x = 0;
+        while (x < mask_w) {
+            while (x < mask_w && row[x] == 0)
+                x++;
+
+            int begin = x;
+            while (x < mask_w && row[x] != 0)
+                x++;
+
+            if (x > begin) {
+                RoiSpan span = { begin, x };
+                row_spans.push_back(span);
+                kept_pixels += x - begin;
+            }
+        }
+    }
+    row_offsets.push_back((int)row_spans.size());
+
+    // The same runs along the columns, by transposing the mask once.
+    Mat transposed = keep_mask.t();
+
+    column_offsets.reserve(mask_w + 1);
+
+    for (int x = 0; x < mask_w; x++) {
+        const uchar* column = transposed.ptr<uchar>(x);
+        column_offsets.push_back((int)column_spans.size());
+
+        int y = 0;
+        while (y < mask_h) {
+            while (y < mask_h && column[y] == 0)
+                y++;
+
+            int begin = y;
+            while (y < mask_h && column[y] != 0)
+                y++;
+
+            if (y > begin) {
+                RoiSpan span = { begin, y };
+                column_spans.push_back(span);
+            }
+        }
+    }
+    column_offsets.push_back((int)column_spans.size());
+}
+
+bool RoiMask::IsEmpty() const {
+    return row_offsets.empty();
+}
+
+bool RoiMask::Fits(const Mat& frame) const {
+    return !IsEmpty() && kept_pixels > 0 && frame.cols == frame_size.width && frame.rows == frame_size.height;
+}
+
+Size RoiMask::GetFrameSize() const {
+    return frame_size;
+}
+
+long long RoiMask::GetKeptPixels() const {
+    return kept_pixels;
+}
+
+const RoiSpan* RoiMask::RowSpansBegin(int y) const {
+    return row_spans.data() + row_offsets[y];
+}
+
+const RoiSpan* RoiMask::RowSpansEnd(int y) const {
+    return row_spans.data() + row_offsets[y + 1];
+}
+
+const RoiSpan* RoiMask::ColumnSpansBegin(int x) const {
+    return column_spans.data() + column_offsets[x];
+}
+
+const RoiSpan* RoiMask::ColumnSpansEnd(int x) const {
+    return column_spans.data() + column_offsets[x + 1];
+}
+
+Mat DetectStaticOverlays(const string& movie_path, int sample_count, int tolerance) {
+    VideoCapture cap(movie_path);
+
+    if (!cap.isOpened()) {
+        cout << "Error opening video file." << endl;
+        return Mat();
+    }
+
+    int frame_count = cap.get(CAP_PROP_FRAME_COUNT);
+
+    Mat frame;
+    Mat lowest;
+    Mat highest;
+    int samples_read = 0;
+
+    // Samples avoid the very start and end of the movie, where studio logos and credits sit still.
+    for (int i = 1; i <= sample_count; i++) {
+        cap.set(CAP_PROP_POS_FRAMES, (double)frame_count * i / (sample_count + 1));
+        cap >> frame;
+
+        if (frame.empty())
+            continue;
+
+        if (samples_read == 0) {
+            lowest = frame.clone();
+            highest = frame.clone();
+        }
+        else if (frame.size() == lowest.size()) {
+            cv::min(lowest, frame, lowest);
+            cv::max(highest, frame, highest);
+        }
+        samples_read++;
+    }
+
+    cap.release();
+
+    // With a handful of samples, still scenes would look like overlays.
+    if (samples_read < 4)
+        return Mat();
+
+    Mat spread;
+    absdiff(highest, lowest, spread);
+
+    Mat static_pixels(spread.rows, spread.cols, CV_8UC1);
+
+    for (int y = 0; y < spread.rows; y++) {
+        const Vec3b* spread_row = spread.ptr<Vec3b>(y);
+        uchar* static_row = static_pixels.ptr<uchar>(y);
+
+        for (int x = 0; x < spread.cols; x++) {
+            const Vec3b& s = spread_row[x];
+            static_row[x] = (s[0] <= tolerance && s[1] <= tolerance && s[2] <= tolerance) ? 255 : 0;
+        }
+    }
+
+    // Logos are blended at their edges, which move a little with the picture behind them.
+    dilate(static_pixels, static_pixels, getStructuringElement(MORPH_RECT, Size(5, 5)));
+
+    return static_pixels;
+}
+
+RoiMask CreateMovieRoiMask(const string& movie_path, const vector<RoiExclusion>& exclusions, bool detect_static_overlays, int reduction_width) {
+    if (exclusions.empty() && !detect_static_overlays)
+        return RoiMask();
+
+    VideoCapture cap(movie_path);
+
+    if (!cap.isOpened()) {
+        cout << "Error opening video file." << endl;
+        return RoiMask();
+    }
+
+    int frame_w = cap.get(CAP_PROP_FRAME_WIDTH);
+    int frame_h = cap.get(CAP_PROP_FRAME_HEIGHT);
+    cap.release();
+
+    if (frame_w <= 0 || frame_h <= 0)
+        return RoiMask();
+
+    Mat keep_mask(frame_h, frame_w, CV_8UC1, Scalar(255));
+
+    for (const RoiExclusion& exclusion : exclusions) {
+        int x0 = max(0, (int)(exclusion.x * frame_w));
+        int y0 = max(0, (int)(exclusion.y * frame_h));
+        int x1 = min(frame_w, (int)((exclusion.x + exclusion.width) * frame_w + 0.5f));
+        int y1 = min(frame_h, (int)((exclusion.y + exclusion.height) * frame_h + 0.5f));
+
+        if (x1 > x0 && y1 > y0)
+            keep_mask(Rect(x0, y0, x1 - x0, y1 - y0)).setTo(Scalar(0));
+    }
+
+    if (detect_static_overlays) {
+        Mat static_pixels = DetectStaticOverlays(movie_path, STATIC_OVERLAY_SAMPLES, STATIC_OVERLAY_TOLERANCE);
+
+        if (static_pixels.rows == frame_h && static_pixels.cols == frame_w)
+            keep_mask.setTo(Scalar(0), static_pixels);
+    }
+
+    // The reducers see the reduced frames, so the mask has to match them.
+    Size reduced_size = GetReducedFrameSize(keep_mask.size(), reduction_width);
+
+    if (reduced_size != keep_mask.size())
+        resize(keep_mask, keep_mask, reduced_size, 0, 0, INTER_NEAREST);
+
+    RoiMask mask(keep_mask);
+
+    cout << "Region of interest: " << mask.GetKeptPixels() * 100 / max(1LL, (long long)mask.GetFrameSize().area()) << "% of the frame." << endl;
+
+    return mask;
+}
@@ -0,0 +1,101 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef ROI_MASK_H
+#define ROI_MASK_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * A part of the frame to leave out of the art, in fractions of the frame size so it fits any resolution.
+ */
+struct RoiExclusion {
+    float x;
+    float y;
+    float width;
+    float height;
+};
+
+/**
+ * A run of kept pixels in a line of the frame, from begin up to end, end excluded.
+ */
+struct RoiSpan {
+    int begin;
+    int end;
+};
+
+/**
+ * The pixels of the frame the reducers look at, stored as run-length encoded spans of kept pixels.
+ * Spans are stored both per row and per column, since GetFrameAverageColor walks the frame by rows and
+ * GetFramePixelStrip walks it by columns. Masked pixels are never read, so masking also saves work.
+ */
+class RoiMask {
+public:
+    RoiMask();
+
+    /**
+     * @param keep_mask An 8-bit mask with the size of the frame, nonzero where pixels are kept.
+     */
+    explicit RoiMask(const cv::Mat& keep_mask);
+
+    bool IsEmpty() const;
+    bool Fits(const cv::Mat& frame) const;
+
+    cv::Size GetFrameSize() const;
+    long long GetKeptPixels() const;
+
+    const RoiSpan* RowSpansBegin(int y) const;
+    const RoiSpan* RowSpansEnd(int y) const;
+    const RoiSpan* ColumnSpansBegin(int x) const;
+    const RoiSpan* ColumnSpansEnd(int x) const;
+
+private:
+    cv::Size frame_size;
+    long long kept_pixels;
+
+    std::vector<RoiSpan> row_spans;
+    std::vector<int> row_offsets;
+    std::vector<RoiSpan> column_spans;
+    std::vector<int> column_offsets;
+};
+
+/**
+ * Finds the pixels that keep the same color all movie long, like channel logos and letterbox bars.
+ *
+ * @param movie_path The path to the movie.
+ * @param sample_count How many frames, spread over the movie, are compared.
+ * @param tolerance How much a channel may change between samples and still be considered constant.
+ * @return An 8-bit mask, nonzero on the static pixels, or an empty matrix if the movie can't be read.
+ */
+cv::Mat DetectStaticOverlays(const std::string& movie_path, int sample_count, int tolerance);
+
+/**
+ * Builds the mask of a movie out of the exclusions set for the run and, optionally, the static overlays found in it.
+ *
+ * @param movie_path The path to the movie.
+ * @param exclusions The parts of the frame to leave out.
+ * @param detect_static_overlays Whether to also leave out logos and letterbox bars.
+ * @param reduction_width The width frames are reduced to before the reducers look at them, or 0 for full resolution.
+ */
+RoiMask CreateMovieRoiMask(const std::string& movie_path, const std::vector<RoiExclusion>& exclusions, bool detect_static_overlays,
+                           int reduction_width = 0);
+
+#endif // !ROI_MASK_H
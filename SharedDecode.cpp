@@ -0,0 +1,645 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "SharedDecode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// Bytes hashed at each end of a movie file for its fingerprint.
+#define MOVIE_FINGERPRINT_BYTES (64 * 1024)
+
+static void HashBytes(uint64_t& hash, const char* bytes, size_t count) {
+    // FNV-1a.
+    for (size_t i = 0; i < count; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+string GetMovieFingerprint(const string& movie_path) {
+    ifstream file(movie_path, ios::binary | ios::ate);
+
+    if (!file.is_open())
+        return movie_path;
+
+    long long file_bytes = (long long)file.tellg();
+    uint64_t hash = 14695981039346656037ULL;
+    vector<char> buffer(MOVIE_FINGERPRINT_BYTES);
+
+    long long head_bytes = min(file_bytes, (long long)MOVIE_FINGERPRINT_BYTES);
+    file.seekg(0);
+    file.read(buffer.data(), head_bytes);
+    HashBytes(hash, buffer.data(), (size_t)file.gcount());
+
+    long long tail_bytes = min(file_bytes - head_bytes, (long long)MOVIE_FINGERPRINT_BYTES);
+
+    if (tail_bytes > 0) {
+        file.seekg(file_bytes - tail_bytes);
+        file.read(buffer.data(), tail_bytes);
+        HashBytes(hash, buffer.data(), (size_t)file.gcount());
+    }
+
+    ostringstream fingerprint;
+    fingerprint << file_bytes << "-" << hex << setw(16) << setfill('0') << hash;
+
+    return fingerprint.str();
+}
+
+void FrameSignatureCache::Add(int frame_index, const Mat& frame) {
+    Mat signature;
+
+    if (frame.cols > SHARED_DECODE_SIGNATURE_WIDTH)
+        resize(frame, signature, GetReducedFrameSize(frame.size(), SHARED_DECODE_SIGNATURE_WIDTH), 0, 0, INTER_AREA);
+    else
+        signature = frame.clone();
+
+    lock_guard<mutex> lock(signatures_mutex);
+    signatures[frame_index] = signature;
+}
+
+bool FrameSignatureCache::FindNearest(int frame_index, int max_distance, Mat& signature) const {
+    lock_guard<mutex> lock(signatures_mutex);
+
+    map<int, Mat>::const_iterator after = signatures.lower_bound(frame_index);
+    map<int, Mat>::const_iterator nearest = signatures.end();
+
+    if (after != signatures.end())
+        nearest = after;
+
+    if (after != signatures.begin()) {
+        map<int, Mat>::const_iterator before = prev(after);
+
+        if (nearest == signatures.end() || frame_index - before->first < nearest->first - frame_index)
+            nearest = before;
+    }
+
+    if (nearest == signatures.end() || abs(nearest->first - frame_index) > max_distance)
+        return false;
+
+    signature = nearest->second;
+
+    return true;
+}
+
+size_t FrameSignatureCache::GetSize() const {
+    lock_guard<mutex> lock(signatures_mutex);
+    return signatures.size();
+}
+
+SharedDecodeSubscription::SharedDecodeSubscription(shared_ptr<SharedDecodeStream> stream, int id, vector<int> missed_frames)
+    : stream(stream), id(id), missed_frames(missed_frames) {
+}
+
+SharedDecodeSubscription::~SharedDecodeSubscription() {
+    stream->Detach(id);
+}
+
+bool SharedDecodeSubscription::Next(SharedFrame& frame) {
+    return stream->Next(id, frame);
+}
+
+const vector<int>& SharedDecodeSubscription::GetMissedFrames() const {
+    return missed_frames;
+}
+
+int SharedDecodeSubscription::GetFrameCount() const {
+    return stream->GetFrameCount();
+}
+
+const FrameSignatureCache& SharedDecodeSubscription::GetSignatureCache() const {
+    return stream->GetSignatureCache();
+}
+
+SharedDecodeStream::SharedDecodeStream(const string& movie_path, shared_ptr<FrameSignatureCache> signature_cache, int decoder_threads)
+    : signature_cache(signature_cache), frame_count(0), next_id(0), position(0), started(false), finished(false), stopping(false) {
+    ArtRenderOptions options;
+    options.decoder_threads = decoder_threads;
+
+    if (OpenMovieCapture(cap, movie_path, options))
+        frame_count = (int)cap.get(CAP_PROP_FRAME_COUNT);
+}
+
+SharedDecodeStream::~SharedDecodeStream() {
+    {
+        lock_guard<mutex> lock(stream_mutex);
+        stopping = true;
+    }
+    stream_cv.notify_all();
+
+    if (decoder.joinable())
+        decoder.join();
+}
+
+bool SharedDecodeStream::IsOpened() const {
+    return cap.isOpened();
+}
+
+bool SharedDecodeStream::IsFinished() {
+    lock_guard<mutex> lock(stream_mutex);
+    return finished;
+}
+
+int SharedDecodeStream::GetFrameCount() const {
+    return frame_count;
+}
+
+const FrameSignatureCache& SharedDecodeStream::GetSignatureCache() const {
+    return *signature_cache;
+}
+
+int SharedDecodeStream::Attach(const vector<int>& wanted_frames, vector<int>& missed_frames) {
+    vector<vector<int>> job_missed_frames;
+    vector<int> ids = Attach(vector<vector<int>>(1, wanted_frames), job_missed_frames);
+
+    if (ids.empty())
+        return -1;
+
+    missed_frames = job_missed_frames[0];
+
+    return ids[0];
+}
+
+vector<int> SharedDecodeStream::Attach(const vector<vector<int>>& wanted_frames, vector<vector<int>>& missed_frames) {
+    lock_guard<mutex> lock(stream_mutex);
+    vector<int> ids;
+
+    // A decode that ran out of wanted frames has stopped, the jobs need a new one.
+    if (finished || stopping)
+        return ids;
+
+    missed_frames.assign(wanted_frames.size(), vector<int>());
+
+    for (size_t job = 0; job < wanted_frames.size(); job++) {
+        vector<int> wanted = wanted_frames[job];
+        sort(wanted.begin(), wanted.end());
+        wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+
+        Subscriber subscriber;
+
+        for (int frame_index : wanted) {
+            if (frame_index >= frame_count)
+                continue;
+
+            if (frame_index < position)
+                missed_frames[job].push_back(frame_index);
+            else
+                subscriber.wanted_frames.push_back(frame_index);
+        }
+
+        ids.push_back(next_id);
+        subscribers[next_id++] = subscriber;
+    }
+
+    if (!started) {
+        started = true;
+        decoder = thread(&SharedDecodeStream::DecodeLoop, this);
+    }
+
+    stream_cv.notify_all();
+
+    return ids;
+}
+
+void SharedDecodeStream::Detach(int id) {
+    {
+        lock_guard<mutex> lock(stream_mutex);
+        subscribers.erase(id);
+    }
+    stream_cv.notify_all();
+}
+
+bool SharedDecodeStream::Next(int id, SharedFrame& frame) {
+    unique_lock<mutex> lock(stream_mutex);
+    Subscriber& subscriber = subscribers[id];
+
+    stream_cv.wait(lock, [&] {
+        return !subscriber.frames.empty() || subscriber.next_wanted == subscriber.wanted_frames.size() || finished || stopping;
+    });
+
+    if (subscriber.frames.empty())
+        return false;
+
+    frame = subscriber.frames.front();
+    subscriber.frames.pop_front();
+
+    // The decoder may be waiting for room in this queue.
+    stream_cv.notify_all();
+
+    return true;
+}
+
+int SharedDecodeStream::GetNextWantedFrame() const {
+    int next_frame = -1;
+
+    for (const pair<const int, Subscriber>& entry : subscribers) {
+        const Subscriber& subscriber = entry.second;
+
+        if (subscriber.next_wanted < subscriber.wanted_frames.size()) {
+            int wanted = subscriber.wanted_frames[subscriber.next_wanted];
+
+            if (next_frame < 0 || wanted < next_frame)
+                next_frame = wanted;
+        }
+    }
+
+    return next_frame;
+}
+
+bool SharedDecodeStream::IsAnySubscriberFull(int frame_index) const {
+    for (const pair<const int, Subscriber>& entry : subscribers) {
+        const Subscriber& subscriber = entry.second;
+
+        if (subscriber.next_wanted < subscriber.wanted_frames.size() && subscriber.wanted_frames[subscriber.next_wanted] == frame_index
+            && subscriber.frames.size() >= SHARED_DECODE_QUEUE_FRAMES)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Decodes the frames the jobs want, lowest first, and hands each one to every job that wants it.
+ * Stops once no attached job wants more frames.
+ */
+void SharedDecodeStream::DecodeLoop() {
+    int cap_position = 0;
+    unique_lock<mutex> lock(stream_mutex);
+
+    while (!stopping) {
+        int target = GetNextWantedFrame();
+
+        if (target < 0) {
+            finished = true;
+            stream_cv.notify_all();
+            return;
+        }
+
+        if (IsAnySubscriberFull(target)) {
+            stream_cv.wait(lock);
+            continue;
+        }
+
+        // Jobs attaching from now on get the frames before the target from the signature cache.
+        position = target;
+        lock.unlock();
+
+        if (cap_position < 0 || target < cap_position || target - cap_position > SHARED_DECODE_MAX_GRAB_GAP) {
+            cap.set(CAP_PROP_POS_FRAMES, target);
+            cap_position = target;
+        }
+
+        while (cap_position < target && cap.grab())
+            cap_position++;
+
+        // A new buffer for every frame, since the jobs may still be reading the previous ones.
+        SharedFrame shared;
+        shared.index = target;
+
+        if (cap_position == target && cap.read(shared.frame) && !shared.frame.empty()) {
+            cap_position++;
+            signature_cache->Add(target, shared.frame);
+        }
+        else {
+            shared.frame.release();
+            cap_position = -1;
+        }
+
+        lock.lock();
+        position = target + 1;
+
+        for (pair<const int, Subscriber>& entry : subscribers) {
+            Subscriber& subscriber = entry.second;
+
+            if (subscriber.next_wanted < subscriber.wanted_frames.size() && subscriber.wanted_frames[subscriber.next_wanted] == target) {
+                subscriber.frames.push_back(shared);
+                subscriber.next_wanted++;
+            }
+        }
+
+        stream_cv.notify_all();
+    }
+}
+
+vector<unique_ptr<SharedDecodeSubscription>> AttachSharedDecode(const string& movie_path, const ArtRenderOptions& options,
+                                                                 const vector<vector<int>>& wanted_frames) {
+    static mutex streams_mutex;
+    static map<string, weak_ptr<SharedDecodeStream>> streams;
+
+    // Only the decodes own the caches, so a cache goes away with the last decode of its movie.
+    static map<string, weak_ptr<FrameSignatureCache>> signature_caches;
+
+    string fingerprint = GetMovieFingerprint(movie_path);
+    lock_guard<mutex> lock(streams_mutex);
+
+    for (map<string, weak_ptr<FrameSignatureCache>>::iterator cache = signature_caches.begin(); cache != signature_caches.end();) {
+        if (cache->second.expired()) {
+            streams.erase(cache->first);
+            cache = signature_caches.erase(cache);
+        }
+        else
+            ++cache;
+    }
+
+    vector<unique_ptr<SharedDecodeSubscription>> subscriptions;
+    shared_ptr<SharedDecodeStream> stream = streams[fingerprint].lock();
+    vector<vector<int>> missed_frames;
+    vector<int> ids;
+
+    if (stream != nullptr)
+        ids = stream->Attach(wanted_frames, missed_frames);
+
+    if (ids.empty()) {
+        shared_ptr<FrameSignatureCache> signature_cache = signature_caches[fingerprint].lock();
+
+        if (signature_cache == nullptr) {
+            signature_cache = make_shared<FrameSignatureCache>();
+            signature_caches[fingerprint] = signature_cache;
+        }
+
+        stream = make_shared<SharedDecodeStream>(movie_path, signature_cache, options.decoder_threads);
+
+        if (!stream->IsOpened())
+            return subscriptions;
+
+        streams[fingerprint] = stream;
+        ids = stream->Attach(wanted_frames, missed_frames);
+    }
+
+    for (size_t job = 0; job < ids.size(); job++)
+        subscriptions.push_back(unique_ptr<SharedDecodeSubscription>(new SharedDecodeSubscription(stream, ids[job], missed_frames[job])));
+
+    return subscriptions;
+}
+
+unique_ptr<SharedDecodeSubscription> AttachSharedDecode(const string& movie_path, const ArtRenderOptions& options, const vector<int>& wanted_frames) {
+    vector<unique_ptr<SharedDecodeSubscription>> subscriptions = AttachSharedDecode(movie_path, options, vector<vector<int>>(1, wanted_frames));
+
+    if (subscriptions.empty())
+        return nullptr;
+
+    return move(subscriptions[0]);
+}
+
+/**
+ * The frames an art samples and the columns each one fills.
+ */
+struct SharedArtPlan {
+    int sample_interval = 0;
+    map<int, vector<int>> columns_of_frame;
+    vector<int> wanted_frames;
+};
+
+static SharedArtPlan PlanSharedArt(int frame_count, int art_width) {
+    SharedArtPlan plan;
+
+    // The same sampling as RenderArtColumns, so the art matches one rendered on its own.
+    plan.sample_interval = frame_count / art_width;
+
+    for (int column_id = 0; column_id < art_width; column_id++) {
+        int frame_index = plan.sample_interval > 0 ? column_id * plan.sample_interval : (int)((long long)column_id * frame_count / art_width);
+
+        if (frame_index >= frame_count)
+            break;
+
+        plan.columns_of_frame[frame_index].push_back(column_id);
+        plan.wanted_frames.push_back(frame_index);
+    }
+
+    return plan;
+}
+
+/**
+ * Renders the columns of an art from its subscription to a shared decode.
+ */
+static void RenderSharedArt(const string& movie_path, Mat& art_image, const ArtRenderOptions& options, Size frame_size, const SharedArtPlan& plan,
+                            SharedDecodeSubscription& subscription) {
+    ArtColumnContext context;
+    context.roi_mask = options.roi_mask;
+    context.sparse_log = options.sparse_log;
+    context.reduction_pool = options.parallel_reduction ? &GetSharedThreadPool() : nullptr;
+
+    Size reduced_size = GetReducedFrameSize(frame_size, options.reduction_width);
+
+    auto render_columns = [&](Mat& frame, int frame_index) {
+        map<int, vector<int>>::const_iterator columns = plan.columns_of_frame.find(frame_index);
+
+        if (columns == plan.columns_of_frame.end())
+            return;
+
+        for (int column_id : columns->second) {
+            if (!frame.empty() && CreateArtColumn(frame, art_image, column_id, options.style, false, &context) == ART_COLUMN_OK)
+                continue;
+
+            if (options.damage_log != nullptr)
+                options.damage_log->AddColumn(column_id, frame_index);
+            else if (column_id > 0)
+                art_image.col(column_id - 1).copyTo(art_image.col(column_id));
+        }
+    };
+
+    // The columns the decode had passed come first, so a damaged column never repeats one not rendered yet.
+    const vector<int>& missed_frames = subscription.GetMissedFrames();
+    int signature_frames = 0;
+
+    if (!missed_frames.empty()) {
+        VideoCapture cap;
+        unique_ptr<ArtFrameSampler> sampler;
+        Mat signature;
+        Mat frame;
+
+        for (int frame_index : missed_frames) {
+            if (subscription.GetSignatureCache().FindNearest(frame_index, plan.sample_interval / 2, signature)) {
+                resize(signature, frame, reduced_size, 0, 0, INTER_LINEAR);
+                render_columns(frame, frame_index);
+                signature_frames++;
+                continue;
+            }
+
+            if (sampler == nullptr) {
+                OpenMovieCapture(cap, movie_path, options);
+                sampler.reset(new ArtFrameSampler(cap, options));
+            }
+
+            if (cap.isOpened() && sampler->Read(frame_index, context) == ART_FRAME_OK)
+                render_columns(sampler->GetFrame(), frame_index);
+            else {
+                frame.release();
+                render_columns(frame, frame_index);
+            }
+        }
+
+        cout << "Shared decode: joined " << movie_path << " late, " << signature_frames << " of " << missed_frames.size()
+             << " missed frames came from the signature cache." << endl;
+    }
+
+    SharedFrame shared;
+    Mat frame;
+
+    while (subscription.Next(shared)) {
+        if (shared.frame.empty() || reduced_size == shared.frame.size())
+            frame = shared.frame;
+        else {
+            // Released first, or the resize could write into the shared pixels of the previous frame.
+            frame.release();
+            resize(shared.frame, frame, reduced_size, 0, 0, INTER_AREA);
+        }
+
+        render_columns(frame, shared.index);
+    }
+}
+
+/**
+ * The memory of a shared decode and of the arts reading from it: the decoder, the frames the queue of every
+ * art may hold, and the frames each art scales down. The decoder is counted even when the jobs join a decode
+ * that is already running, which keeps the estimate on the safe side.
+ */
+static long long EstimateSharedDecodeMemory(Size frame_size, const vector<ArtRenderOptions>& options, const vector<size_t>& shared_arts) {
+    ArtRenderOptions decode_options = options[shared_arts[0]];
+    decode_options.style = ART_STYLE_AVERAGE_COLOR;
+    decode_options.reduction_width = 0;
+
+    long long frame_bytes = (long long)frame_size.width * frame_size.height * 3;
+    long long bytes = EstimateRenderMemory(frame_size, decode_options);
+
+    for (size_t i : shared_arts) {
+        Size reduced_size = GetReducedFrameSize(frame_size, options[i].reduction_width);
+        bytes += SHARED_DECODE_QUEUE_FRAMES * frame_bytes;
+
+        if (reduced_size != frame_size)
+            bytes += (long long)reduced_size.width * reduced_size.height * 3;
+    }
+
+    return bytes;
+}
+
+void RenderArtsWithSharedDecode(const string& movie_path, const vector<Mat*>& art_images, const vector<ArtRenderOptions>& options, ArtVideoSink* video_sink) {
+    VideoCapture probe(movie_path);
+
+    if (!probe.isOpened()) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return;
+    }
+
+    int frame_count = (int)probe.get(CAP_PROP_FRAME_COUNT);
+    double fps = probe.get(CAP_PROP_FPS);
+    Size frame_size((int)probe.get(CAP_PROP_FRAME_WIDTH), (int)probe.get(CAP_PROP_FRAME_HEIGHT));
+    probe.release();
+
+    // Arts without a damage log of their own get one, filled once every art is done, as CreateMovieWallArt does.
+    vector<ArtDamageLog> damage_logs(art_images.size());
+    vector<ArtRenderOptions> art_options = options;
+
+    for (size_t i = 0; i < art_images.size(); i++) {
+        if (art_options[i].damage_log == nullptr)
+            art_options[i].damage_log = &damage_logs[i];
+    }
+
+    vector<size_t> shared_arts;
+    vector<size_t> own_arts;
+    vector<SharedArtPlan> plans;
+    vector<vector<int>> wanted_frames;
+
+    for (size_t i = 0; i < art_images.size(); i++) {
+        const ArtRenderOptions& render_options = art_options[i];
+
+        if (ArtStyleNeedsFollowingFrame(render_options.style) || render_options.style == ART_STYLE_MOTION_VECTORS || render_options.dc_average) {
+            own_arts.push_back(i);
+            continue;
+        }
+
+        shared_arts.push_back(i);
+        plans.push_back(PlanSharedArt(frame_count, art_images[i]->cols));
+        wanted_frames.push_back(plans.back().wanted_frames);
+    }
+
+    vector<unique_ptr<SharedDecodeSubscription>> subscriptions;
+    MemoryReservation reservation(0, shared_arts.empty() ? nullptr : art_options[shared_arts[0]].memory_job);
+
+    if (!shared_arts.empty()) {
+        // Reserved before attaching, all at once: an art waiting for the budget while attached would fill its
+        // queue and stall the decode, and with it the arts holding the memory it waits for.
+        reservation.Resize(EstimateSharedDecodeMemory(frame_size, art_options, shared_arts));
+
+        subscriptions = AttachSharedDecode(movie_path, art_options[shared_arts[0]], wanted_frames);
+
+        if (subscriptions.empty()) {
+            cout << "Error opening video file: " << movie_path << endl;
+            return;
+        }
+    }
+
+    // A thread per art rather than the shared pool: the decoder waits for the slowest art, so every art has
+    // to be reading at once, however few workers the pool has.
+    vector<thread> jobs;
+
+    for (size_t job = 0; job < shared_arts.size(); job++) {
+        size_t i = shared_arts[job];
+
+        jobs.push_back(thread([&, i, job]() {
+            RenderSharedArt(movie_path, *art_images[i], art_options[i], frame_size, plans[job], *subscriptions[job]);
+
+            // Detached now, so the decode doesn't keep frames for an art that is done.
+            subscriptions[job].reset();
+        }));
+    }
+
+    for (size_t i : own_arts) {
+        jobs.push_back(thread([&, i]() {
+            RenderArtColumns(movie_path, *art_images[i], 0, art_images[i]->cols, art_options[i]);
+        }));
+    }
+
+    for (thread& job : jobs)
+        job.join();
+
+    reservation.Release();
+
+    for (size_t i = 0; i < art_images.size(); i++) {
+        if (options[i].damage_log != nullptr)
+            continue;
+
+        damage_logs[i].FillFromNeighbours(*art_images[i]);
+
+        // Every art has the same damaged frames, so only the first one is reported.
+        if (i == 0)
+            damage_logs[i].Report(movie_path, fps);
+    }
+
+    // The arts are done in any order, so the video of the first one is built from its columns once it is finished.
+    if (video_sink != nullptr && !art_images.empty()) {
+        Mat& art_image = *art_images[0];
+        video_sink->SyncToMovie(fps, frame_count / max(art_image.cols, 1));
+
+        for (int column_id = 0; column_id < art_image.cols; column_id++)
+            video_sink->AddColumn(art_image, column_id);
+    }
+}
+
+void RenderArtWithSharedDecode(const string& movie_path, Mat& art_image, const ArtRenderOptions& options) {
+    RenderArtsWithSharedDecode(movie_path, vector<Mat*>(1, &art_image), vector<ArtRenderOptions>(1, options));
+}
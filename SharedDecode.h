@@ -0,0 +1,232 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef SHARED_DECODE_H
+#define SHARED_DECODE_H
+
+#include "opencv2/opencv.hpp"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MovieWallArt.h"
+
+// Width of the frame signatures kept for jobs that join a decode late.
+#define SHARED_DECODE_SIGNATURE_WIDTH 96
+
+// Frames a job may fall behind the shared decoder before the decoder waits for it.
+#define SHARED_DECODE_QUEUE_FRAMES 8
+
+// Frames the shared decoder grabs through to reach the next wanted frame before it seeks instead.
+#define SHARED_DECODE_MAX_GRAB_GAP 250
+
+/**
+ * Identifies the contents of a movie file: its size and a hash of its first and last 64 KiB, so the same
+ * title under two paths shares a decode, and a replaced file doesn't.
+ */
+std::string GetMovieFingerprint(const std::string& movie_path);
+
+/**
+ * Small copies of the frames a shared decode has given out, kept per movie for jobs that join late.
+ */
+class FrameSignatureCache {
+public:
+    void Add(int frame_index, const cv::Mat& frame);
+
+    /**
+     * Finds the signature closest to a frame.
+     *
+     * @param frame_index The frame wanted.
+     * @param max_distance How many frames away the signature may be.
+     * @param signature Receives the signature.
+     */
+    bool FindNearest(int frame_index, int max_distance, cv::Mat& signature) const;
+
+    size_t GetSize() const;
+
+private:
+    mutable std::mutex signatures_mutex;
+    std::map<int, cv::Mat> signatures;
+};
+
+/**
+ * A frame given out by a shared decode. The pixels are shared by every job that wanted the frame, so they
+ * must only be read. An empty frame could not be decoded.
+ */
+struct SharedFrame {
+    int index = -1;
+    cv::Mat frame;
+};
+
+class SharedDecodeStream;
+
+/**
+ * The frames a job gets from a shared decode, in order.
+ */
+class SharedDecodeSubscription {
+public:
+    SharedDecodeSubscription(std::shared_ptr<SharedDecodeStream> stream, int id, std::vector<int> missed_frames);
+    ~SharedDecodeSubscription();
+
+    /**
+     * Waits for the next wanted frame.
+     *
+     * @return False once every wanted frame the decode could still reach was given out.
+     */
+    bool Next(SharedFrame& frame);
+
+    /**
+     * The wanted frames the decode was already past when the job joined.
+     */
+    const std::vector<int>& GetMissedFrames() const;
+
+    int GetFrameCount() const;
+
+    const FrameSignatureCache& GetSignatureCache() const;
+
+private:
+    std::shared_ptr<SharedDecodeStream> stream;
+    int id;
+    std::vector<int> missed_frames;
+};
+
+/**
+ * One forward decode of a movie, on a thread of its own, that broadcasts the frames every attached job wants.
+ */
+class SharedDecodeStream {
+public:
+    SharedDecodeStream(const std::string& movie_path, std::shared_ptr<FrameSignatureCache> signature_cache, int decoder_threads);
+    ~SharedDecodeStream();
+
+    bool IsOpened() const;
+    bool IsFinished();
+    int GetFrameCount() const;
+
+    /**
+     * Adds a job. The decode starts with the first job.
+     *
+     * @param wanted_frames The frames the job wants, in any order.
+     * @param missed_frames Receives the wanted frames the decode is already past.
+     * @return The id of the job, or -1 when the decode already stopped.
+     */
+    int Attach(const std::vector<int>& wanted_frames, std::vector<int>& missed_frames);
+
+    /**
+     * Adds several jobs at once, so the decode can't get past a frame one of them wants before the others
+     * are attached.
+     *
+     * @param wanted_frames The frames every job wants, in any order.
+     * @param missed_frames Receives the wanted frames the decode is already past, for every job.
+     * @return The ids of the jobs, or an empty vector when the decode already stopped.
+     */
+    std::vector<int> Attach(const std::vector<std::vector<int>>& wanted_frames, std::vector<std::vector<int>>& missed_frames);
+
+    void Detach(int id);
+
+    bool Next(int id, SharedFrame& frame);
+
+    const FrameSignatureCache& GetSignatureCache() const;
+
+private:
+    struct Subscriber {
+        std::vector<int> wanted_frames;
+        size_t next_wanted = 0;
+        std::deque<SharedFrame> frames;
+    };
+
+    void DecodeLoop();
+
+    // Called with the lock held.
+    int GetNextWantedFrame() const;
+    bool IsAnySubscriberFull(int frame_index) const;
+
+    cv::VideoCapture cap;
+    std::shared_ptr<FrameSignatureCache> signature_cache;
+    int frame_count;
+
+    std::mutex stream_mutex;
+    std::condition_variable stream_cv;
+    std::map<int, Subscriber> subscribers;
+    int next_id;
+
+    // The next frame the capture decodes.
+    int position;
+    bool started;
+    bool finished;
+    bool stopping;
+    std::thread decoder;
+};
+
+/**
+ * Attaches jobs to the decode of a movie, starting one unless a decode of the same file is running.
+ *
+ * The signature cache of a movie lives as long as a decode of it, so it is dropped once the last job of
+ * the last decode detaches.
+ *
+ * @param movie_path The path to the movie.
+ * @param options The options of the jobs, whose decoder threads are used when a decode starts.
+ * @param wanted_frames The frames every job wants. All of them are attached before a new decode starts.
+ * @return The subscriptions, one per job, or an empty vector when the movie can't be opened.
+ */
+std::vector<std::unique_ptr<SharedDecodeSubscription>> AttachSharedDecode(const std::string& movie_path, const ArtRenderOptions& options,
+                                                                          const std::vector<std::vector<int>>& wanted_frames);
+
+/**
+ * Attaches a single job to the decode of a movie.
+ *
+ * @return The subscription, or nullptr when the movie can't be opened.
+ */
+std::unique_ptr<SharedDecodeSubscription> AttachSharedDecode(const std::string& movie_path, const ArtRenderOptions& options, const std::vector<int>& wanted_frames);
+
+/**
+ * Renders several art images of a movie from one decode. Every art is attached before the decode starts,
+ * so all of them get every frame at full size, and each one reduces its frames on a thread of its own.
+ *
+ * Styles that look at the following frame, the motion vector style and DC averaging read the movie their
+ * own way, so they render with RenderArtColumns, alongside the others.
+ *
+ * The memory of the decode and of the arts reading from it is reserved up front. Damaged columns of arts without
+ * a damage log of their own are filled from their neighbours once every art is done, and the first art reports them.
+ *
+ * @param movie_path The path to the movie.
+ * @param art_images The images being created.
+ * @param options The style and the decoding settings of every art.
+ * @param video_sink Optional sink that encodes a video out of the columns of the first art, once it is done.
+ */
+void RenderArtsWithSharedDecode(const std::string& movie_path, const std::vector<cv::Mat*>& art_images, const std::vector<ArtRenderOptions>& options,
+                                ArtVideoSink* video_sink = nullptr);
+
+/**
+ * Renders a whole art image from a shared decode. Several calls for the same movie at the same time decode
+ * it once. Columns whose frames the decode had passed when the job joined come from the small copies of the
+ * signature cache, or from a capture of the job's own when no signature is close enough, so arts known up
+ * front are better rendered together with RenderArtsWithSharedDecode.
+ *
+ * @param movie_path The path to the movie.
+ * @param art_image A reference to the image being created.
+ * @param options The style and the decoding settings of the render.
+ */
+void RenderArtWithSharedDecode(const std::string& movie_path, cv::Mat& art_image, const ArtRenderOptions& options);
+
+#endif // !SHARED_DECODE_H
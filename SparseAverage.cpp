@@ -0,0 +1,197 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "SparseAverage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include "MovieWallArt.h"
+
+using namespace cv;
+using namespace std;
+
+// The plastic number, whose powers make the most even 2D low-discrepancy sequence.
+#define R2_PLASTIC_NUMBER 1.32471795724474602596
+
+shared_ptr<const vector<Point>> GetSparseSamplePattern(Size frame_size) {
+    static mutex patterns_mutex;
+    static map<pair<int, int>, shared_ptr<const vector<Point>>> patterns;
+
+    lock_guard<mutex> lock(patterns_mutex);
+
+    shared_ptr<const vector<Point>>& cached = patterns[make_pair(frame_size.width, frame_size.height)];
+
+    if (cached != nullptr)
+        return cached;
+
+    shared_ptr<vector<Point>> pattern = make_shared<vector<Point>>(SPARSE_AVERAGE_MAX_SAMPLES);
+    double step_x = 1.0 / R2_PLASTIC_NUMBER;
+    double step_y = 1.0 / (R2_PLASTIC_NUMBER * R2_PLASTIC_NUMBER);
+
+    for (int i = 0; i < SPARSE_AVERAGE_MAX_SAMPLES; i++) {
+        double x = fmod(0.5 + step_x * (i + 1), 1.0);
+        double y = fmod(0.5 + step_y * (i + 1), 1.0);
+
+        (*pattern)[i] = Point(min((int)(x * frame_size.width), frame_size.width - 1), min((int)(y * frame_size.height), frame_size.height - 1));
+    }
+
+    cached = pattern;
+
+    return cached;
+}
+
+/**
+ * Whether a pixel is kept by a mask, found in the spans of its row.
+ */
+static bool IsKeptPixel(const RoiMask& roi_mask, Point pixel) {
+    for (const RoiSpan* span = roi_mask.RowSpansBegin(pixel.y); span != roi_mask.RowSpansEnd(pixel.y); span++) {
+        if (pixel.x < span->begin)
+            return false;
+
+        if (pixel.x < span->end)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Half width of the confidence interval of the average of the worst channel, from the sums of the samples and
+ * of their squares. The sample variance bounds the error of the average as if the samples were independent.
+ * The pattern covers the frame more evenly than random samples do, so the actual error is usually lower.
+ */
+static double GetSparseErrorBound(const double* sums, const double* squares, int count) {
+    double error_bound = 0.0;
+
+    for (int c = 0; c < 3; c++) {
+        double mean = sums[c] / count;
+        double variance = max(0.0, (squares[c] - count * mean * mean) / (count - 1));
+        error_bound = max(error_bound, SPARSE_AVERAGE_CONFIDENCE_Z * sqrt(variance / count));
+    }
+
+    return error_bound;
+}
+
+SparseAverageEstimate EstimateFrameAverageColor(const Mat& frame, const RoiMask* roi_mask) {
+    SparseAverageEstimate estimate;
+
+    if (roi_mask != nullptr && !roi_mask->Fits(frame))
+        roi_mask = nullptr;
+
+    long long pixels = roi_mask != nullptr ? roi_mask->GetKeptPixels() : (long long)frame.total();
+
+    // Small frames, and masks that keep little of the frame, are cheaper to read whole.
+    if (pixels <= SPARSE_AVERAGE_MAX_SAMPLES) {
+        Mat whole_frame = frame;
+        estimate.color = GetFrameAverageColor(whole_frame, roi_mask);
+        estimate.sample_count = (int)pixels;
+        return estimate;
+    }
+
+    shared_ptr<const vector<Point>> pattern = GetSparseSamplePattern(frame.size());
+    double sums[3] = { 0.0, 0.0, 0.0 };
+    double squares[3] = { 0.0, 0.0, 0.0 };
+    int next_check = SPARSE_AVERAGE_MIN_SAMPLES;
+    int count = 0;
+
+    for (const Point& pixel : *pattern) {
+        if (roi_mask != nullptr && !IsKeptPixel(*roi_mask, pixel))
+            continue;
+
+        const Vec3b& color = frame.at<Vec3b>(pixel.y, pixel.x);
+
+        for (int c = 0; c < 3; c++) {
+            sums[c] += color[c];
+            squares[c] += (double)color[c] * color[c];
+        }
+
+        if (++count < next_check)
+            continue;
+
+        if (GetSparseErrorBound(sums, squares, count) <= SPARSE_AVERAGE_TARGET_ERROR)
+            break;
+
+        next_check += SPARSE_AVERAGE_BATCH_SAMPLES;
+    }
+
+    if (count == 0)
+        return estimate;
+
+    // Also when the mask left fewer samples than the first check, or the pattern ran out between two checks.
+    if (count > 1)
+        estimate.error_bound = GetSparseErrorBound(sums, squares, count);
+
+    for (int c = 0; c < 3; c++)
+        estimate.color[c] = saturate_cast<uchar>(sums[c] / count);
+
+    estimate.sample_count = count;
+
+    return estimate;
+}
+
+void SparseAverageLog::AddColumn(int column_id, const SparseAverageEstimate& estimate) {
+    lock_guard<mutex> lock(columns_mutex);
+    columns.push_back({ column_id, estimate.sample_count, estimate.error_bound });
+}
+
+void SparseAverageLog::Report() {
+    lock_guard<mutex> lock(columns_mutex);
+
+    if (columns.empty())
+        return;
+
+    long long samples = 0;
+    double max_error = 0.0;
+    int missed_columns = 0;
+
+    for (const Column& column : columns) {
+        samples += column.sample_count;
+        max_error = max(max_error, column.error_bound);
+
+        if (column.error_bound > SPARSE_AVERAGE_TARGET_ERROR)
+            missed_columns++;
+    }
+
+    cout << "Sparse average: " << samples / (long long)columns.size() << " samples per column, max error bound " << max_error
+         << " levels, " << missed_columns << " of " << columns.size() << " columns over " << SPARSE_AVERAGE_TARGET_ERROR << " level." << endl;
+}
+
+bool SparseAverageLog::WriteCsv(const string& csv_path) {
+    lock_guard<mutex> lock(columns_mutex);
+
+    sort(columns.begin(), columns.end(), [](const Column& a, const Column& b) { return a.column_id < b.column_id; });
+
+    ofstream csv(csv_path);
+    csv << "column,samples,error_bound" << endl;
+
+    for (const Column& column : columns)
+        csv << column.column_id << "," << column.sample_count << "," << column.error_bound << endl;
+
+    if (!csv) {
+        cout << "Error writing the sparse average errors: " << csv_path << endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,97 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef SPARSE_AVERAGE_H
+#define SPARSE_AVERAGE_H
+
+#include "opencv2/opencv.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "RoiMask.h"
+
+// Samples read before the error of the estimate is first checked, and between checks after that.
+#define SPARSE_AVERAGE_MIN_SAMPLES 1024
+#define SPARSE_AVERAGE_BATCH_SAMPLES 512
+
+// Samples in a pattern. Frames with fewer pixels are averaged exactly.
+#define SPARSE_AVERAGE_MAX_SAMPLES 32768
+
+// Half width of the 95% confidence interval of the average, in levels, at which the sampling stops.
+#define SPARSE_AVERAGE_TARGET_ERROR 1.0
+#define SPARSE_AVERAGE_CONFIDENCE_Z 1.96
+
+/**
+ * The average color of a frame, estimated from a sample of its pixels.
+ */
+struct SparseAverageEstimate {
+    cv::Vec3b color;
+    int sample_count = 0;
+
+    // Half width of the 95% confidence interval of the worst channel, in levels. 0 when every pixel was read.
+    double error_bound = 0.0;
+};
+
+/**
+ * Get the sample pattern of a frame size: pixel positions of the R2 low-discrepancy sequence, in which any
+ * number of leading samples covers the frame evenly, like blue noise. Built once per size and shared.
+ */
+std::shared_ptr<const std::vector<cv::Point>> GetSparseSamplePattern(cv::Size frame_size);
+
+/**
+ * Estimates the average color of a frame, reading more samples of its pattern until the confidence interval
+ * of the average is within SPARSE_AVERAGE_TARGET_ERROR or the pattern runs out.
+ *
+ * @param frame The frame.
+ * @param roi_mask Optional mask of the pixels to look at.
+ */
+SparseAverageEstimate EstimateFrameAverageColor(const cv::Mat& frame, const RoiMask* roi_mask = nullptr);
+
+/**
+ * Collects the estimates of the columns of a render, to sum them up at the end. Several segments of a
+ * render may log to the same one at once.
+ */
+class SparseAverageLog {
+public:
+    void AddColumn(int column_id, const SparseAverageEstimate& estimate);
+
+    /**
+     * Prints the average samples per column and how many columns missed the target error.
+     */
+    void Report();
+
+    /**
+     * Writes "column,samples,error_bound" per column, in column order.
+     */
+    bool WriteCsv(const std::string& csv_path);
+
+private:
+    struct Column {
+        int column_id;
+        int sample_count;
+        double error_bound;
+    };
+
+    std::mutex columns_mutex;
+    std::vector<Column> columns;
+};
+
+#endif // !SPARSE_AVERAGE_H
@@ -0,0 +1,165 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "SpriteSheet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+string GetSpriteAtlasPath(const string& vtt_path, int atlas_id) {
+    size_t dot = vtt_path.find_last_of('.');
+    size_t slash = vtt_path.find_last_of("/\\");
+    string base = dot != string::npos && (slash == string::npos || dot > slash) ? vtt_path.substr(0, dot) : vtt_path;
+
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "-%03d.jpg", atlas_id);
+
+    return base + suffix;
+}
+
+/**
+ * Formats a time as a WebVTT timestamp, hh:mm:ss.ttt.
+ */
+static string FormatVttTime(double seconds) {
+    long long milliseconds = llround(max(seconds, 0.0) * 1000.0);
+
+    char text[32];
+    snprintf(text, sizeof(text), "%02lld:%02lld:%02lld.%03lld", milliseconds / 3600000, milliseconds / 60000 % 60,
+             milliseconds / 1000 % 60, milliseconds % 1000);
+
+    return text;
+}
+
+/**
+ * Get the file name of a path, which is how the cues point to the atlases next to them.
+ */
+static string GetFileName(const string& path) {
+    size_t slash = path.find_last_of("/\\");
+
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+SpriteSheetAnalyzer::SpriteSheetAnalyzer(const SpriteSheetOptions& options, int art_columns)
+    : options(options), art_columns(art_columns), fps(0.0), frame_count(0), atlas_id(0), atlas_tiles(0) {
+}
+
+bool SpriteSheetAnalyzer::Begin(const FrameBusInfo& info, FrameSubscription& subscription) {
+    if (info.frame_count <= 0 || info.fps <= 0.0 || info.frame_size.width <= 0)
+        return false;
+
+    fps = info.fps;
+    frame_count = info.frame_count;
+    thumbnails.clear();
+    atlas_id = 0;
+    atlas_tiles = 0;
+
+    // A multiple of the interval of the art lands on frames the bus decodes anyway.
+    int art_interval = art_columns > 0 ? max(1, frame_count / art_columns) : 1;
+    int art_samples = max(1, (int)lround(options.seconds * fps / art_interval));
+
+    subscription.interval = art_interval * art_samples;
+    subscription.width = options.thumbnail_width;
+
+    tile_size = GetReducedFrameSize(info.frame_size, options.thumbnail_width);
+    atlas = Mat::zeros(tile_size.height * SPRITE_SHEET_ROWS, tile_size.width * SPRITE_SHEET_COLUMNS, CV_8UC3);
+
+    return true;
+}
+
+void SpriteSheetAnalyzer::Analyze(int frame_index, const Mat& frame) {
+    Rect tile((atlas_tiles % SPRITE_SHEET_COLUMNS) * tile_size.width, (atlas_tiles / SPRITE_SHEET_COLUMNS) * tile_size.height,
+              tile_size.width, tile_size.height);
+
+    // The bus scales to the same width, but the rounding of the height may differ a pixel.
+    if (frame.size() == tile_size)
+        frame.copyTo(atlas(tile));
+    else
+        resize(frame, atlas(tile), tile_size, 0, 0, INTER_AREA);
+
+    thumbnails.push_back({ frame_index, atlas_id, tile });
+
+    if (++atlas_tiles == SPRITE_SHEET_COLUMNS * SPRITE_SHEET_ROWS)
+        FlushAtlas();
+}
+
+void SpriteSheetAnalyzer::FlushAtlas() {
+    if (atlas_tiles == 0)
+        return;
+
+    int used_rows = (atlas_tiles + SPRITE_SHEET_COLUMNS - 1) / SPRITE_SHEET_COLUMNS;
+    Mat full_atlas = atlas(Rect(0, 0, atlas.cols, used_rows * tile_size.height)).clone();
+    string atlas_path = GetSpriteAtlasPath(options.vtt_path, atlas_id);
+
+    encodes.push_back(GetSharedThreadPool().Enqueue([full_atlas, atlas_path]() {
+        if (!imwrite(atlas_path, full_atlas, { IMWRITE_JPEG_QUALITY, SPRITE_SHEET_JPEG_QUALITY }))
+            cout << "Error writing the sprite atlas: " << atlas_path << endl;
+    }));
+
+    atlas.setTo(Scalar::all(0));
+    atlas_id++;
+    atlas_tiles = 0;
+}
+
+void SpriteSheetAnalyzer::Finish() {
+    FlushAtlas();
+
+    for (future<void>& encode : encodes)
+        encode.get();
+
+    encodes.clear();
+
+    if (WriteVtt())
+        cout << "Sprites: " << thumbnails.size() << " thumbnails in " << atlas_id << " atlases, cues written to " << options.vtt_path << endl;
+}
+
+bool SpriteSheetAnalyzer::WriteVtt() const {
+    ofstream vtt(options.vtt_path);
+
+    if (!vtt.is_open()) {
+        cout << "Error opening the WebVTT file: " << options.vtt_path << endl;
+        return false;
+    }
+
+    vtt << "WEBVTT" << endl;
+
+    // Every thumbnail stands for the time up to the next one, the last one up to the end of the movie.
+    for (size_t i = 0; i < thumbnails.size(); i++) {
+        const Thumbnail& thumbnail = thumbnails[i];
+        int end_frame = i + 1 < thumbnails.size() ? thumbnails[i + 1].frame_index : frame_count;
+
+        vtt << endl
+            << FormatVttTime(thumbnail.frame_index / fps) << " --> " << FormatVttTime(end_frame / fps) << endl
+            << GetFileName(GetSpriteAtlasPath(options.vtt_path, thumbnail.atlas_id)) << "#xywh=" << thumbnail.tile.x << ","
+            << thumbnail.tile.y << "," << thumbnail.tile.width << "," << thumbnail.tile.height << endl;
+    }
+
+    return (bool)vtt;
+}
+
+int SpriteSheetAnalyzer::GetThumbnailCount() const {
+    return (int)thumbnails.size();
+}
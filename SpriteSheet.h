@@ -0,0 +1,103 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef SPRITE_SHEET_H
+#define SPRITE_SHEET_H
+
+#include "opencv2/opencv.hpp"
+#include <future>
+#include <string>
+#include <vector>
+
+#include "AnalyzerBus.h"
+
+// Thumbnails per row and rows per sprite atlas.
+#define SPRITE_SHEET_COLUMNS 10
+#define SPRITE_SHEET_ROWS 10
+
+#define SPRITE_SHEET_JPEG_QUALITY 80
+
+/**
+ * The scrubbing thumbnails of a video player: sprite atlases of small frames, and a WebVTT file with a cue
+ * per thumbnail that points into them.
+ */
+struct SpriteSheetOptions {
+    // The WebVTT file. The atlases are written next to it, as "<name>-000.jpg" and so on.
+    std::string vtt_path;
+
+    int thumbnail_width = 160;
+
+    // Time between the thumbnails, rounded to the samples of the art so no other frame is decoded.
+    double seconds = 2.0;
+};
+
+/**
+ * Get the path of a sprite atlas.
+ *
+ * @param vtt_path The path to the WebVTT file.
+ * @param atlas_id The index of the atlas.
+ */
+std::string GetSpriteAtlasPath(const std::string& vtt_path, int atlas_id);
+
+/**
+ * Packs the frames it gets into sprite atlases, and writes the WebVTT cues for them at the end. A full
+ * atlas is encoded on the shared pool, while the bus goes on decoding.
+ */
+class SpriteSheetAnalyzer : public FrameAnalyzer {
+public:
+    /**
+     * @param options Where and how to write the thumbnails.
+     * @param art_columns The columns of the art rendered on the same bus, to take the thumbnails at its
+     *                    samples, or 0 without one.
+     */
+    SpriteSheetAnalyzer(const SpriteSheetOptions& options, int art_columns = 0);
+
+    bool Begin(const FrameBusInfo& info, FrameSubscription& subscription) override;
+    void Analyze(int frame_index, const cv::Mat& frame) override;
+    void Finish() override;
+
+    int GetThumbnailCount() const;
+
+private:
+    struct Thumbnail {
+        int frame_index;
+        int atlas_id;
+        cv::Rect tile;
+    };
+
+    // Encodes the atlas being filled, cropped to the rows it used.
+    void FlushAtlas();
+
+    bool WriteVtt() const;
+
+    SpriteSheetOptions options;
+    int art_columns;
+
+    double fps;
+    int frame_count;
+    cv::Size tile_size;
+
+    std::vector<Thumbnail> thumbnails;
+    cv::Mat atlas;
+    int atlas_id;
+    int atlas_tiles;
+    std::vector<std::future<void>> encodes;
+};
+
+#endif // !SPRITE_SHEET_H
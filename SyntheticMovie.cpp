@@ -0,0 +1,247 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "SyntheticMovie.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+// Time base of variable frame rate movies: 24, 30 and 60 fps content all land on whole ticks of it.
+#define SYNTHETIC_VFR_TIME_BASE 120
+
+#define SYNTHETIC_SHAPES_PER_SCENE 6
+
+SyntheticMovie::SyntheticMovie(const SyntheticMovieConfig& config) : config(config), background_scene(-1) {
+    fps = config.variable_frame_rate ? SYNTHETIC_VFR_TIME_BASE : config.fps;
+    frame_count = max(1, (int)(config.duration_seconds * fps));
+    fade_frames = max(1, (int)(config.fade_seconds * fps));
+
+    int frame_w = config.frame_size.width;
+    int frame_h = config.frame_size.height;
+    picture = Rect(0, 0, frame_w, frame_h);
+
+    if (config.letterbox_ratio > 0.0) {
+        double frame_ratio = (double)frame_w / frame_h;
+
+        if (config.letterbox_ratio > frame_ratio) {
+            int picture_h = (int)(frame_w / config.letterbox_ratio) & ~1;
+            picture = Rect(0, (frame_h - picture_h) / 2, frame_w, picture_h);
+        }
+        else {
+            int picture_w = (int)(frame_h * config.letterbox_ratio) & ~1;
+            picture = Rect((frame_w - picture_w) / 2, 0, picture_w, frame_h);
+        }
+    }
+
+    CreateScenes();
+}
+
+int SyntheticMovie::GetFrameCount() const {
+    return frame_count;
+}
+
+double SyntheticMovie::GetFps() const {
+    return fps;
+}
+
+void SyntheticMovie::CreateScenes() {
+    RNG rng(config.seed);
+    int mean_scene_frames = max(2, (int)(config.mean_scene_seconds * fps));
+    int first_frame = 0;
+
+    while (first_frame < frame_count) {
+        Scene scene;
+        scene.first_frame = first_frame;
+        scene.last_frame = min(frame_count, first_frame + rng.uniform(mean_scene_frames / 2, mean_scene_frames * 3 / 2 + 1));
+        scene.fade_in = first_frame > 0 && rng.uniform(0.0, 1.0) < config.fade_share;
+
+        // Content of a variable frame rate scene changes every hold_ticks of the time base.
+        static const int holds[] = { 5, 4, 2 };
+        scene.hold_ticks = config.variable_frame_rate ? holds[rng.uniform(0, 3)] : 1;
+
+        // A gradient between two random colors, across a random direction.
+        scene.gradient_from = Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        scene.gradient_to = Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        scene.vertical_gradient = rng.uniform(0, 2) == 1;
+
+        for (int s = 0; s < SYNTHETIC_SHAPES_PER_SCENE; s++) {
+            scene.shape_colors.push_back(Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)));
+            scene.shape_origins.push_back(Point(rng.uniform(0, picture.width), rng.uniform(0, picture.height)));
+            scene.shape_speeds.push_back(Point(rng.uniform(-12, 13), rng.uniform(-8, 9)));
+            scene.shape_sizes.push_back(rng.uniform(picture.height / 20 + 1, picture.height / 5 + 2));
+        }
+
+        scenes.push_back(scene);
+        first_frame = scene.last_frame;
+    }
+}
+
+int SyntheticMovie::FindScene(int index) const {
+    size_t low = 0;
+    size_t high = scenes.size() - 1;
+
+    while (low < high) {
+        size_t middle = (low + high + 1) / 2;
+
+        if (scenes[middle].first_frame <= index)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    return (int)low;
+}
+
+const Mat& SyntheticMovie::GetSceneBackground(int scene_index) const {
+    if (background_scene == scene_index)
+        return background;
+
+    const Scene& scene = scenes[scene_index];
+    int steps = scene.vertical_gradient ? picture.height : picture.width;
+
+    background.create(picture.height, picture.width, CV_8UC3);
+
+    for (int i = 0; i < steps; i++) {
+        double t = (double)i / max(1, steps - 1);
+        Scalar color = scene.gradient_from * (1.0 - t) + scene.gradient_to * t;
+        Mat line = scene.vertical_gradient ? background.row(i) : background.col(i);
+        line.setTo(color);
+    }
+
+    background_scene = scene_index;
+
+    return background;
+}
+
+void SyntheticMovie::RenderFrame(int index, Mat& frame) const {
+    int current_scene = FindScene(index);
+    const Scene& scene = scenes[current_scene];
+
+    frame.create(config.frame_size.height, config.frame_size.width, CV_8UC3);
+
+    if (picture.width != frame.cols || picture.height != frame.rows)
+        frame.setTo(Scalar(0, 0, 0));
+
+    Mat picture_area = frame(picture);
+    GetSceneBackground(current_scene).copyTo(picture_area);
+
+    // Variable frame rate scenes only move when their content frame changes.
+    int scene_index = index - scene.first_frame;
+    int time = scene_index / scene.hold_ticks * scene.hold_ticks;
+
+    for (size_t s = 0; s < scene.shape_sizes.size(); s++) {
+        int x = scene.shape_origins[s].x + scene.shape_speeds[s].x * time;
+        int y = scene.shape_origins[s].y + scene.shape_speeds[s].y * time;
+
+        // Shapes bounce inside the picture.
+        int span_x = 2 * picture.width;
+        int span_y = 2 * picture.height;
+        x = ((x % span_x) + span_x) % span_x;
+        y = ((y % span_y) + span_y) % span_y;
+        x = x < picture.width ? x : span_x - x - 1;
+        y = y < picture.height ? y : span_y - y - 1;
+
+        if (s % 2 == 0)
+            circle(picture_area, Point(x, y), scene.shape_sizes[s] / 2, scene.shape_colors[s], FILLED);
+        else
+            rectangle(picture_area, Rect(x - scene.shape_sizes[s] / 2, y - scene.shape_sizes[s] / 2, scene.shape_sizes[s], scene.shape_sizes[s]),
+                      scene.shape_colors[s], FILLED);
+    }
+
+    // Fades go through black: the end of the previous scene darkens and the start of this one brightens.
+    if (scene.fade_in && scene_index < fade_frames) {
+        double level = (double)(scene_index + 1) / (fade_frames + 1);
+        picture_area.convertTo(picture_area, -1, level);
+    }
+
+    int frames_left = scene.last_frame - index;
+    if (scene.last_frame < frame_count && frames_left <= fade_frames && scenes[current_scene + 1].fade_in) {
+        double level = (double)frames_left / (fade_frames + 1);
+        picture_area.convertTo(picture_area, -1, level);
+    }
+}
+
+/**
+ * Sets the FFmpeg encoder options OpenCV reads when opening a writer, like the keyframe interval.
+ *
+ * @param options The options, or nullptr to unset them.
+ */
+static void SetFfmpegWriterOptions(const string* options) {
+#ifdef _WIN32
+    // An empty value removes the variable.
+    _putenv_s("OPENCV_FFMPEG_WRITER_OPTIONS", options != nullptr ? options->c_str() : "");
+#else
+    if (options == nullptr)
+        unsetenv("OPENCV_FFMPEG_WRITER_OPTIONS");
+    else
+        setenv("OPENCV_FFMPEG_WRITER_OPTIONS", options->c_str(), 1);
+#endif
+}
+
+bool WriteSyntheticMovie(const string& movie_path, const SyntheticMovieConfig& config) {
+    if (config.fourcc.size() != 4) {
+        cout << "The codec must be a four characters code." << endl;
+        return false;
+    }
+
+    SyntheticMovie movie(config);
+    int fourcc = VideoWriter::fourcc(config.fourcc[0], config.fourcc[1], config.fourcc[2], config.fourcc[3]);
+
+    // The options set for the whole run are kept along the keyframe interval, and put back once the writer is open.
+    const char* run_options = getenv("OPENCV_FFMPEG_WRITER_OPTIONS");
+    bool has_run_options = run_options != nullptr;
+    string previous_options = has_run_options ? run_options : "";
+
+    if (config.keyframe_interval > 0) {
+        string options = "g;" + to_string(config.keyframe_interval) + "|keyint_min;" + to_string(config.keyframe_interval);
+
+        if (!previous_options.empty())
+            options = previous_options + "|" + options;
+
+        SetFfmpegWriterOptions(&options);
+    }
+
+    VideoWriter writer(movie_path, fourcc, movie.GetFps(), config.frame_size);
+
+    if (config.keyframe_interval > 0)
+        SetFfmpegWriterOptions(has_run_options ? &previous_options : nullptr);
+
+    if (!writer.isOpened()) {
+        cout << "Error opening synthetic movie file." << endl;
+        return false;
+    }
+
+    Mat frame;
+    int64 start = getTickCount();
+
+    for (int i = 0; i < movie.GetFrameCount(); i++) {
+        movie.RenderFrame(i, frame);
+        writer.write(frame);
+    }
+
+    writer.release();
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    cout << "Synthetic movie: " << movie.GetFrameCount() << " frames written in " << seconds << "s." << endl;
+
+    return true;
+}
@@ -0,0 +1,116 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef SYNTHETIC_MOVIE_H
+#define SYNTHETIC_MOVIE_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * What a synthetic movie looks like and how it is encoded.
+ */
+struct SyntheticMovieConfig {
+    double duration_seconds = 60.0;
+    cv::Size frame_size = cv::Size(1920, 1080);
+    double fps = 24.0;
+
+    // Four characters code of the codec, e.g. "mp4v", "avc1" or "MJPG".
+    std::string fourcc = "mp4v";
+
+    // Frames between keyframes, or 0 for the encoder default. Only the FFmpeg backend honours it.
+    int keyframe_interval = 0;
+
+    double mean_scene_seconds = 4.0;
+
+    // Share of the scene changes that fade through black instead of cutting.
+    double fade_share = 0.3;
+    double fade_seconds = 0.75;
+
+    // Aspect ratio of the picture inside letterbox bars, like 2.39, or 0 for a full frame.
+    double letterbox_ratio = 0.0;
+
+    // Scenes alternate between 24, 30 and 60 frames per second content, held on a 120 fps time base.
+    bool variable_frame_rate = false;
+
+    unsigned seed = 1;
+};
+
+/**
+ * A procedural movie made of scenes of gradients and moving shapes, with cuts, fades and letterbox bars.
+ * The same config always gives the same frames, so runs can be compared without shipping real movies.
+ * Frames are drawn one at a time from a single thread.
+ */
+class SyntheticMovie {
+public:
+    explicit SyntheticMovie(const SyntheticMovieConfig& config);
+
+    int GetFrameCount() const;
+    double GetFps() const;
+
+    /**
+     * Draws a frame of the movie.
+     *
+     * @param index The index of the frame.
+     * @param frame Receives the frame.
+     */
+    void RenderFrame(int index, cv::Mat& frame) const;
+
+private:
+    struct Scene {
+        int first_frame;
+        int last_frame;
+        bool fade_in;
+        int hold_ticks;
+        cv::Scalar gradient_from;
+        cv::Scalar gradient_to;
+        bool vertical_gradient;
+        std::vector<cv::Scalar> shape_colors;
+        std::vector<cv::Point> shape_origins;
+        std::vector<cv::Point> shape_speeds;
+        std::vector<int> shape_sizes;
+    };
+
+    void CreateScenes();
+    int FindScene(int index) const;
+    const cv::Mat& GetSceneBackground(int scene_index) const;
+
+    SyntheticMovieConfig config;
+    double fps;
+    int frame_count;
+    int fade_frames;
+    cv::Rect picture;
+    std::vector<Scene> scenes;
+
+    // Backgrounds are drawn when their scene starts, keeping one in memory whatever the length of the movie.
+    mutable int background_scene;
+    mutable cv::Mat background;
+};
+
+/**
+ * Encodes a synthetic movie with VideoWriter.
+ *
+ * @param movie_path The path of the movie to write.
+ * @param config What the movie looks like and how it is encoded.
+ * @return Whether the movie could be written.
+ */
+bool WriteSyntheticMovie(const std::string& movie_path, const SyntheticMovieConfig& config);
+
+#endif // !SYNTHETIC_MOVIE_H
@@ -0,0 +1,129 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "ThreadPool.h"
+
+#include <atomic>
+
+#include "Concurrency.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int thread_count) : stopping(false) {
+    if (thread_count <= 0)
+        thread_count = GetAvailableCores();
+
+    for (int i = 0; i < thread_count; i++)
+        workers.push_back(thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(tasks_mutex);
+        stopping = true;
+    }
+    tasks_cv.notify_all();
+
+    for (thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(int count, const function<void(int)>& body) {
+    if (count <= 0)
+        return;
+
+    if (count == 1) {
+        body(0);
+        return;
+    }
+
+    // Shared with the helpers, which may only start after the loop is over and then find nothing left to take.
+    struct Loop {
+        atomic<int> next_index;
+        int done_count = 0;
+        mutex done_mutex;
+        condition_variable done_cv;
+    };
+
+    shared_ptr<Loop> loop = make_shared<Loop>();
+    loop->next_index = 0;
+
+    // The body is only reached through indexes taken before the last one is done, so it outlives every use.
+    const function<void(int)>* loop_body = &body;
+
+    function<void()> take_indexes = [loop, loop_body, count]() {
+        int finished = 0;
+
+        for (int i = loop->next_index++; i < count; i = loop->next_index++) {
+            (*loop_body)(i);
+            finished++;
+        }
+
+        if (finished > 0) {
+            lock_guard<mutex> lock(loop->done_mutex);
+            loop->done_count += finished;
+
+            if (loop->done_count == count)
+                loop->done_cv.notify_all();
+        }
+    };
+
+    int helper_count = min(count - 1, GetThreadCount());
+
+    for (int i = 0; i < helper_count; i++)
+        Enqueue(take_indexes);
+
+    take_indexes();
+
+    unique_lock<mutex> lock(loop->done_mutex);
+    loop->done_cv.wait(lock, [&loop, count] { return loop->done_count == count; });
+}
+
+int ThreadPool::GetThreadCount() const {
+    return (int)workers.size();
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+            if (tasks.empty())
+                return;
+
+            task = move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+static int shared_thread_count = 0;
+
+void SetSharedThreadPoolSize(int thread_count) {
+    shared_thread_count = thread_count;
+}
+
+ThreadPool& GetSharedThreadPool() {
+    static ThreadPool pool(shared_thread_count);
+    return pool;
+}
@@ -0,0 +1,97 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads running queued tasks in order of arrival.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param thread_count How many workers to start. Zero or less uses one per available core.
+     */
+    explicit ThreadPool(int thread_count);
+    ~ThreadPool();
+
+    /**
+     * Queues a task for the workers.
+     *
+     * @param task Any callable without arguments.
+     * @return A future that becomes ready when the task finishes, rethrowing whatever the task threw.
+     */
+    template<typename Task>
+    std::future<void> Enqueue(Task task) {
+        std::shared_ptr<std::packaged_task<void()>> packaged = std::make_shared<std::packaged_task<void()>>(task);
+        std::future<void> result = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+            tasks.push_back([packaged] { (*packaged)(); });
+        }
+        tasks_cv.notify_one();
+
+        return result;
+    }
+
+    /**
+     * Runs body(0) to body(count - 1) on the workers and the calling thread, and returns once they are all done.
+     * The calling thread takes every index no worker has started, so it never waits on queued tasks, and
+     * a task already running on the pool can split its own work without starving it.
+     *
+     * @param count How many indexes to run.
+     * @param body The work of one index. Different indexes run at the same time.
+     */
+    void ParallelFor(int count, const std::function<void(int)>& body);
+
+    int GetThreadCount() const;
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex tasks_mutex;
+    std::condition_variable tasks_cv;
+    bool stopping;
+};
+
+/**
+ * The pool shared by every render in the process, so concurrent renders don't spawn threads of their own.
+ */
+ThreadPool& GetSharedThreadPool();
+
+/**
+ * Sets how many workers the shared pool starts with. Only has an effect before its first use.
+ *
+ * @param thread_count How many workers to start. Zero or less uses one per available core.
+ */
+void SetSharedThreadPoolSize(int thread_count);
+
+#endif // !THREAD_POOL_H
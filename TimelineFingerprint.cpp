@@ -0,0 +1,393 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "TimelineFingerprint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+// The first bytes of a fingerprint file, changed whenever its format changes.
+#define FINGERPRINT_MAGIC "MWFP0001"
+
+// Directions of the steps of the alignment, kept to trace the path back.
+#define ALIGNMENT_STEP_MATCH 0
+#define ALIGNMENT_STEP_FIRST 1
+#define ALIGNMENT_STEP_SECOND 2
+
+int TimelineFingerprint::GetSampleCount() const {
+    return (int)(signatures.size() / FINGERPRINT_SIGNATURE_BYTES);
+}
+
+void GetFrameBandSignature(const Mat& frame, uchar* signature) {
+    // Area interpolation down to a single column averages every band of rows, weighing the rows it splits.
+    Mat bands;
+    resize(frame, bands, Size(1, FINGERPRINT_BANDS), 0, 0, INTER_AREA);
+
+    for (int band = 0; band < FINGERPRINT_BANDS; band++)
+        memcpy(signature + band * 3, bands.ptr<uchar>(band), 3);
+}
+
+bool BuildTimelineFingerprint(const string& movie_path, const ArtRenderOptions& options, TimelineFingerprint& fingerprint, double samples_per_second) {
+    VideoCapture cap;
+
+    if (!OpenMovieCapture(cap, movie_path, options)) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return false;
+    }
+
+    int frame_count = (int)cap.get(CAP_PROP_FRAME_COUNT);
+    double fps = cap.get(CAP_PROP_FPS);
+    Size frame_size((int)cap.get(CAP_PROP_FRAME_WIDTH), (int)cap.get(CAP_PROP_FRAME_HEIGHT));
+    cap.release();
+
+    if (frame_count <= 0 || fps <= 0.0)
+        return false;
+
+    int sample_interval = max(1, (int)lround(fps / samples_per_second));
+    int sample_count = frame_count / sample_interval;
+
+    if (sample_count == 0)
+        return false;
+
+    // The bands need the decoded frame, and no style reads the frame after it.
+    ArtRenderOptions fingerprint_options = options;
+    fingerprint_options.style = ART_STYLE_AVERAGE_COLOR;
+    fingerprint_options.preview = false;
+    fingerprint_options.dc_average = false;
+
+    fingerprint.seconds_per_sample = sample_interval / fps;
+    fingerprint.signatures.assign((size_t)sample_count * FINGERPRINT_SIGNATURE_BYTES, 0);
+
+    shared_ptr<const GopIndex> gop_index = options.sampling == ART_SAMPLING_GOP ? GetMovieGopIndex(movie_path) : nullptr;
+    int segment_count = min(sample_count, GetSharedThreadPool().GetThreadCount());
+
+    // Whether each sample got a frame of its own. Segments write disjoint samples, so no lock is needed.
+    vector<uchar> sampled(sample_count, 0);
+    atomic<bool> open_failed(false);
+
+    GetSharedThreadPool().ParallelFor(segment_count, [&](int segment) {
+        int first_sample = (int)((long long)segment * sample_count / segment_count);
+        int last_sample = (int)((long long)(segment + 1) * sample_count / segment_count);
+
+        VideoCapture segment_cap;
+
+        if (!OpenMovieCapture(segment_cap, movie_path, fingerprint_options)) {
+            open_failed = true;
+            return;
+        }
+
+        MemoryReservation reservation(EstimateRenderMemory(frame_size, fingerprint_options), fingerprint_options.memory_job);
+        ArtFrameSampler sampler(segment_cap, fingerprint_options, gop_index);
+        ArtColumnContext context;
+
+        for (int sample = first_sample; sample < last_sample; sample++) {
+            int status = sampler.Read(sample * sample_interval, context);
+
+            if (status == ART_FRAME_END_OF_MOVIE)
+                break;
+
+            if (status == ART_FRAME_OK) {
+                GetFrameBandSignature(sampler.GetFrame(), &fingerprint.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES]);
+                sampled[sample] = 1;
+            }
+        }
+    });
+
+    if (open_failed) {
+        cout << "Error opening video file: " << movie_path << endl;
+        return false;
+    }
+
+    int first_sampled = (int)(find(sampled.begin(), sampled.end(), 1) - sampled.begin());
+
+    if (first_sampled == sample_count) {
+        cout << "No frame of the movie could be decoded: " << movie_path << endl;
+        return false;
+    }
+
+    // Damaged samples, and the ones past an early end, repeat the sample before them, as damaged columns of
+    // the art do, also across the starts of the segments. The ones before the first good sample repeat it.
+    for (int sample = 0; sample < sample_count; sample++) {
+        if (sampled[sample])
+            continue;
+
+        int source = sample < first_sampled ? first_sampled : sample - 1;
+        memcpy(&fingerprint.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES], &fingerprint.signatures[(size_t)source * FINGERPRINT_SIGNATURE_BYTES],
+               FINGERPRINT_SIGNATURE_BYTES);
+    }
+
+    return true;
+}
+
+bool SaveTimelineFingerprint(const string& fingerprint_path, const TimelineFingerprint& fingerprint) {
+    ofstream file(fingerprint_path, ios::binary);
+    int sample_count = fingerprint.GetSampleCount();
+    int bands = FINGERPRINT_BANDS;
+
+    file.write(FINGERPRINT_MAGIC, 8);
+    file.write((const char*)&fingerprint.seconds_per_sample, sizeof(fingerprint.seconds_per_sample));
+    file.write((const char*)&bands, sizeof(bands));
+    file.write((const char*)&sample_count, sizeof(sample_count));
+    file.write((const char*)fingerprint.signatures.data(), fingerprint.signatures.size());
+
+    if (!file) {
+        cout << "Error writing the fingerprint: " << fingerprint_path << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadTimelineFingerprint(const string& fingerprint_path, TimelineFingerprint& fingerprint) {
+    ifstream file(fingerprint_path, ios::binary);
+    char magic[8];
+    int bands = 0;
+    int sample_count = 0;
+
+    file.read(magic, 8);
+    file.read((char*)&fingerprint.seconds_per_sample, sizeof(fingerprint.seconds_per_sample));
+    file.read((char*)&bands, sizeof(bands));
+    file.read((char*)&sample_count, sizeof(sample_count));
+
+    if (!file || memcmp(magic, FINGERPRINT_MAGIC, 8) != 0 || bands != FINGERPRINT_BANDS || sample_count < 0
+        || fingerprint.seconds_per_sample <= 0.0) {
+        cout << "Error reading the fingerprint: " << fingerprint_path << endl;
+        return false;
+    }
+
+    fingerprint.signatures.resize((size_t)sample_count * FINGERPRINT_SIGNATURE_BYTES);
+    file.read((char*)fingerprint.signatures.data(), fingerprint.signatures.size());
+
+    if (!file) {
+        cout << "Error reading the fingerprint: " << fingerprint_path << endl;
+        return false;
+    }
+
+    return true;
+}
+
+vector<uchar> ResampleFingerprintSignatures(const TimelineFingerprint& fingerprint, double seconds_per_sample) {
+    int sample_count = fingerprint.GetSampleCount();
+
+    if (fabs(fingerprint.seconds_per_sample - seconds_per_sample) < 1e-9)
+        return fingerprint.signatures;
+
+    int resampled_count = (int)(sample_count * fingerprint.seconds_per_sample / seconds_per_sample);
+    vector<uchar> resampled((size_t)resampled_count * FINGERPRINT_SIGNATURE_BYTES);
+
+    for (int sample = 0; sample < resampled_count; sample++) {
+        int source = min(sample_count - 1, (int)lround(sample * seconds_per_sample / fingerprint.seconds_per_sample));
+        memcpy(&resampled[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES], &fingerprint.signatures[(size_t)source * FINGERPRINT_SIGNATURE_BYTES],
+               FINGERPRINT_SIGNATURE_BYTES);
+    }
+
+    return resampled;
+}
+
+/**
+ * Sum of absolute differences between two signatures, for single pairs. The bands of the alignment are
+ * compared in bulk by GetBandDistances.
+ */
+static inline int GetSignatureDistance(const uchar* first, const uchar* second) {
+    int distance = 0;
+
+    for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++)
+        distance += abs((int)first[i] - (int)second[i]);
+
+    return distance;
+}
+
+/**
+ * Distances of one signature to a run of consecutive signatures, which are contiguous bytes. The signature is
+ * tiled as often as the run, so the differences and their sums per signature are two vectorized passes of
+ * OpenCV over the whole run instead of a short loop per signature.
+ *
+ * @param signature The signature of the first fingerprint.
+ * @param run The first signature of the run in the second fingerprint.
+ * @param count The signatures in the run.
+ * @param tiled Scratch space for the tiled signature, kept between calls.
+ * @param differences Scratch space for the differences, kept between calls.
+ * @param distances Receives count distances.
+ */
+static void GetBandDistances(const uchar* signature, const uchar* run, int count, Mat& tiled, Mat& differences, int* distances) {
+    repeat(Mat(1, FINGERPRINT_SIGNATURE_BYTES, CV_8U, (void*)signature), count, 1, tiled);
+    absdiff(tiled, Mat(count, FINGERPRINT_SIGNATURE_BYTES, CV_8U, (void*)run), differences);
+
+    // Already sized and typed, so the sums land in distances.
+    Mat sums(count, 1, CV_32S, distances);
+    reduce(differences, sums, 1, REDUCE_SUM, CV_32S);
+}
+
+FingerprintAlignment AlignFingerprints(const TimelineFingerprint& first, const TimelineFingerprint& second) {
+    FingerprintAlignment alignment;
+    alignment.seconds_per_sample = first.seconds_per_sample;
+
+    vector<uchar> second_signatures = ResampleFingerprintSignatures(second, first.seconds_per_sample);
+    int first_count = first.GetSampleCount();
+    int second_count = (int)(second_signatures.size() / FINGERPRINT_SIGNATURE_BYTES);
+
+    alignment.matched_samples.assign(first_count, -1);
+
+    if (first_count == 0 || second_count == 0)
+        return alignment;
+
+    // The path stays between these offsets from the diagonal, j - i, and has to reach (first_count - 1, second_count - 1).
+    int slack = max(FINGERPRINT_DTW_MIN_SLACK, max(first_count, second_count) / 50);
+    int low_offset = min(0, second_count - first_count) - slack;
+    int high_offset = max(0, second_count - first_count) + slack;
+    int band_width = high_offset - low_offset + 1;
+
+    const int step_penalty = FINGERPRINT_DTW_STEP_PENALTY * FINGERPRINT_SIGNATURE_BYTES;
+    vector<int> previous_costs(band_width, INT_MAX);
+    vector<int> costs(band_width, INT_MAX);
+    vector<uchar> steps((size_t)first_count * band_width, ALIGNMENT_STEP_MATCH);
+    vector<int> distances(band_width);
+    Mat tiled;
+    Mat differences;
+
+    for (int i = 0; i < first_count; i++) {
+        const uchar* first_signature = &first.signatures[(size_t)i * FINGERPRINT_SIGNATURE_BYTES];
+        int first_k = max(0, -i - low_offset);
+        int last_k = min(band_width - 1, second_count - 1 - i - low_offset);
+
+        // The distances of the whole band first, in one vectorized pass, then the recurrence over them.
+        if (last_k >= first_k) {
+            GetBandDistances(first_signature, &second_signatures[(size_t)(i + low_offset + first_k) * FINGERPRINT_SIGNATURE_BYTES],
+                             last_k - first_k + 1, tiled, differences, &distances[first_k]);
+        }
+
+        fill(costs.begin(), costs.end(), INT_MAX);
+        uchar* row_steps = &steps[(size_t)i * band_width];
+
+        for (int k = first_k; k <= last_k; k++) {
+            int j = i + low_offset + k;
+
+            // (i - 1, j - 1) is the same offset on the previous row, (i - 1, j) one more, (i, j - 1) one less on this row.
+            // Before the first sample of either movie, every sample of the other one is skipped.
+            int match_cost = i == 0 || j == 0 ? max(i, j) * step_penalty : previous_costs[k];
+            int first_cost = i == 0 ? (j + 1) * step_penalty : k + 1 < band_width ? previous_costs[k + 1] : INT_MAX;
+            int second_cost = j == 0 ? (i + 1) * step_penalty : k > 0 ? costs[k - 1] : INT_MAX;
+
+            int best = match_cost != INT_MAX ? match_cost + distances[k] : INT_MAX;
+            uchar step = ALIGNMENT_STEP_MATCH;
+
+            // A skipped sample pays the penalty only, whatever it looks like.
+            if (first_cost != INT_MAX && first_cost + step_penalty < best) {
+                best = first_cost + step_penalty;
+                step = ALIGNMENT_STEP_FIRST;
+            }
+
+            if (second_cost != INT_MAX && second_cost + step_penalty < best) {
+                best = second_cost + step_penalty;
+                step = ALIGNMENT_STEP_SECOND;
+            }
+
+            costs[k] = best;
+            row_steps[k] = step;
+        }
+
+        swap(previous_costs, costs);
+    }
+
+    // Traces the path back from the last samples of both movies.
+    int i = first_count - 1;
+    int j = second_count - 1;
+    long long matched_distance = 0;
+    int matched_count = 0;
+
+    while (i >= 0 && j >= 0) {
+        uchar step = steps[(size_t)i * band_width + (j - i - low_offset)];
+
+        if (step == ALIGNMENT_STEP_MATCH) {
+            alignment.matched_samples[i] = j;
+            matched_distance += GetSignatureDistance(&first.signatures[(size_t)i * FINGERPRINT_SIGNATURE_BYTES],
+                                                     &second_signatures[(size_t)j * FINGERPRINT_SIGNATURE_BYTES]);
+            matched_count++;
+            i--;
+            j--;
+        }
+        else if (step == ALIGNMENT_STEP_FIRST)
+            i--;
+        else
+            j--;
+    }
+
+    if (matched_count > 0)
+        alignment.mean_distance = (double)matched_distance / ((long long)matched_count * FINGERPRINT_SIGNATURE_BYTES);
+
+    alignment.matched_ratio = (double)matched_count / max(first_count, second_count);
+    alignment.same_movie = matched_count > 0 && alignment.mean_distance <= FINGERPRINT_SAME_MOVIE_DISTANCE
+                           && alignment.matched_ratio >= FINGERPRINT_SAME_MOVIE_MATCHED;
+
+    return alignment;
+}
+
+long long MapFingerprintTime(const FingerprintAlignment& alignment, long long milliseconds) {
+    if (alignment.seconds_per_sample <= 0.0 || milliseconds < 0)
+        return -1;
+
+    double sample_milliseconds = alignment.seconds_per_sample * 1000.0;
+    int sample = (int)(milliseconds / sample_milliseconds);
+
+    if (sample >= (int)alignment.matched_samples.size() || alignment.matched_samples[sample] < 0)
+        return -1;
+
+    // Within a sample both movies run at the same pace.
+    double offset = milliseconds - sample * sample_milliseconds;
+
+    return llround(alignment.matched_samples[sample] * sample_milliseconds + offset);
+}
+
+/**
+ * Formats milliseconds as h:mm:ss.
+ */
+static string FormatFingerprintTime(long long milliseconds) {
+    char text[32];
+    long long seconds = milliseconds / 1000;
+    snprintf(text, sizeof(text), "%lld:%02lld:%02lld", seconds / 3600, seconds / 60 % 60, seconds % 60);
+
+    return text;
+}
+
+void PrintFingerprintAlignment(const FingerprintAlignment& alignment) {
+    cout << "Fingerprint: " << (alignment.same_movie ? "the same movie" : "different movies") << ", mean distance "
+         << alignment.mean_distance << " levels, " << alignment.matched_ratio * 100.0 << "% of the samples matched." << endl;
+
+    if (!alignment.same_movie)
+        return;
+
+    long long duration = llround(alignment.matched_samples.size() * alignment.seconds_per_sample * 1000.0);
+
+    for (long long milliseconds = 0; milliseconds < duration; milliseconds += 60000) {
+        long long mapped = MapFingerprintTime(alignment, milliseconds);
+
+        cout << "  " << FormatFingerprintTime(milliseconds) << " -> " << (mapped < 0 ? string("not in the second movie") : FormatFingerprintTime(mapped))
+             << endl;
+    }
+}
@@ -0,0 +1,129 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef TIMELINE_FINGERPRINT_H
+#define TIMELINE_FINGERPRINT_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+#include "MovieWallArt.h"
+
+// Signatures per second of movie, and horizontal bands of the frame in every signature.
+#define FINGERPRINT_SAMPLES_PER_SECOND 1.0
+#define FINGERPRINT_BANDS 4
+#define FINGERPRINT_SIGNATURE_BYTES (FINGERPRINT_BANDS * 3)
+
+// Samples the alignment may stray from the diagonal besides the difference in length of the two movies.
+#define FINGERPRINT_DTW_MIN_SLACK 30
+
+// Cost of matching a sample to no new sample of the other movie, in levels per channel. Cuts and
+// insertions are paid once per sample, so a scene is only skipped when it really isn't in the other movie.
+#define FINGERPRINT_DTW_STEP_PENALTY 8
+
+// Two movies are the same when their matched samples are this close, in levels per channel, and this
+// much of the longer one is matched.
+#define FINGERPRINT_SAME_MOVIE_DISTANCE 10.0
+#define FINGERPRINT_SAME_MOVIE_MATCHED 0.6
+
+/**
+ * A fingerprint of the timeline of a movie: the colors of FINGERPRINT_BANDS horizontal bands of a frame every
+ * second. Two hours fit in less than 100 KB.
+ */
+struct TimelineFingerprint {
+    double seconds_per_sample = 0.0;
+
+    // FINGERPRINT_SIGNATURE_BYTES per sample, the BGR colors of the bands from the top, sample after sample.
+    std::vector<cv::uchar> signatures;
+
+    int GetSampleCount() const;
+};
+
+/**
+ * Writes the signature of a frame: the average BGR color of each of FINGERPRINT_BANDS horizontal bands of
+ * rows, from the top.
+ *
+ * @param frame The frame.
+ * @param signature Receives FINGERPRINT_SIGNATURE_BYTES bytes.
+ */
+void GetFrameBandSignature(const cv::Mat& frame, cv::uchar* signature);
+
+/**
+ * Samples the frames of a movie with the art sampler and writes their signatures, split in segments among
+ * the shared pool.
+ *
+ * @param movie_path The path to the movie.
+ * @param options The decoding settings of the render. The style doesn't matter.
+ * @param fingerprint Receives the fingerprint.
+ * @param samples_per_second Signatures per second of movie. Short shots, as in trailers, need a few per second.
+ * @return Whether the movie could be opened and at least one of its samples decoded. Damaged samples, and the ones
+ *         past an early end of the movie, repeat the good sample before them.
+ */
+bool BuildTimelineFingerprint(const std::string& movie_path, const ArtRenderOptions& options, TimelineFingerprint& fingerprint,
+                              double samples_per_second = FINGERPRINT_SAMPLES_PER_SECOND);
+
+bool SaveTimelineFingerprint(const std::string& fingerprint_path, const TimelineFingerprint& fingerprint);
+
+bool LoadTimelineFingerprint(const std::string& fingerprint_path, TimelineFingerprint& fingerprint);
+
+/**
+ * Resamples the signatures of a fingerprint to another rate, taking the closest sample, so the samples of two
+ * fingerprints stand for the same time.
+ */
+std::vector<cv::uchar> ResampleFingerprintSignatures(const TimelineFingerprint& fingerprint, double seconds_per_sample);
+
+/**
+ * How the samples of one movie line up with the samples of another.
+ */
+struct FingerprintAlignment {
+    bool same_movie = false;
+
+    // Mean distance of the matched samples, in levels per channel.
+    double mean_distance = 0.0;
+
+    // The part of the samples of the longer movie matched to a sample of the other.
+    double matched_ratio = 0.0;
+
+    // Seconds per sample of the first movie, which the second one is resampled to.
+    double seconds_per_sample = 0.0;
+
+    // For every sample of the first movie, the sample of the second it matched, or -1 when the second doesn't have it.
+    std::vector<int> matched_samples;
+};
+
+/**
+ * Aligns two fingerprints with dynamic time warping, limited to a band around the diagonal as wide as the
+ * difference in length of the movies plus some slack, which any cut or insertion fits in.
+ */
+FingerprintAlignment AlignFingerprints(const TimelineFingerprint& first, const TimelineFingerprint& second);
+
+/**
+ * Maps a time of the first movie of an alignment to the second.
+ *
+ * @return The time in the second movie, in milliseconds, or -1 when the second movie doesn't have that part.
+ */
+long long MapFingerprintTime(const FingerprintAlignment& alignment, long long milliseconds);
+
+/**
+ * Prints whether the movies are the same and, every minute of the first movie, the time it maps to.
+ */
+void PrintFingerprintAlignment(const FingerprintAlignment& alignment);
+
+#endif // !TIMELINE_FINGERPRINT_H
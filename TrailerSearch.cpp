@@ -0,0 +1,180 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "TrailerSearch.h"
+
+#include "opencv2/core/hal/hal.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "ThreadPool.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Sum of absolute differences between two windows of signatures, which are contiguous bytes, so OpenCV's
+ * vectorized L1 norm takes a block of samples at once. Stops once a block puts it at the limit, since the
+ * window can't be the best one anymore.
+ */
+static int GetWindowDistance(const uchar* first, const uchar* second, int sample_count, int limit) {
+    int distance = 0;
+
+    for (int sample = 0; sample < sample_count; sample += TRAILER_ABANDON_BLOCK_SAMPLES) {
+        int block_bytes = min(TRAILER_ABANDON_BLOCK_SAMPLES, sample_count - sample) * FINGERPRINT_SIGNATURE_BYTES;
+        size_t offset = (size_t)sample * FINGERPRINT_SIGNATURE_BYTES;
+
+        distance += hal::normL1_(first + offset, second + offset, block_bytes);
+
+        if (distance >= limit)
+            return limit;
+    }
+
+    return distance;
+}
+
+/**
+ * Sum of the bytes of every signature, as prefix sums: the sum of samples [a, b) is sums[b] - sums[a].
+ */
+static vector<long long> GetSignatureSums(const vector<uchar>& signatures) {
+    size_t sample_count = signatures.size() / FINGERPRINT_SIGNATURE_BYTES;
+    vector<long long> sums(sample_count + 1, 0);
+
+    for (size_t sample = 0; sample < sample_count; sample++) {
+        int sum = 0;
+
+        for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++)
+            sum += signatures[sample * FINGERPRINT_SIGNATURE_BYTES + i];
+
+        sums[sample + 1] = sums[sample] + sum;
+    }
+
+    return sums;
+}
+
+vector<TrailerShot> LocateTrailerShots(const TimelineFingerprint& trailer, const TimelineFingerprint& feature) {
+    vector<TrailerShot> shots;
+    int feature_count = feature.GetSampleCount();
+
+    if (feature_count == 0 || feature.seconds_per_sample <= 0.0)
+        return shots;
+
+    vector<uchar> trailer_signatures = ResampleFingerprintSignatures(trailer, feature.seconds_per_sample);
+    int trailer_count = (int)(trailer_signatures.size() / FINGERPRINT_SIGNATURE_BYTES);
+    double sample_milliseconds = feature.seconds_per_sample * 1000.0;
+
+    // The first sample of every shot, and the end of the last one.
+    vector<int> shot_starts = { 0 };
+
+    for (int sample = 1; sample < trailer_count; sample++) {
+        int distance = GetWindowDistance(&trailer_signatures[(size_t)(sample - 1) * FINGERPRINT_SIGNATURE_BYTES],
+                                         &trailer_signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES], 1, INT_MAX);
+
+        if (distance > TRAILER_SHOT_CUT_DISTANCE * FINGERPRINT_SIGNATURE_BYTES)
+            shot_starts.push_back(sample);
+    }
+
+    shot_starts.push_back(trailer_count);
+
+    for (size_t i = 0; i + 1 < shot_starts.size(); i++) {
+        TrailerShot shot;
+        shot.trailer_milliseconds = llround(shot_starts[i] * sample_milliseconds);
+        shot.duration_milliseconds = llround((shot_starts[i + 1] - shot_starts[i]) * sample_milliseconds);
+        shots.push_back(shot);
+    }
+
+    vector<long long> trailer_sums = GetSignatureSums(trailer_signatures);
+    vector<long long> feature_sums = GetSignatureSums(feature.signatures);
+
+    GetSharedThreadPool().ParallelFor((int)shots.size(), [&](int shot_id) {
+        int first_sample = shot_starts[shot_id];
+        int window_samples = min(shot_starts[shot_id + 1] - first_sample, TRAILER_MAX_WINDOW_SAMPLES);
+        int window_bytes = window_samples * FINGERPRINT_SIGNATURE_BYTES;
+
+        if (window_samples < TRAILER_MIN_SHOT_SAMPLES || window_samples > feature_count)
+            return;
+
+        long long window_sum = trailer_sums[first_sample + window_samples] - trailer_sums[first_sample];
+
+        if (window_sum < (long long)TRAILER_DARK_LEVEL * window_bytes)
+            return;
+
+        const uchar* window = &trailer_signatures[(size_t)first_sample * FINGERPRINT_SIGNATURE_BYTES];
+
+        // Only windows under the match distance count, so that is where the search starts.
+        int best_distance = (int)(TRAILER_MATCH_DISTANCE * window_bytes) + 1;
+        int best_sample = -1;
+
+        for (int sample = 0; sample + window_samples <= feature_count; sample++) {
+            // The difference of the sums never exceeds the sum of the differences, and costs two reads.
+            long long sum_difference = llabs(window_sum - (feature_sums[sample + window_samples] - feature_sums[sample]));
+
+            if (sum_difference >= best_distance)
+                continue;
+
+            int distance = GetWindowDistance(window, &feature.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES], window_samples, best_distance);
+
+            if (distance < best_distance) {
+                best_distance = distance;
+                best_sample = sample;
+            }
+        }
+
+        if (best_sample < 0)
+            return;
+
+        shots[shot_id].feature_milliseconds = llround(best_sample * sample_milliseconds);
+        shots[shot_id].distance = (double)best_distance / window_bytes;
+    });
+
+    return shots;
+}
+
+/**
+ * Formats milliseconds as h:mm:ss.ttt.
+ */
+static string FormatShotTime(long long milliseconds) {
+    char text[32];
+    snprintf(text, sizeof(text), "%lld:%02lld:%02lld.%03lld", milliseconds / 3600000, milliseconds / 60000 % 60, milliseconds / 1000 % 60,
+             milliseconds % 1000);
+
+    return text;
+}
+
+void PrintTrailerShots(const vector<TrailerShot>& shots) {
+    int found = 0;
+
+    for (const TrailerShot& shot : shots) {
+        cout << "  " << FormatShotTime(shot.trailer_milliseconds) << " (" << shot.duration_milliseconds / 1000.0 << "s) -> ";
+
+        if (shot.feature_milliseconds < 0)
+            cout << "not found" << endl;
+        else {
+            cout << FormatShotTime(shot.feature_milliseconds) << ", distance " << shot.distance << endl;
+            found++;
+        }
+    }
+
+    cout << "Trailer: " << found << " of " << shots.size() << " shots found in the feature." << endl;
+}
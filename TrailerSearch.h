@@ -0,0 +1,75 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#ifndef TRAILER_SEARCH_H
+#define TRAILER_SEARCH_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+#include "TimelineFingerprint.h"
+
+// Signatures per second of the fingerprints of trailers and the features they are searched in, as shots
+// of a trailer often last a second or two.
+#define TRAILER_SAMPLES_PER_SECOND 4.0
+
+// A new shot starts where consecutive samples differ more than this, in levels per channel.
+#define TRAILER_SHOT_CUT_DISTANCE 24
+
+// Shots shorter than this are flashes or titles, and longer ones are searched by their first samples only.
+#define TRAILER_MIN_SHOT_SAMPLES 3
+#define TRAILER_MAX_WINDOW_SAMPLES 16
+
+// Samples compared at once before the distance is checked against the best window, enough bytes for the
+// vector units to pay off and few enough to abandon a bad window early.
+#define TRAILER_ABANDON_BLOCK_SAMPLES 4
+
+// Shots darker than this, in mean level, match any dark scene and aren't searched.
+#define TRAILER_DARK_LEVEL 20
+
+// A shot is found when its best window is this close, in levels per channel.
+#define TRAILER_MATCH_DISTANCE 12.0
+
+/**
+ * A shot of a trailer and where it is in the feature.
+ */
+struct TrailerShot {
+    long long trailer_milliseconds = 0;
+    long long duration_milliseconds = 0;
+
+    // The time of the shot in the feature, or -1 when it isn't found or wasn't searched.
+    long long feature_milliseconds = -1;
+
+    // Mean distance of the best window, in levels per channel.
+    double distance = 0.0;
+};
+
+/**
+ * Splits a trailer in shots and finds every one of them in the feature. The shots are searched at once on
+ * the shared pool, each one sliding over the feature and skipping the windows whose total color is already
+ * too far off to beat the best one.
+ *
+ * @param trailer The fingerprint of the trailer.
+ * @param feature The fingerprint of the feature, whose rate the trailer is resampled to.
+ */
+std::vector<TrailerShot> LocateTrailerShots(const TimelineFingerprint& trailer, const TimelineFingerprint& feature);
+
+void PrintTrailerShots(const std::vector<TrailerShot>& shots);
+
+#endif // !TRAILER_SEARCH_H
@@ -18,215 +18,278 @@
 */
 
 #include "opencv2/opencv.hpp"
+#include <cmath>
 #include <iostream>
+#include <string>
+
+#include "AnalyzerBus.h"
+#include "ArtConfig.h"
+#include "ArtLayouts.h"
+#include "ArtVideo.h"
+#include "Concurrency.h"
+#include "DistributedRender.h"
+#include "MemoryGovernor.h"
+#include "MovieProxy.h"
+#include "MovieWallArt.h"
+#include "PipelineTrace.h"
+#include "QualityControl.h"
+#include "RangeRender.h"
+#include "RoiMask.h"
+#include "SharedDecode.h"
+#include "SparseAverage.h"
+#include "SpriteSheet.h"
+#include "SyntheticMovie.h"
+#include "ThreadPool.h"
+#include "TimelineFingerprint.h"
+#include "TrailerSearch.h"
 
 using namespace cv;
 using namespace std;
 
-#ifndef MOVIE_WALL_ART
-#define MOVIE_WALL_ART
+// TODO Implement series and TV Shows.
+int main(int argc, char** argv) {
+    ArtConfig config;
 
-#define ART_WIDTH 1920
-#define ART_HEIGHT 1080
+    if (!ParseArtConfig(argc, argv, config))
+        return 1;
 
-#define MOVIE_PATH "path/to/your/movie.mp4"
-#define ART_PATH "path/to/your/art.png"
+    if (!config.synthetic_path.empty())
+        return WriteSyntheticMovie(config.synthetic_path, config.synthetic) ? 0 : 1;
 
-#define ART_STYLE_CENTER_PIXEL 1
-#define ART_STYLE_AVERAGE_COLOR 2
-#define ART_STYLE_PIXEL_STRIP 3
+    if (!config.align_first_path.empty()) {
+        TimelineFingerprint first;
+        TimelineFingerprint second;
 
-#endif // !MOVIE_WALL_ART
+        if (!LoadTimelineFingerprint(config.align_first_path, first) || !LoadTimelineFingerprint(config.align_second_path, second))
+            return 1;
 
-/**
- * Get the average color of a frame.
- *
- * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
- */
-Vec3b GetFrameAverageColor(Mat& frame) {
-    int frame_h = frame.size[0];
-    int frame_w = frame.size[1];
-    int frame_dimension = frame_h * frame_w;
-
-    float pixel_color_b = 0.0f;
-    float pixel_color_g = 0.0f;
-    float pixel_color_r = 0.0f;
-
-    Vec3b average_color;
-
-    for (int w = 0; w < frame_w; w++) {
-        for (int h = 0; h < frame_h; h++) {
-            Vec3b& pixel = frame.at<Vec3b>(h, w);
-            pixel_color_b += pixel[0];
-            pixel_color_g += pixel[1];
-            pixel_color_r += pixel[2];
+        FingerprintAlignment alignment = AlignFingerprints(first, second);
+        PrintFingerprintAlignment(alignment);
+
+        for (double seconds : config.map_times) {
+            long long mapped = MapFingerprintTime(alignment, llround(seconds * 1000.0));
+            cout << seconds << "s -> " << (mapped < 0 ? string("not in the second movie") : to_string(mapped / 1000.0) + "s") << endl;
         }
+
+        return alignment.same_movie ? 0 : 2;
     }
 
-    average_color[0] = pixel_color_b / frame_dimension;
-    average_color[1] = pixel_color_g / frame_dimension;
-    average_color[2] = pixel_color_r / frame_dimension;
+    if (!config.locate_trailer_path.empty()) {
+        TimelineFingerprint trailer;
+        TimelineFingerprint feature;
 
-    return average_color;
-}
+        if (!LoadTimelineFingerprint(config.locate_trailer_path, trailer) || !LoadTimelineFingerprint(config.locate_feature_path, feature))
+            return 1;
 
-/**
- * Get the pixel strip of a frame.
- *
- * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
- */
-vector<Vec3b> GetFramePixelStrip(Mat& frame, int strip_size) {
-    vector<Vec3b> pixel_strip(strip_size);
-
-    int frame_h = frame.size[0];
-    int frame_w = frame.size[1];
-    int frame_dimension = frame_h * frame_w;
-
-    int sample_interval = frame_dimension / strip_size;
-    int strip_interval = sample_interval / strip_size;
-    int count = 0;
-    int strip_index = 0;
-
-    float g = 0.0f;
-    float b = 0.0f;
-    float r = 0.0f;
-
-    for (int x = 0; x < frame_w; x++) {
-        for (int y = 0; y < frame_h; y++) {
-            Vec3b pixel = frame.at<Vec3b>(y, x);
-
-            g += pixel[0];
-            b += pixel[1];
-            r += pixel[2];
-
-            count++;
-
-            if (count > sample_interval) {
-                g = g / count;
-                b = b / count;
-                r = r / count;
-
-                for (int i = 0; i < strip_interval; i++) {
-                    if (strip_index < strip_size) {
-                        pixel_strip[strip_index] = Vec3b(g, b, r);
-                        strip_index++;
-                    }
-                }
-
-                count = 0;
-                g = 0.0f;
-                b = 0.0f;
-                r = 0.0f;
-            }
-        }
+        int64 start = getTickCount();
+        vector<TrailerShot> shots = LocateTrailerShots(trailer, feature);
+        double seconds = (getTickCount() - start) / getTickFrequency();
+
+        PrintTrailerShots(shots);
+        cout << "Searched in " << seconds << " seconds." << endl;
+        return 0;
     }
 
-    return pixel_strip;
-}
+    bool concurrent_renders = !config.comparison_paths.empty() || !config.chapters_path.empty() || config.block_seconds > 0;
+    ConcurrencyPlan concurrency = PlanConcurrency(config.threads, config.render.decoder_threads, concurrent_renders);
+    ApplyConcurrencyPlan(concurrency);
+    PrintConcurrencyPlan(concurrency);
 
-/**
- * Create a column in the art image.
- *
- * @param frame A reference to the current frame of the movie that is going to be processed to create a column in the new image.
- * @param art_image A reference to the new image being created.
- * @param column_id The index of the column in the new image.
- * @param style The style to render the new image. It can be ART_STYLE_CENTER_PIXEL or ART_STYLE_AVERAGE_COLOR.
- */
-void CreateArtColumn(Mat& frame, Mat& art_image, int column_id, int style = ART_STYLE_AVERAGE_COLOR) {
-    try {
-        if (style == ART_STYLE_CENTER_PIXEL) {
-            int frame_h = frame.size[0];
-            int frame_w = frame.size[1];
-
-            Vec3b column_color;
-
-            column_color = frame.at<Vec3b>(frame_h / 2, frame_w / 2);
-            
-            for (int i = 0; i < ART_HEIGHT; i++)
-            {
-                Vec3b& pixel = art_image.at<Vec3b>(i, column_id);
-                pixel = column_color;
-            }
-        }
-        else  if (style == ART_STYLE_AVERAGE_COLOR) {
-            Vec3b column_color = GetFrameAverageColor(frame);
+    config.render.decoder_threads = concurrency.decoder_threads;
+    GetMemoryGovernor().SetBudget((long long)config.memory_budget_mb * 1024 * 1024);
 
-            for (int i = 0; i < ART_HEIGHT; i++)
-            {
-                Vec3b& pixel = art_image.at<Vec3b>(i, column_id);
-                pixel = column_color;
-            }
-        }
-        else if (style == ART_STYLE_PIXEL_STRIP) {
-            vector<Vec3b> column_colors = GetFramePixelStrip(frame, ART_HEIGHT);
+    int reduction_width = config.render.reduction_width;
 
-            for (int i = 0; i < ART_HEIGHT; i++)
-            {
-                Vec3b& pixel = art_image.at<Vec3b>(i, column_id);
-                pixel = column_colors[i];
-            }
-        }
-        else {
-            throw invalid_argument("Style not found.");
+    if (!config.trace_path.empty())
+        EnablePipelineTrace();
+
+    if (!config.fingerprint_path.empty()) {
+        TimelineFingerprint fingerprint;
+
+        if (!BuildTimelineFingerprint(config.movie_path, config.render, fingerprint, config.fingerprint_rate) || !SaveTimelineFingerprint(config.fingerprint_path, fingerprint))
+            return 1;
+
+        cout << "Fingerprint: " << fingerprint.GetSampleCount() << " samples written to " << config.fingerprint_path << endl;
+        return 0;
+    }
+
+    // Every range renders from the segments the ones before it left in the cache.
+    if (!config.ranges.empty()) {
+        RoiMask roi_mask = CreateMovieRoiMask(config.movie_path, config.roi_exclusions, config.detect_static_overlays, reduction_width);
+
+        ArtRenderOptions options = config.render;
+        options.roi_mask = roi_mask.IsEmpty() ? nullptr : &roi_mask;
+
+        RangeRenderer renderer(config.movie_path, config.art_height, options);
+
+        for (size_t i = 0; i < config.ranges.size(); i++) {
+            Mat range_image = Mat::zeros(config.art_height, config.art_width, CV_8UC3);
+            RangeRenderStats stats;
+
+            if (!renderer.Render(config.ranges[i].first, config.ranges[i].second, range_image, &stats))
+                return 1;
+
+            PrintRangeRenderStats(config.ranges[i].first, config.ranges[i].second, stats);
+            imwrite(config.ranges.size() == 1 ? config.art_path : GetRangeArtPath(config.art_path, (int)i), range_image);
         }
 
-        imshow("FRAME", frame);
-        imshow("RENDERING...", art_image);
-        waitKey(1);
+        return 0;
     }
-    catch (Exception e) {
-        cout << e.msg;
+
+    // A worker process of a distributed render only writes its fragment.
+    if (config.worker_first_column >= 0) {
+        RoiMask roi_mask = CreateMovieRoiMask(config.movie_path, config.roi_exclusions, config.detect_static_overlays, reduction_width);
+
+        ArtRenderOptions options = config.render;
+        options.roi_mask = roi_mask.IsEmpty() ? nullptr : &roi_mask;
+
+        RenderShard shard;
+        shard.first_column = config.worker_first_column;
+        shard.last_column = config.worker_last_column;
+
+        bool written = RenderShardFragment(config.movie_path, Size(config.art_width, config.art_height), shard, options, config.fragment_path);
+
+        // Every worker writes a trace of its own, next to its fragment.
+        if (!config.trace_path.empty())
+            WriteChromeTrace(config.fragment_path + ".trace.json");
+
+        return written ? 0 : 1;
     }
-}
 
-/**
- * Starts the process of creating a new art image.
- *
- * @param movie_path The path to the movie that is going to be processed to generate the new art.
- * @param art_image A reference to the new image being created.
- */
-void CreateMovieWallArt(string movie_path, Mat& art_image) {
-    VideoCapture cap(movie_path);
-
-    if (!cap.isOpened()) {
-        cout << "Error opening video file." << endl;
+    // The art stays allocated through the render, which would otherwise never find the budget to itself.
+    MemoryReservation art_reservation((long long)config.art_width * config.art_height * 3, nullptr, true);
+    Mat art_image = Mat::zeros(config.art_height, config.art_width, CV_8UC3);
+
+    ArtVideoSink video_sink(config.video_mode, config.video_size, config.video_fps, config.video_window);
+    video_sink.Open(config.video_path);
+
+    if (!config.comparison_paths.empty()) {
+        vector<RoiMask> roi_masks;
+
+        for (const string& path : config.comparison_paths)
+            roi_masks.push_back(CreateMovieRoiMask(path, config.roi_exclusions, config.detect_static_overlays, reduction_width));
+
+        CreateComparisonWallArt(config.comparison_paths, art_image, config.render, roi_masks);
     }
     else {
-        // Getting the first frame guarantees that the properties are read correctly.
-        Mat frame(cap.get(CAP_PROP_FRAME_HEIGHT), cap.get(CAP_PROP_FRAME_WIDTH), CV_8UC3, USAGE_ALLOCATE_HOST_MEMORY);
-        cap >> frame;
+        RoiMask roi_mask = CreateMovieRoiMask(config.movie_path, config.roi_exclusions, config.detect_static_overlays, reduction_width);
 
-        int frame_count = cap.get(CAP_PROP_FRAME_COUNT);
-        int sample_interval = frame_count / ART_WIDTH;
-        int current_frame = 0;
-        int column_id = 0;
+        MemoryJob memory_job(config.movie_path);
+        video_sink.SetMemoryJob(&memory_job);
 
-        while (current_frame < frame_count && column_id < ART_WIDTH)
-        {
-            cap.set(CAP_PROP_POS_FRAMES, current_frame);
+        ArtRenderOptions options = config.render;
+        options.roi_mask = roi_mask.IsEmpty() ? nullptr : &roi_mask;
+        options.memory_job = &memory_job;
 
-            cap >> frame;
+        SparseAverageLog sparse_log;
 
-            if (frame.empty())
-                break;
+        if (options.style == ART_STYLE_SPARSE_AVERAGE)
+            options.sparse_log = &sparse_log;
 
-            CreateArtColumn(frame, art_image, column_id, ART_STYLE_PIXEL_STRIP);
+        if (config.distributed_workers > 0 || !config.worker_commands.empty()) {
+            ProcessShardTransport transport(config.executable_path, config.arguments, config.worker_commands, config.distributed_workers);
 
-            current_frame += sample_interval;
-            column_id++;
+            DistributedRenderOptions distributed_options;
+            distributed_options.shard_columns = config.shard_columns;
+            distributed_options.max_attempts = config.shard_attempts;
+            distributed_options.fragment_prefix = config.fragment_dir.empty() ? config.art_path : config.fragment_dir + "/fragment";
+            distributed_options.keep_fragments = config.keep_fragments;
+
+            PrintDistributedRenderReport(RunDistributedRender(art_image, transport, distributed_options));
         }
+        else if (!config.extra_arts.empty()) {
+            // Every art of the movie is attached to one decode before it starts, so they all get every frame.
+            vector<Mat> extra_images;
+            vector<Mat*> art_images = { &art_image };
+            vector<ArtRenderOptions> art_options;
+
+            for (const ExtraArtConfig& extra_art : config.extra_arts)
+                extra_images.push_back(Mat::zeros(extra_art.art_height, extra_art.art_width, CV_8UC3));
+
+            options.preview = false;
+            art_options.push_back(options);
+
+            for (size_t i = 0; i < config.extra_arts.size(); i++) {
+                ArtRenderOptions extra_options = options;
+                extra_options.style = config.extra_arts[i].style;
+                extra_options.sparse_log = nullptr;
+
+                // The ROI mask is sized for the frames, not the art, so every art can use it.
+                art_images.push_back(&extra_images[i]);
+                art_options.push_back(extra_options);
+            }
+
+            RenderArtsWithSharedDecode(config.movie_path, art_images, art_options, video_sink.IsOpened() ? &video_sink : nullptr);
+
+            for (size_t i = 0; i < config.extra_arts.size(); i++)
+                imwrite(config.extra_arts[i].art_path, extra_images[i]);
+        }
+        else if (!config.chapters_path.empty() || config.block_seconds > 0)
+            CreateGridWallArt(config.movie_path, config.chapters_path, config.block_seconds, art_image, options);
+        else if (config.qc || !config.sprites.vtt_path.empty()) {
+            // The art, the checks and the thumbnails all look at the frames of a single decode.
+            AnalyzerBus bus;
+            ArtFrameAnalyzer art_analyzer(art_image, options, video_sink.IsOpened() ? &video_sink : nullptr);
+            BlackFrameAnalyzer black_analyzer(config.qc_interval);
+            FreezeFrameAnalyzer freeze_analyzer(config.qc_interval);
+            bool art_on_bus = ArtFrameAnalyzer::SupportsStyle(options.style);
+            SpriteSheetAnalyzer sprite_analyzer(config.sprites, art_on_bus ? art_image.cols : 0);
+
+            if (art_on_bus)
+                bus.Add(&art_analyzer);
+            else
+                CreateMovieWallArt(config.movie_path, art_image, options, video_sink.IsOpened() ? &video_sink : nullptr);
+
+            if (config.qc) {
+                bus.Add(&black_analyzer);
+                bus.Add(&freeze_analyzer);
+            }
+
+            if (!config.sprites.vtt_path.empty())
+                bus.Add(&sprite_analyzer);
 
-        cap.release();
-        waitKey(0);
+            if (bus.Run(config.movie_path, options) && config.qc) {
+                black_analyzer.Report();
+                freeze_analyzer.Report();
+            }
+        }
+        else if (config.proxy && !video_sink.IsOpened() && RenderArtFromProxy(config.movie_path, art_image, options))
+            cout << "Rendered from the proxy of " << config.movie_path << endl;
+        else {
+            // Renders without a proxy write one for the next.
+            MovieProxyWriter proxy_writer;
+
+            if (config.proxy)
+                options.proxy_writer = &proxy_writer;
+
+            CreateMovieWallArt(config.movie_path, art_image, options, video_sink.IsOpened() ? &video_sink : nullptr);
+            options.proxy_writer = nullptr;
+        }
+
+        if (config.proxy_validate)
+            PrintProxyValidationReport(ValidateMovieProxy(config.movie_path, config.art_height, options, MOVIE_PROXY_VALIDATION_SAMPLES));
+
+        // The queued video frames are still charged to the job until the encoder is done with them.
+        video_sink.Close();
+        video_sink.SetMemoryJob(nullptr);
+
+        memory_job.Report();
+
+        if (options.sparse_log != nullptr) {
+            sparse_log.Report();
+
+            if (!config.sparse_errors_path.empty())
+                sparse_log.WriteCsv(config.sparse_errors_path);
+        }
     }
-}
 
-// TODO Implement series and TV Shows.
-int main(void) {
-    Mat art_image(ART_HEIGHT, ART_WIDTH, CV_8UC3, USAGE_ALLOCATE_HOST_MEMORY);
+    imwrite(config.art_path, art_image);
+    video_sink.Close();
+
+    if (!config.trace_path.empty())
+        WriteChromeTrace(config.trace_path);
 
-    CreateMovieWallArt(MOVIE_PATH, art_image);
-    imwrite(ART_PATH, art_image);
+    GetMemoryGovernor().Report();
 
     destroyAllWindows();
 
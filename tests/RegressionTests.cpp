@@ -0,0 +1,1832 @@
+/**
+* Movie Wall Art
+* Create a beautiful image based on a movie!
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* This project uses OpenCV - https://opencv.org/
+*
+* Written by Roger Paffrath, May 2023
+*/
+
+#include "opencv2/opencv.hpp"
+#include "opencv2/core/utils/filesystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnalyzerBus.h"
+#include "ArtDamage.h"
+#include "ArtLayouts.h"
+#include "Concurrency.h"
+#include "DcAverage.h"
+#include "DistributedRender.h"
+#include "GopIndex.h"
+#include "MemoryGovernor.h"
+#include "MotionVectors.h"
+#include "MovieProxy.h"
+#include "MovieWallArt.h"
+#include "PipelineTrace.h"
+#include "QualityControl.h"
+#include "RangeRender.h"
+#include "SharedDecode.h"
+#include "SparseAverage.h"
+#include "SpriteSheet.h"
+#include "SyntheticMovie.h"
+#include "TimelineFingerprint.h"
+#include "TrailerSearch.h"
+
+using namespace cv;
+using namespace std;
+
+// How much slower than the stored baseline a case may run before it fails.
+#define THROUGHPUT_TOLERANCE_PERCENT 15
+
+// Each case is timed this many times and the fastest run is kept, to keep the timings steady.
+#define TIMING_RUNS 3
+
+#define SYNTHETIC_FRAME_COUNT 240
+#define SYNTHETIC_FRAME_WIDTH 480
+#define SYNTHETIC_FRAME_HEIGHT 270
+#define SYNTHETIC_FPS 24
+
+#define REGRESSION_ART_WIDTH 96
+#define REGRESSION_ART_HEIGHT 54
+
+// Frames compared between the DC coefficients and full decoding, and how far apart their average colors may be, in levels.
+#define DC_VALIDATION_FRAMES 48
+#define DC_MAX_MEAN_ERROR 2.0
+#define DC_MAX_ERROR 8.0
+
+// Frames 48 pixels wide have fewer pixels than the regression art is high squared. The strip of a column has
+// to average to the average color of its frame, within rounding, in levels.
+#define SMALL_FRAME_REDUCTION_WIDTH 48
+#define SMALL_FRAME_STRIP_TOLERANCE 2.0
+
+// 4K frames reduced both ways by the parallel reduction case, which have to give exactly the same colors.
+#define PARALLEL_REDUCTION_FRAMES 16
+
+// How far the sparse average estimates of the synthetic frames may be from their exact averages, in levels.
+#define SPARSE_MAX_MEAN_ERROR 1.0
+#define SPARSE_MAX_ERROR 3.0
+
+// Memory held and waited for by the governor case, and how long it waits before calling a reservation stuck.
+#define GOVERNOR_CASE_BYTES (16LL * 1024 * 1024)
+#define GOVERNOR_CASE_BLOCKED_MS 200
+#define GOVERNOR_CASE_TIMEOUT_SECONDS 60
+
+// Frames of the mp4v movie of the motion vector case, which moves its shapes between keyframes.
+#define MOTION_CASE_SECONDS 4.0
+
+// Length of the movie of the range case, longer than two segments of level 0, and the sample interval of the
+// level its whole movie render is derived at.
+#define RANGE_CASE_SECONDS 27.0
+#define RANGE_CASE_COARSE_INTERVAL 8
+
+// Samples of the synthetic fingerprint of the alignment case, the scene inserted into its extended cut, and
+// how far off a mapped time may be, in milliseconds.
+#define FINGERPRINT_CASE_SAMPLES 3600
+#define FINGERPRINT_CASE_INSERT_AT 1800
+#define FINGERPRINT_CASE_INSERT_SAMPLES 300
+#define FINGERPRINT_CASE_MAX_ERROR_MS 1000
+
+// How far the bands of the decoded regression movie may be from the bands of its synthetic frames, in levels.
+#define FINGERPRINT_BANDS_CASE_TOLERANCE 8
+
+// Samples of the synthetic feature of the trailer case, two hours at the trailer rate, and shots of its trailer.
+#define TRAILER_CASE_FEATURE_SAMPLES (int)(2 * 3600 * TRAILER_SAMPLES_PER_SECOND)
+#define TRAILER_CASE_SHOTS 40
+
+// Loopback workers and columns per shard of the distributed render case.
+#define DISTRIBUTED_WORKERS 3
+#define DISTRIBUTED_SHARD_COLUMNS 10
+
+// How far the columns of an art rendered from the proxy may be from the ones rendered from the movie, in levels.
+#define PROXY_MAX_MEAN_ERROR 4.0
+#define PROXY_MAX_ERROR 48.0
+
+struct RegressionStyle {
+    int style;
+    string name;
+
+    // Energy styles go through resize and color conversion, whose rounding may change with the SIMD path of the CPU.
+    int exact_tolerance;
+
+    // Reads the side data of the codec instead of the frames, so it has no in-memory case and needs a build
+    // that reads motion vectors.
+    bool needs_codec;
+};
+
+struct RegressionOptions {
+    string data_dir;
+    bool update_golden;
+    bool update_baseline;
+};
+
+struct RegressionResult {
+    string name;
+    bool passed;
+    double throughput;
+    string message;
+
+    // What the throughput counts per second.
+    string unit = "columns/s";
+
+    // Nothing to compare with yet, like a golden image recorded by this run.
+    bool skipped = false;
+};
+
+static const vector<RegressionStyle> regression_styles = {
+    { ART_STYLE_CENTER_PIXEL, "center_pixel", 0, false },
+    { ART_STYLE_AVERAGE_COLOR, "average_color", 0, false },
+    { ART_STYLE_PIXEL_STRIP, "pixel_strip", 0, false },
+    { ART_STYLE_EDGE_ENERGY, "edge_energy", 2, false },
+    { ART_STYLE_DETAIL_DENSITY, "detail_density", 2, false },
+    { ART_STYLE_MOTION_ENERGY, "motion_energy", 2, false },
+    { ART_STYLE_SPARSE_AVERAGE, "sparse_average", 0, false },
+    { ART_STYLE_MOTION_VECTORS, "motion_vectors", 0, true },
+};
+
+/**
+ * The directory of this file, where the golden images and baselines are kept.
+ */
+static string GetDefaultDataDir() {
+    string file = __FILE__;
+    size_t slash = file.find_last_of("/\\");
+
+    return slash == string::npos ? string(".") : file.substr(0, slash);
+}
+
+static string GetHostName() {
+    const char* host = getenv("COMPUTERNAME");
+
+    if (host == nullptr)
+        host = getenv("HOSTNAME");
+
+    return host != nullptr ? string(host) : string("unknown-host");
+}
+
+/**
+ * A frame of the synthetic movie. Only integer math is used so it is the same on every machine:
+ * a gradient background that changes hue every 40 frames, with a square moving over it.
+ */
+static Mat CreateSyntheticFrame(int index, int frame_w, int frame_h) {
+    Mat frame(frame_h, frame_w, CV_8UC3);
+
+    int scene = index / 40;
+    int square_size = frame_h / 4;
+    int square_x = (index * 7) % (frame_w - square_size);
+    int square_y = (index * 3) % (frame_h - square_size);
+
+    for (int y = 0; y < frame_h; y++) {
+        Vec3b* row = frame.ptr<Vec3b>(y);
+
+        for (int x = 0; x < frame_w; x++) {
+            row[x] = Vec3b((uchar)((x * 255 / frame_w + scene * 50) & 255),
+                           (uchar)((y * 255 / frame_h + scene * 90) & 255),
+                           (uchar)((scene * 70 + (x ^ y)) & 255));
+        }
+    }
+
+    frame(Rect(square_x, square_y, square_size, square_size)).setTo(Scalar(255 - scene * 20, 255, scene * 30));
+
+    return frame;
+}
+
+/**
+ * A short movie from the synthetic movie generator, with cuts, fades and letterbox bars.
+ */
+static SyntheticMovieConfig GetRegressionMovieConfig() {
+    SyntheticMovieConfig config;
+    config.duration_seconds = (double)SYNTHETIC_FRAME_COUNT / SYNTHETIC_FPS;
+    config.frame_size = Size(SYNTHETIC_FRAME_WIDTH, SYNTHETIC_FRAME_HEIGHT);
+    config.fps = SYNTHETIC_FPS;
+    config.fourcc = "MJPG";
+    config.mean_scene_seconds = 2.0;
+    config.fade_share = 0.5;
+    config.letterbox_ratio = 2.39;
+    config.seed = 7;
+
+    return config;
+}
+
+/**
+ * Writes the regression movie to the output directory.
+ */
+static string WriteRegressionMovie(const string& output_dir) {
+    string movie_path = output_dir + "/synthetic.avi";
+    WriteSyntheticMovie(movie_path, GetRegressionMovieConfig());
+
+    return movie_path;
+}
+
+/**
+ * The synthetic frames the in-memory cases sample, created once so the timings only cover the reducers.
+ */
+static const vector<Mat>& GetSyntheticFrames() {
+    static vector<Mat> frames;
+
+    if (frames.empty()) {
+        for (int i = 0; i <= SYNTHETIC_FRAME_COUNT; i++)
+            frames.push_back(CreateSyntheticFrame(i, SYNTHETIC_FRAME_WIDTH, SYNTHETIC_FRAME_HEIGHT));
+    }
+
+    return frames;
+}
+
+/**
+ * Renders the synthetic frames straight from memory, so the reducers are checked without any codec involved.
+ */
+static void RenderSyntheticFrames(Mat& art_image, int style) {
+    const vector<Mat>& frames = GetSyntheticFrames();
+    ArtColumnContext context;
+    int sample_interval = SYNTHETIC_FRAME_COUNT / art_image.cols;
+
+    for (int column_id = 0; column_id < art_image.cols; column_id++) {
+        int index = column_id * sample_interval;
+        Mat frame = frames[index];
+
+        if (ArtStyleNeedsFollowingFrame(style))
+            context.following_frame = frames[index + 1];
+
+        CreateArtColumn(frame, art_image, column_id, style, false, &context);
+    }
+}
+
+static map<string, double> ReadBaseline(const string& baseline_path) {
+    map<string, double> baseline;
+    ifstream file(baseline_path);
+    string name;
+    double throughput;
+
+    while (file >> name >> throughput)
+        baseline[name] = throughput;
+
+    return baseline;
+}
+
+static void WriteBaseline(const string& baseline_path, const vector<RegressionResult>& results) {
+    ofstream file(baseline_path);
+
+    for (const RegressionResult& result : results)
+        file << result.name << " " << result.throughput << endl;
+}
+
+/**
+ * Compares a rendered art image with its golden image.
+ *
+ * @return An empty string when they match, otherwise what is wrong.
+ */
+static string CompareWithGolden(const Mat& art_image, const string& golden_path, int tolerance) {
+    Mat golden = imread(golden_path, IMREAD_COLOR);
+
+    if (golden.empty())
+        return "missing golden image " + golden_path;
+
+    if (golden.size() != art_image.size())
+        return "size differs from the golden image";
+
+    Mat difference;
+    absdiff(art_image, golden, difference);
+
+    double max_difference = 0.0;
+    minMaxLoc(difference.reshape(1), nullptr, &max_difference);
+
+    if (max_difference > tolerance) {
+        ostringstream message;
+        message << "differs from the golden image by up to " << max_difference << " (tolerance " << tolerance << ")";
+        return message.str();
+    }
+
+    return "";
+}
+
+/**
+ * A case that can't run in this build or on this machine.
+ */
+static RegressionResult SkipCase(const string& name, const string& reason) {
+    RegressionResult result;
+    result.name = name;
+    result.passed = true;
+    result.throughput = 0.0;
+    result.message = reason;
+    result.skipped = true;
+
+    return result;
+}
+
+/**
+ * Renders one case a few times, checks the image against its golden and keeps the best throughput in columns per second.
+ * Goldens are only written by --update-golden, so a broken render never becomes the reference by itself.
+ *
+ * @param golden_required Whether the golden is committed, so a missing one fails the case instead of skipping it.
+ */
+template<typename Render>
+static RegressionResult RunCase(const string& name, int tolerance, bool golden_required, Render render, const RegressionOptions& options) {
+    RegressionResult result;
+    result.name = name;
+    result.passed = true;
+    result.throughput = 0.0;
+
+    Mat art_image;
+
+    for (int run = 0; run < TIMING_RUNS; run++) {
+        art_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+
+        int64 start = getTickCount();
+        render(art_image);
+        double seconds = (getTickCount() - start) / getTickFrequency();
+
+        result.throughput = max(result.throughput, art_image.cols / max(seconds, 1e-9));
+    }
+
+    string golden_path = options.data_dir + "/golden/" + name + ".png";
+
+    if (options.update_golden) {
+        imwrite(golden_path, art_image);
+        return result;
+    }
+
+    // The goldens of decoded movies depend on the decoder, so they are recorded per machine and may be missing.
+    if (!ifstream(golden_path).good()) {
+        result.message = "no golden image " + golden_path + ", record it with --update-golden";
+        result.passed = !golden_required;
+        result.skipped = !golden_required;
+        imwrite(options.data_dir + "/output/" + name + ".png", art_image);
+
+        return result;
+    }
+
+    result.message = CompareWithGolden(art_image, golden_path, tolerance);
+
+    if (!result.message.empty()) {
+        result.passed = false;
+        imwrite(options.data_dir + "/output/" + name + ".png", art_image);
+    }
+
+    return result;
+}
+
+/**
+ * Checks the experimental DC coefficient average against full decoding on the MJPEG regression movie.
+ * Its throughput is the frames per second read from the DC coefficients.
+ */
+static RegressionResult ValidateDcCase(const string& movie_path) {
+    RegressionResult result;
+    result.name = "dc_average_validation";
+    result.unit = "frames/s";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    DcValidationReport report = ValidateDcAverage(movie_path, DC_VALIDATION_FRAMES);
+    PrintDcValidationReport(report);
+
+    ostringstream message;
+
+    if (report.frame_count == 0) {
+        message << "the movie could not be read as DC frames";
+        result.passed = false;
+    }
+    else {
+        result.throughput = report.frame_count / max(report.dc_seconds, 1e-9);
+
+        message << "mean error " << report.mean_error << ", max error " << report.max_error << ", "
+                << report.full_seconds / max(report.dc_seconds, 1e-9) << "x faster than full decoding";
+
+        if (report.mean_error > DC_MAX_MEAN_ERROR || report.max_error > DC_MAX_ERROR)
+            result.passed = false;
+    }
+
+    result.message = message.str();
+
+    return result;
+}
+
+/**
+ * Renders the pixel strip and the average color of the regression movie from frames smaller than the art is
+ * high squared, reduced or read from the DC coefficients, and checks every strip column averages to the color of its frame instead of staying black.
+ * The throughput is of the pixel strip render, in columns per second.
+ */
+static RegressionResult ValidateSmallFrameStripCase(const string& name, const string& movie_path, const ArtRenderOptions& options) {
+    RegressionResult result;
+    result.name = name;
+    result.passed = true;
+
+    ArtRenderOptions strip_options = options;
+    strip_options.style = ART_STYLE_PIXEL_STRIP;
+    strip_options.preview = false;
+
+    ArtRenderOptions average_options = strip_options;
+    average_options.style = ART_STYLE_AVERAGE_COLOR;
+
+    Mat strip_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    int64 start = getTickCount();
+    RenderArtColumns(movie_path, strip_image, 0, strip_image.cols, strip_options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = strip_image.cols / max(seconds, 1e-9);
+
+    Mat average_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    RenderArtColumns(movie_path, average_image, 0, average_image.cols, average_options);
+
+    // Every color of the strip covers as many pixels, give or take one, so together they average to the frame.
+    Mat strip_means;
+    Mat average_means;
+    reduce(strip_image, strip_means, 0, REDUCE_AVG, CV_32F);
+    reduce(average_image, average_means, 0, REDUCE_AVG, CV_32F);
+
+    Mat difference;
+    absdiff(strip_means, average_means, difference);
+    double max_error = norm(difference.reshape(1), NORM_INF);
+
+    ostringstream message;
+    message << "max error " << max_error << " between the mean of a strip column and its average color";
+    result.message = message.str();
+
+    if (max_error > SMALL_FRAME_STRIP_TOLERANCE)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Reduces 4K frames on one thread and split among the shared pool, and checks both give the same columns.
+ * The throughput is of the parallel reduction, in frames per second.
+ */
+static RegressionResult ValidateParallelReductionCase() {
+    RegressionResult result;
+    result.name = "parallel_reduction";
+    result.unit = "frames/s";
+    result.passed = true;
+
+    ThreadPool& pool = GetSharedThreadPool();
+    double serial_seconds = 0.0;
+    double parallel_seconds = 0.0;
+    int strip_mismatches = 0;
+    int max_error = 0;
+
+    for (int i = 0; i < PARALLEL_REDUCTION_FRAMES; i++) {
+        Mat frame = CreateSyntheticFrame(i * 15, 3840, 2160);
+
+        int64 start = getTickCount();
+        Vec3b serial_color = GetFrameAverageColor(frame);
+        vector<Vec3b> serial_strip = GetFramePixelStrip(frame, 2160);
+        serial_seconds += (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        Vec3b parallel_color = GetFrameAverageColor(frame, nullptr, &pool);
+        vector<Vec3b> parallel_strip = GetFramePixelStrip(frame, 2160, nullptr, &pool);
+        parallel_seconds += (getTickCount() - start) / getTickFrequency();
+
+        for (int c = 0; c < 3; c++)
+            max_error = max(max_error, abs((int)serial_color[c] - (int)parallel_color[c]));
+
+        if (serial_strip != parallel_strip)
+            strip_mismatches++;
+    }
+
+    result.throughput = PARALLEL_REDUCTION_FRAMES / max(parallel_seconds, 1e-9);
+
+    ostringstream message;
+    message << "average color max error " << max_error << ", " << strip_mismatches << " pixel strips differ, "
+            << serial_seconds / max(parallel_seconds, 1e-9) << "x faster on " << pool.GetThreadCount() << " workers";
+    result.message = message.str();
+
+    if (max_error > 0 || strip_mismatches > 0)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * A loopback transport whose first attempt at the second shard fails, like a worker host going down.
+ */
+class FlakyShardTransport : public LoopbackShardTransport {
+public:
+    FlakyShardTransport(const string& movie_path, Size art_size, const ArtRenderOptions& options)
+        : LoopbackShardTransport(movie_path, art_size, options, DISTRIBUTED_WORKERS), failed(false) {
+    }
+
+    bool RunShard(int worker, const RenderShard& shard, const string& fragment_path) override {
+        if (shard.index == 1 && shard.attempts == 1) {
+            failed = true;
+            return false;
+        }
+
+        return LoopbackShardTransport::RunShard(worker, shard, fragment_path);
+    }
+
+    bool failed;
+};
+
+/**
+ * Renders the regression movie in shards on loopback workers, with a failing shard to retry, and checks
+ * the merged image is the same as rendering it in one go. The throughput is of the distributed render.
+ */
+static RegressionResult ValidateDistributedCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "distributed_loopback";
+    result.passed = true;
+
+    ArtRenderOptions render_options;
+    render_options.preview = false;
+
+    Mat direct_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    RenderArtColumns(movie_path, direct_image, 0, direct_image.cols, render_options);
+
+    FlakyShardTransport transport(movie_path, direct_image.size(), render_options);
+
+    DistributedRenderOptions distributed_options;
+    distributed_options.shard_columns = DISTRIBUTED_SHARD_COLUMNS;
+    distributed_options.fragment_prefix = output_dir + "/distributed";
+
+    Mat distributed_image = Mat::zeros(direct_image.size(), CV_8UC3);
+    DistributedRenderReport report = RunDistributedRender(distributed_image, transport, distributed_options);
+    PrintDistributedRenderReport(report);
+
+    result.throughput = distributed_image.cols / max(report.wall_seconds, 1e-9);
+
+    Mat difference;
+    absdiff(direct_image, distributed_image, difference);
+    difference = difference.reshape(1);
+    int different_pixels = countNonZero(difference);
+
+    ostringstream message;
+    message << report.shard_count << " shards, " << report.retried_shards << " retried, " << report.failed_shards << " failed, "
+            << different_pixels << " values differ from the direct render";
+    result.message = message.str();
+
+    if (!transport.failed || report.retried_shards != 1 || report.failed_shards > 0 || different_pixels > 0)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Renders the regression movie at two widths and in two styles at once from a shared decode they are both
+ * attached to before it starts, and checks both arts are the same as rendered on their own. The throughput counts the columns of both arts.
+ */
+static RegressionResult ValidateSharedDecodeCase(const string& movie_path) {
+    RegressionResult result;
+    result.name = "shared_decode";
+    result.passed = true;
+
+    ArtRenderOptions strip_options;
+    strip_options.style = ART_STYLE_PIXEL_STRIP;
+    strip_options.preview = false;
+
+    ArtRenderOptions average_options = strip_options;
+    average_options.style = ART_STYLE_AVERAGE_COLOR;
+
+    Mat strip_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    Mat average_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH / 2, CV_8UC3);
+
+    int64 start = getTickCount();
+
+    RenderArtsWithSharedDecode(movie_path, { &strip_image, &average_image }, { strip_options, average_options });
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = (strip_image.cols + average_image.cols) / max(seconds, 1e-9);
+
+    Mat strip_direct = Mat::zeros(strip_image.size(), CV_8UC3);
+    Mat average_direct = Mat::zeros(average_image.size(), CV_8UC3);
+    RenderArtColumns(movie_path, strip_direct, 0, strip_direct.cols, strip_options);
+    RenderArtColumns(movie_path, average_direct, 0, average_direct.cols, average_options);
+
+    // The shared decode reads forward where the direct renders seek, which is not always bit exact for MJPEG.
+    Mat strip_difference;
+    Mat average_difference;
+    absdiff(strip_image, strip_direct, strip_difference);
+    absdiff(average_image, average_direct, average_difference);
+
+    double strip_error = norm(strip_difference.reshape(1), NORM_INF);
+    double average_error = norm(average_difference.reshape(1), NORM_INF);
+
+    ostringstream message;
+    message << "max error " << strip_error << " for the pixel strip, " << average_error << " for the average color";
+    result.message = message.str();
+
+    if (strip_error > 3 || average_error > 3)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Renders the regression movie while writing its proxy, renders it again from the proxy, and checks how
+ * far the two arts are apart. The throughput is of the render from the proxy, in columns per second.
+ */
+static RegressionResult ValidateProxyCase(const string& movie_path) {
+    RegressionResult result;
+    result.name = "proxy";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_PIXEL_STRIP;
+    options.preview = false;
+
+    MovieProxyWriter proxy_writer;
+    options.proxy_writer = &proxy_writer;
+
+    Mat full_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    CreateMovieWallArt(movie_path, full_image, options);
+    options.proxy_writer = nullptr;
+
+    Mat proxy_image = Mat::zeros(full_image.size(), CV_8UC3);
+    int64 start = getTickCount();
+
+    if (!RenderArtFromProxy(movie_path, proxy_image, options)) {
+        result.passed = false;
+        result.message = "no proxy was written";
+        return result;
+    }
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = proxy_image.cols / max(seconds, 1e-9);
+
+    Mat difference;
+    absdiff(full_image, proxy_image, difference);
+
+    Scalar channel_error = mean(difference);
+    double mean_error = (channel_error[0] + channel_error[1] + channel_error[2]) / 3;
+    double max_error = norm(difference.reshape(1), NORM_INF);
+
+    ostringstream message;
+    message << "mean error " << mean_error << ", max error " << max_error;
+    result.message = message.str();
+
+    if (mean_error > PROXY_MAX_MEAN_ERROR || max_error > PROXY_MAX_ERROR)
+        result.passed = false;
+
+    remove(GetMovieProxyPath(movie_path).c_str());
+    remove(GetMovieProxyIndexPath(movie_path).c_str());
+
+    return result;
+}
+
+/**
+ * Renders the regression movie on the analyzer bus alongside the quality control analyzers, and checks the
+ * art is the same as rendered on its own. The quality control checks every frame, so the throughput is in
+ * decoded frames per second.
+ */
+static RegressionResult ValidateAnalyzerBusCase(const string& movie_path) {
+    RegressionResult result;
+    result.name = "analyzer_bus";
+    result.unit = "frames/s";
+    result.passed = true;
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_PIXEL_STRIP;
+    options.preview = false;
+
+    Mat bus_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+
+    AnalyzerBus bus;
+    ArtFrameAnalyzer art_analyzer(bus_image, options);
+    BlackFrameAnalyzer black_analyzer;
+    FreezeFrameAnalyzer freeze_analyzer;
+    bus.Add(&art_analyzer);
+    bus.Add(&black_analyzer);
+    bus.Add(&freeze_analyzer);
+
+    int64 start = getTickCount();
+
+    if (!bus.Run(movie_path, options)) {
+        result.passed = false;
+        result.throughput = 0.0;
+        result.message = "the bus could not run";
+        return result;
+    }
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = SYNTHETIC_FRAME_COUNT / max(seconds, 1e-9);
+
+    Mat direct_image = Mat::zeros(bus_image.size(), CV_8UC3);
+    RenderArtColumns(movie_path, direct_image, 0, direct_image.cols, options);
+
+    // The bus reads forward where the direct render seeks, which is not always bit exact for MJPEG.
+    Mat difference;
+    absdiff(bus_image, direct_image, difference);
+    double max_error = norm(difference.reshape(1), NORM_INF);
+
+    ostringstream message;
+    message << "max error " << max_error << ", " << black_analyzer.GetRanges().size() << " black and "
+            << freeze_analyzer.GetRanges().size() << " frozen runs";
+    result.message = message.str();
+
+    if (max_error > 3)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Writes thumbnail sprites of the regression movie alongside its art, and checks the cues and the atlas
+ * agree. The throughput is in thumbnails per second.
+ */
+static RegressionResult ValidateSpriteSheetCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "sprite_sheet";
+    result.unit = "thumbnails/s";
+    result.passed = true;
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_AVERAGE_COLOR;
+    options.preview = false;
+
+    SpriteSheetOptions sprite_options;
+    sprite_options.vtt_path = output_dir + "/sprites.vtt";
+    sprite_options.seconds = 1.0;
+
+    Mat art_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+
+    AnalyzerBus bus;
+    ArtFrameAnalyzer art_analyzer(art_image, options);
+    SpriteSheetAnalyzer sprite_analyzer(sprite_options, art_image.cols);
+    bus.Add(&art_analyzer);
+    bus.Add(&sprite_analyzer);
+
+    int64 start = getTickCount();
+    bus.Run(movie_path, options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+
+    int thumbnail_count = sprite_analyzer.GetThumbnailCount();
+    result.throughput = thumbnail_count / max(seconds, 1e-9);
+
+    ifstream vtt(sprite_options.vtt_path);
+    string line;
+    int cue_count = 0;
+
+    while (getline(vtt, line)) {
+        if (line.find(" --> ") != string::npos)
+            cue_count++;
+    }
+
+    // The regression movie is 10 seconds long, so it has a thumbnail every second, all on one row of the first atlas.
+    int expected_count = SYNTHETIC_FRAME_COUNT / SYNTHETIC_FPS;
+    Mat atlas = imread(GetSpriteAtlasPath(sprite_options.vtt_path, 0));
+
+    ostringstream message;
+    message << thumbnail_count << " thumbnails, " << cue_count << " cues, atlas of " << atlas.cols << "x" << atlas.rows;
+    result.message = message.str();
+
+    if (thumbnail_count != expected_count || cue_count != expected_count || atlas.empty()
+        || atlas.rows != SYNTHETIC_FRAME_HEIGHT * sprite_options.thumbnail_width / SYNTHETIC_FRAME_WIDTH)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Estimates the average color of the synthetic frames from samples, and compares it with the exact average
+ * and with the error bound of the estimate. A masked estimate that stops before its first check has to get a
+ * bound as well. The throughput is of the estimator, in frames per second.
+ */
+static RegressionResult ValidateSparseAverageCase() {
+    RegressionResult result;
+    result.name = "sparse_average";
+    result.unit = "frames/s";
+    result.passed = true;
+
+    const vector<Mat>& frames = GetSyntheticFrames();
+    vector<SparseAverageEstimate> estimates(frames.size());
+
+    int64 start = getTickCount();
+
+    for (size_t i = 0; i < frames.size(); i++)
+        estimates[i] = EstimateFrameAverageColor(frames[i]);
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = frames.size() / max(seconds, 1e-9);
+
+    double error_sum = 0.0;
+    double max_error = 0.0;
+    int outside_bound = 0;
+    long long samples = 0;
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        Mat frame = frames[i];
+        Vec3b exact = GetFrameAverageColor(frame);
+        double frame_error = 0.0;
+
+        for (int c = 0; c < 3; c++) {
+            double error = abs((int)exact[c] - (int)estimates[i].color[c]);
+            error_sum += error;
+            frame_error = max(frame_error, error);
+        }
+
+        // Both averages are rounded to whole levels.
+        if (frame_error > estimates[i].error_bound + 1.0)
+            outside_bound++;
+
+        max_error = max(max_error, frame_error);
+        samples += estimates[i].sample_count;
+    }
+
+    double mean_error = error_sum / (frames.size() * 3);
+
+    ostringstream message;
+    message << samples / (long long)frames.size() << " samples per frame, mean error " << mean_error << ", max error " << max_error
+            << ", " << outside_bound << " frames outside their bound";
+    result.message = message.str();
+
+    if (mean_error > SPARSE_MAX_MEAN_ERROR || max_error > SPARSE_MAX_ERROR) {
+        result.passed = false;
+        return result;
+    }
+
+    // A mask of too many pixels to read whole, but too small a share of a large frame for the pattern to reach
+    // the first check, still gets a bound.
+    Mat noise_frame(1080, 1920, CV_8UC3);
+    randu(noise_frame, Scalar::all(0), Scalar::all(256));
+
+    Mat keep_mask = Mat::zeros(noise_frame.size(), CV_8U);
+    keep_mask(Rect(0, 0, 200, 200)).setTo(255);
+    RoiMask roi_mask(keep_mask);
+
+    SparseAverageEstimate masked_estimate = EstimateFrameAverageColor(noise_frame, &roi_mask);
+
+    if (masked_estimate.sample_count >= SPARSE_AVERAGE_MIN_SAMPLES || masked_estimate.sample_count < 2 || masked_estimate.error_bound <= 0.0) {
+        result.passed = false;
+        result.message += ", a masked estimate of " + to_string(masked_estimate.sample_count) + " samples has no error bound";
+    }
+
+    return result;
+}
+
+/**
+ * Indexes the keyframes of the regression movie, an MJPEG movie whose every frame is one, checks the index
+ * survives a save and load and goes stale with the movie size, and that GOP batched sampling renders the same
+ * art as seeking. The throughput is of the GOP batched render, in columns per second.
+ */
+static RegressionResult ValidateGopIndexCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "gop_index";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    GopIndex index;
+
+    // Without the FFmpeg backend there are no packets to read, and GOP sampling seeks as before.
+    if (!index.Build(movie_path)) {
+        result.message = "keyframes can't be read without the FFmpeg backend of OpenCV";
+        return result;
+    }
+
+    int misplaced_keyframes = 0;
+
+    for (int frame = 0; frame < index.GetFrameCount(); frame++) {
+        if (index.GetKeyframeBefore(frame) != frame)
+            misplaced_keyframes++;
+    }
+
+    string index_path = output_dir + "/synthetic.test.gopidx";
+    GopIndex loaded;
+    GopIndex stale;
+    bool round_trip = index.Save(index_path, 1000) && loaded.Load(index_path, 1000) && loaded.GetKeyframeCount() == index.GetKeyframeCount();
+    bool stale_rejected = !stale.Load(index_path, 1001);
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_AVERAGE_COLOR;
+    options.preview = false;
+
+    Mat seek_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    RenderArtColumns(movie_path, seek_image, 0, seek_image.cols, options);
+
+    options.sampling = ART_SAMPLING_GOP;
+    Mat gop_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    int64 start = getTickCount();
+    RenderArtColumns(movie_path, gop_image, 0, gop_image.cols, options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = gop_image.cols / max(seconds, 1e-9);
+
+    Mat difference;
+    absdiff(seek_image, gop_image, difference);
+    double max_error = norm(difference.reshape(1), NORM_INF);
+
+    ostringstream message;
+    message << index.GetKeyframeCount() << " keyframes in " << index.GetFrameCount() << " frames, " << misplaced_keyframes
+            << " misplaced, " << (round_trip ? "saved and loaded" : "not loaded back") << ", " << (stale_rejected ? "stale index rejected" : "stale index loaded")
+            << ", max error " << max_error;
+    result.message = message.str();
+
+    // Reading forward from a keyframe is not always bit exact with seeking for MJPEG.
+    if (index.GetKeyframeCount() != index.GetFrameCount() || misplaced_keyframes > 0 || !round_trip || !stale_rejected || max_error > 3)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Fills logged columns of a small image to check the blend between their neighbours, then renders a copy of
+ * the regression movie cut in half. The render has to log the columns past the cut instead of stopping
+ * silently, and match the intact movie before it. The throughput is of that render, in columns per second.
+ */
+static RegressionResult ValidateDamageCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "damaged_movie";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    Mat fill_image = Mat::zeros(1, 8, CV_8UC3);
+    fill_image.at<Vec3b>(0, 2) = Vec3b(0, 0, 200);
+    fill_image.at<Vec3b>(0, 6) = Vec3b(200, 0, 0);
+    fill_image.at<Vec3b>(0, 7) = Vec3b(1, 2, 3);
+
+    ArtDamageLog fill_log;
+
+    for (int column_id = 3; column_id < 6; column_id++)
+        fill_log.AddColumn(column_id, column_id);
+
+    fill_log.AddColumn(7, 7, true);
+    fill_log.FillFromNeighbours(fill_image);
+
+    // The middle of the gap is halfway between its neighbours, the truncated end keeps what it had.
+    if (fill_image.at<Vec3b>(0, 4) != Vec3b(100, 0, 100) || fill_image.at<Vec3b>(0, 7) != Vec3b(1, 2, 3)) {
+        result.passed = false;
+        result.message = "damaged columns aren't filled from their neighbours";
+        return result;
+    }
+
+    ifstream movie_file(movie_path, ios::binary);
+    vector<char> movie_bytes((istreambuf_iterator<char>(movie_file)), istreambuf_iterator<char>());
+    string truncated_path = output_dir + "/truncated.avi";
+    ofstream(truncated_path, ios::binary).write(movie_bytes.data(), movie_bytes.size() / 2);
+
+    // The cut takes the index of the AVI with it, so both renders read forward instead of seeking.
+    ArtRenderOptions options;
+    options.style = ART_STYLE_AVERAGE_COLOR;
+    options.sampling = ART_SAMPLING_SEQUENTIAL;
+    options.preview = false;
+
+    Mat intact_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    RenderArtColumns(movie_path, intact_image, 0, intact_image.cols, options);
+
+    ArtDamageLog damage_log;
+    options.damage_log = &damage_log;
+
+    Mat truncated_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    int64 start = getTickCount();
+    RenderArtColumns(truncated_path, truncated_image, 0, truncated_image.cols, options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = truncated_image.cols / max(seconds, 1e-9);
+
+    vector<ArtDamagedRange> ranges = damage_log.GetRanges();
+
+    if (ranges.empty()) {
+        result.passed = false;
+        result.message = "no column of the truncated movie was logged";
+        return result;
+    }
+
+    int first_damaged = truncated_image.cols;
+    int last_logged = 0;
+
+    for (const ArtDamagedRange& range : ranges) {
+        first_damaged = min(first_damaged, range.first_column);
+        last_logged = max(last_logged, range.last_column);
+    }
+
+    Mat difference;
+    absdiff(intact_image.colRange(0, first_damaged), truncated_image.colRange(0, first_damaged), difference);
+    double max_error = first_damaged > 0 ? norm(difference.reshape(1), NORM_INF) : 0.0;
+
+    ostringstream message;
+    message << ranges.size() << " damaged ranges from column " << first_damaged << (ranges.back().truncated ? ", truncated end" : "")
+            << " to column " << last_logged << ", max error " << max_error << " before them";
+    result.message = message.str();
+
+    // Half of the bytes hold about half of the frames, and every column after the cut is logged, not just the first.
+    if (first_damaged == 0 || first_damaged == truncated_image.cols || last_logged != truncated_image.cols || max_error > 0.0)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Checks how a column shows its motion: black when nothing moves, white at full scale, and with directions
+ * the hue of the main one. With a build that reads motion vectors, also renders an mp4v synthetic movie, whose
+ * moving shapes have to show up. The throughput is of that render, in columns per second.
+ */
+static RegressionResult ValidateMotionVectorCase(const string& output_dir) {
+    RegressionResult result;
+    result.name = "motion_vectors";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    MotionSummary still;
+    still.frame_count = 1;
+
+    MotionSummary rightward;
+    rightward.frame_count = 1;
+    rightward.energy = MOTION_VECTOR_FULL_SCALE;
+    rightward.direction_histogram[0] = MOTION_VECTOR_FULL_SCALE;
+
+    Vec3b still_color = EncodeMotionSummary(still, false);
+    Vec3b full_color = EncodeMotionSummary(rightward, false);
+    Vec3b direction_color = EncodeMotionSummary(rightward, true);
+
+    // Hue 0 with full agreement is pure red.
+    if (still_color != Vec3b(0, 0, 0) || full_color != Vec3b(255, 255, 255) || direction_color != Vec3b(0, 0, 255)) {
+        result.passed = false;
+        result.message = "the motion of a column isn't shown as expected";
+        return result;
+    }
+
+    Mat column_image = Mat::zeros(REGRESSION_ART_HEIGHT, 1, CV_8UC3);
+    Mat no_frame;
+    ArtColumnContext context;
+
+    if (CreateArtColumn(no_frame, column_image, 0, ART_STYLE_MOTION_VECTORS, false, &context) != ART_COLUMN_INVALID_FRAME) {
+        result.passed = false;
+        result.message = "a column without motion was filled";
+        return result;
+    }
+
+    context.motion = &rightward;
+
+    if (CreateArtColumn(no_frame, column_image, 0, ART_STYLE_MOTION_VECTORS, false, &context) != ART_COLUMN_OK
+        || column_image.at<Vec3b>(REGRESSION_ART_HEIGHT / 2, 0) != full_color) {
+        result.passed = false;
+        result.message = "the column wasn't filled with its motion";
+        return result;
+    }
+
+    if (!IsMotionVectorSupported()) {
+        result.message = "column colors checked, rendering needs a build with MOVIE_WALL_ART_FFMPEG";
+        return result;
+    }
+
+    SyntheticMovieConfig config = GetRegressionMovieConfig();
+    config.duration_seconds = MOTION_CASE_SECONDS;
+    config.fourcc = "mp4v";
+
+    string movie_path = output_dir + "/motion.mp4";
+    WriteSyntheticMovie(movie_path, config);
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_MOTION_VECTORS;
+    options.preview = false;
+
+    Mat art_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    int64 start = getTickCount();
+    RenderArtColumns(movie_path, art_image, 0, art_image.cols, options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = art_image.cols / max(seconds, 1e-9);
+
+    Mat gray;
+    cvtColor(art_image, gray, COLOR_BGR2GRAY);
+    int moving_columns = countNonZero(gray.row(gray.rows / 2));
+
+    ostringstream message;
+    message << moving_columns << " of " << art_image.cols << " columns show motion";
+    result.message = message.str();
+
+    if (moving_columns < art_image.cols / 2)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Sets a budget smaller than the process and checks a reservation waits while another one is held, and gets
+ * through once it is released. Then renders the regression movie with its art reserved as resident, which has
+ * to run alone instead of waiting forever. The throughput is in columns per second of that render.
+ */
+static RegressionResult ValidateMemoryGovernorCase(const string& movie_path) {
+    RegressionResult result;
+    result.name = "memory_governor";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    MemoryGovernor& governor = GetMemoryGovernor();
+    governor.SetBudget(1);
+
+    // The waiting threads are detached, so a stuck reservation fails the case instead of hanging the run.
+    shared_ptr<promise<void>> waiter_done = make_shared<promise<void>>();
+    future<void> waiter = waiter_done->get_future();
+    bool blocked = false;
+
+    {
+        MemoryReservation held(GOVERNOR_CASE_BYTES);
+
+        thread([waiter_done]() {
+            MemoryReservation waiting(GOVERNOR_CASE_BYTES);
+            waiter_done->set_value();
+        }).detach();
+
+        blocked = waiter.wait_for(chrono::milliseconds(GOVERNOR_CASE_BLOCKED_MS)) == future_status::timeout;
+    }
+
+    bool released = waiter.wait_for(chrono::seconds(GOVERNOR_CASE_TIMEOUT_SECONDS)) == future_status::ready;
+
+    shared_ptr<promise<void>> render_done = make_shared<promise<void>>();
+    future<void> render = render_done->get_future();
+    int64 start = getTickCount();
+
+    thread([movie_path, render_done]() {
+        MemoryReservation art_reservation((long long)REGRESSION_ART_WIDTH * REGRESSION_ART_HEIGHT * 3, nullptr, true);
+        Mat art_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+
+        ArtRenderOptions options;
+        options.preview = false;
+        RenderArtColumns(movie_path, art_image, 0, art_image.cols, options);
+
+        render_done->set_value();
+    }).detach();
+
+    bool rendered = render.wait_for(chrono::seconds(GOVERNOR_CASE_TIMEOUT_SECONDS)) == future_status::ready;
+    double seconds = (getTickCount() - start) / getTickFrequency();
+
+    // Lifting the budget lets anything still waiting finish.
+    governor.SetBudget(0);
+
+    if (rendered)
+        result.throughput = REGRESSION_ART_WIDTH / max(seconds, 1e-9);
+
+    ostringstream message;
+    message << "reservation " << (blocked ? "waited" : "didn't wait") << " and was " << (released ? "granted" : "never granted")
+            << " after the release, render under the budget " << (rendered ? "ran alone" : "was stuck");
+    result.message = message.str();
+    result.passed = blocked && released && rendered;
+
+    return result;
+}
+
+/**
+ * Fingerprints the regression movie and checks every band of every sample against the mean of the same rows
+ * of the synthetic frame, whose letterbox bars and vertical gradients make the bands differ. A frame split
+ * in a red top and a blue bottom is checked first. A movie that can't be opened has to fail, and the samples
+ * after the end of a truncated copy have to repeat the last good one. The throughput is in samples per second.
+ */
+static RegressionResult ValidateFingerprintBandsCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "fingerprint_bands";
+    result.unit = "samples/s";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    Mat split_frame(SYNTHETIC_FRAME_HEIGHT, SYNTHETIC_FRAME_WIDTH, CV_8UC3, Scalar(0, 0, 255));
+    split_frame(Rect(0, SYNTHETIC_FRAME_HEIGHT / 2, SYNTHETIC_FRAME_WIDTH, SYNTHETIC_FRAME_HEIGHT / 2)).setTo(Scalar(255, 0, 0));
+
+    uchar split_signature[FINGERPRINT_SIGNATURE_BYTES];
+    GetFrameBandSignature(split_frame, split_signature);
+
+    if (split_signature[2] != 255 || split_signature[0] != 0 || split_signature[FINGERPRINT_SIGNATURE_BYTES - 3] != 255
+        || split_signature[FINGERPRINT_SIGNATURE_BYTES - 1] != 0) {
+        result.passed = false;
+        result.message = "the bands of a red and blue frame aren't red and blue";
+        return result;
+    }
+
+    ArtRenderOptions options;
+    TimelineFingerprint fingerprint;
+    int64 start = getTickCount();
+
+    if (!BuildTimelineFingerprint(movie_path, options, fingerprint, TRAILER_SAMPLES_PER_SECOND)) {
+        result.passed = false;
+        result.message = "the fingerprint could not be built";
+        return result;
+    }
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = fingerprint.GetSampleCount() / max(seconds, 1e-9);
+
+    SyntheticMovie movie(GetRegressionMovieConfig());
+    int sample_interval = (int)lround(fingerprint.seconds_per_sample * movie.GetFps());
+    int max_error = 0;
+    int max_band_spread = 0;
+    Mat frame;
+
+    for (int sample = 0; sample < fingerprint.GetSampleCount(); sample++) {
+        movie.RenderFrame(sample * sample_interval, frame);
+
+        const uchar* signature = &fingerprint.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES];
+        uchar expected[FINGERPRINT_SIGNATURE_BYTES];
+        GetFrameBandSignature(frame, expected);
+
+        for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++) {
+            max_error = max(max_error, abs((int)signature[i] - (int)expected[i]));
+            max_band_spread = max(max_band_spread, abs((int)signature[i] - (int)signature[i % 3]));
+        }
+    }
+
+    ostringstream message;
+    message << fingerprint.GetSampleCount() << " samples, max error " << max_error << " levels, bands up to " << max_band_spread
+            << " levels apart";
+    result.message = message.str();
+
+    // Bands that always match the top one carry no more than a single color.
+    if (max_error > FINGERPRINT_BANDS_CASE_TOLERANCE || max_band_spread <= FINGERPRINT_BANDS_CASE_TOLERANCE) {
+        result.passed = false;
+        return result;
+    }
+
+    TimelineFingerprint missing_fingerprint;
+
+    if (BuildTimelineFingerprint(output_dir + "/missing.avi", options, missing_fingerprint, TRAILER_SAMPLES_PER_SECOND)) {
+        result.passed = false;
+        result.message = "a movie that can't be opened gives a fingerprint";
+        return result;
+    }
+
+    // The second half of a cut movie repeats the last sample that could be read, instead of staying black.
+    ifstream movie_file(movie_path, ios::binary);
+    vector<char> movie_bytes((istreambuf_iterator<char>(movie_file)), istreambuf_iterator<char>());
+    string truncated_path = output_dir + "/truncated_fingerprint.avi";
+    ofstream(truncated_path, ios::binary).write(movie_bytes.data(), movie_bytes.size() / 2);
+
+    TimelineFingerprint truncated_fingerprint;
+    options.sampling = ART_SAMPLING_SEQUENTIAL;
+
+    if (!BuildTimelineFingerprint(truncated_path, options, truncated_fingerprint, TRAILER_SAMPLES_PER_SECOND)) {
+        result.passed = false;
+        result.message = "the fingerprint of a truncated movie could not be built";
+        return result;
+    }
+
+    const vector<uchar>& truncated_signatures = truncated_fingerprint.signatures;
+    int last_sample = truncated_fingerprint.GetSampleCount() - 1;
+    bool last_is_black = last_sample < 0 || all_of(truncated_signatures.end() - FINGERPRINT_SIGNATURE_BYTES, truncated_signatures.end(),
+                                                   [](uchar value) { return value == 0; });
+
+    if (last_is_black) {
+        result.passed = false;
+        result.message += ", the samples after the end of a truncated movie are black";
+    }
+
+    return result;
+}
+
+/**
+ * Builds the fingerprint of an hour long movie of scenes, a noisy re-encode of it with a five minute scene
+ * inserted, and an unrelated one. Checks the cut is recognized and its times mapped, and the unrelated one
+ * isn't. The throughput is in aligned samples per second.
+ */
+static RegressionResult ValidateFingerprintCase() {
+    RegressionResult result;
+    result.name = "fingerprint_alignment";
+    result.unit = "samples/s";
+    result.passed = true;
+
+    mt19937 random(FINGERPRINT_CASE_SAMPLES);
+    TimelineFingerprint theatrical;
+    TimelineFingerprint extended;
+    TimelineFingerprint unrelated;
+    theatrical.seconds_per_sample = extended.seconds_per_sample = unrelated.seconds_per_sample = 1.0;
+
+    // Scenes of a few seconds each, every one of its own colors.
+    vector<uchar> scene(FINGERPRINT_SIGNATURE_BYTES);
+
+    for (int sample = 0; sample < FINGERPRINT_CASE_SAMPLES; sample++) {
+        if (sample % 7 == 0) {
+            for (uchar& color : scene)
+                color = (uchar)(random() % 256);
+        }
+
+        theatrical.signatures.insert(theatrical.signatures.end(), scene.begin(), scene.end());
+    }
+
+    for (int sample = 0; sample < FINGERPRINT_CASE_SAMPLES; sample++) {
+        if (sample == FINGERPRINT_CASE_INSERT_AT) {
+            for (int i = 0; i < FINGERPRINT_CASE_INSERT_SAMPLES * FINGERPRINT_SIGNATURE_BYTES; i++)
+                extended.signatures.push_back((uchar)(random() % 256));
+        }
+
+        for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++) {
+            int noisy = theatrical.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES + i] + (int)(random() % 7) - 3;
+            extended.signatures.push_back(saturate_cast<uchar>(noisy));
+        }
+    }
+
+    for (int i = 0; i < FINGERPRINT_CASE_SAMPLES * FINGERPRINT_SIGNATURE_BYTES; i++)
+        unrelated.signatures.push_back((uchar)(random() % 256));
+
+    int64 start = getTickCount();
+    FingerprintAlignment alignment = AlignFingerprints(theatrical, extended);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = FINGERPRINT_CASE_SAMPLES / max(seconds, 1e-9);
+
+    FingerprintAlignment unrelated_alignment = AlignFingerprints(theatrical, unrelated);
+
+    long long before_ms = (FINGERPRINT_CASE_INSERT_AT / 2) * 1000LL + 250;
+    long long after_ms = (FINGERPRINT_CASE_INSERT_AT + 600) * 1000LL + 250;
+    long long before_error = llabs(MapFingerprintTime(alignment, before_ms) - before_ms);
+    long long after_error = llabs(MapFingerprintTime(alignment, after_ms) - (after_ms + FINGERPRINT_CASE_INSERT_SAMPLES * 1000LL));
+
+    ostringstream message;
+    message << "mean distance " << alignment.mean_distance << ", mapping error " << before_error << " ms before the insert and "
+            << after_error << " ms after it, unrelated " << (unrelated_alignment.same_movie ? "matched" : "told apart");
+    result.message = message.str();
+
+    if (!alignment.same_movie || unrelated_alignment.same_movie || before_error > FINGERPRINT_CASE_MAX_ERROR_MS || after_error > FINGERPRINT_CASE_MAX_ERROR_MS)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Builds the fingerprint of a two hour feature of slowly changing scenes and a trailer of short shots taken
+ * from it with some noise, between black frames. Checks every shot long enough to search is found where it
+ * was taken from, within a sample. The throughput is in searched shots per second.
+ */
+static RegressionResult ValidateTrailerSearchCase() {
+    RegressionResult result;
+    result.name = "trailer_search";
+    result.unit = "shots/s";
+    result.passed = true;
+
+    mt19937 random(TRAILER_CASE_SHOTS);
+    TimelineFingerprint feature;
+    TimelineFingerprint trailer;
+    feature.seconds_per_sample = trailer.seconds_per_sample = 1.0 / TRAILER_SAMPLES_PER_SECOND;
+
+    // Every scene starts from its own colors and drifts a few levels per sample, as the camera moves.
+    vector<int> scene_colors(FINGERPRINT_SIGNATURE_BYTES);
+    vector<int> scene_drifts(FINGERPRINT_SIGNATURE_BYTES);
+    int scene_left = 0;
+    int scene_sample = 0;
+
+    for (int sample = 0; sample < TRAILER_CASE_FEATURE_SAMPLES; sample++) {
+        if (scene_left-- == 0) {
+            scene_left = 7 + (int)(random() % 33);
+            scene_sample = 0;
+
+            for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++) {
+                scene_colors[i] = 30 + (int)(random() % 196);
+                scene_drifts[i] = (int)(random() % 7) - 3;
+            }
+        }
+
+        for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++)
+            feature.signatures.push_back(saturate_cast<uchar>(scene_colors[i] + scene_drifts[i] * scene_sample));
+
+        scene_sample++;
+    }
+
+    // The feature sample every trailer sample was taken from, -1 for the black ones.
+    vector<int> source_samples;
+
+    for (int shot = 0; shot < TRAILER_CASE_SHOTS; shot++) {
+        trailer.signatures.insert(trailer.signatures.end(), 2 * FINGERPRINT_SIGNATURE_BYTES, 0);
+        source_samples.insert(source_samples.end(), 2, -1);
+
+        int length = 6 + (int)(random() % 7);
+        int start = (int)(random() % (TRAILER_CASE_FEATURE_SAMPLES - length));
+
+        for (int sample = start; sample < start + length; sample++) {
+            for (int i = 0; i < FINGERPRINT_SIGNATURE_BYTES; i++) {
+                int noisy = feature.signatures[(size_t)sample * FINGERPRINT_SIGNATURE_BYTES + i] + (int)(random() % 7) - 3;
+                trailer.signatures.push_back(saturate_cast<uchar>(noisy));
+            }
+
+            source_samples.push_back(sample);
+        }
+    }
+
+    int64 start = getTickCount();
+    vector<TrailerShot> shots = LocateTrailerShots(trailer, feature);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+
+    double sample_milliseconds = feature.seconds_per_sample * 1000.0;
+    int searched_shots = 0;
+    int found_shots = 0;
+    int misplaced_shots = 0;
+
+    // A scene of the feature taken across a cut is two shots of the trailer, each found on its own.
+    for (const TrailerShot& shot : shots) {
+        int first_sample = (int)llround(shot.trailer_milliseconds / sample_milliseconds);
+        int shot_samples = (int)llround(shot.duration_milliseconds / sample_milliseconds);
+
+        if (source_samples[first_sample] < 0 || shot_samples < TRAILER_MIN_SHOT_SAMPLES)
+            continue;
+
+        searched_shots++;
+
+        if (shot.feature_milliseconds < 0)
+            continue;
+
+        if (abs((int)llround(shot.feature_milliseconds / sample_milliseconds) - source_samples[first_sample]) <= 1)
+            found_shots++;
+        else
+            misplaced_shots++;
+    }
+
+    result.throughput = searched_shots / max(seconds, 1e-9);
+
+    ostringstream message;
+    message << found_shots << " of " << searched_shots << " shots found, " << misplaced_shots << " misplaced, in " << seconds * 1000.0 << " ms";
+    result.message = message.str();
+
+    if (searched_shots < TRAILER_CASE_SHOTS || found_shots != searched_shots)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Zooms into a range of a movie longer than two segments of level 0, checks it matches a direct render of the
+ * same frames, then renders it again, which should come from the cache. Renders the whole movie a frame per
+ * column, which decodes the other segments, and zooms out to a coarser level, which should be derived from
+ * them without decoding and match a direct render at the same sample interval. The throughput is in columns
+ * per second of the cached and derived renders.
+ */
+static RegressionResult ValidateRangeRenderCase(const string& output_dir) {
+    RegressionResult result;
+    result.name = "range_render";
+    result.passed = true;
+    result.throughput = 0.0;
+
+    SyntheticMovieConfig config = GetRegressionMovieConfig();
+    config.duration_seconds = RANGE_CASE_SECONDS;
+
+    string movie_path = output_dir + "/range.avi";
+    WriteSyntheticMovie(movie_path, config);
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_PIXEL_STRIP;
+    options.preview = false;
+
+    RangeRenderer renderer(movie_path, REGRESSION_ART_HEIGHT, options);
+    int frame_count = renderer.GetFrameCount();
+
+    if (frame_count <= 2 * RANGE_SEGMENT_COLUMNS || frame_count % RANGE_CASE_COARSE_INTERVAL != 0) {
+        result.passed = false;
+        result.message = "the range movie has " + to_string(frame_count) + " frames";
+        return result;
+    }
+
+    // Two seconds in, as many frames as columns, so every column is a frame of its own.
+    double first_seconds = 2.0;
+    double last_seconds = first_seconds + (double)REGRESSION_ART_WIDTH / SYNTHETIC_FPS;
+    int first_frame = (int)llround(first_seconds * SYNTHETIC_FPS);
+
+    Mat direct_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    RenderArtColumns(movie_path, direct_image, 0, direct_image.cols, options, first_frame, first_frame + REGRESSION_ART_WIDTH);
+
+    // The coarse render samples every RANGE_CASE_COARSE_INTERVAL frames, a level the whole movie render is below.
+    Mat direct_coarse_image = Mat::zeros(REGRESSION_ART_HEIGHT, frame_count / RANGE_CASE_COARSE_INTERVAL, CV_8UC3);
+    RenderArtColumns(movie_path, direct_coarse_image, 0, direct_coarse_image.cols, options, 0, frame_count);
+
+    Mat range_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    Mat repeat_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    Mat frames_image = Mat::zeros(REGRESSION_ART_HEIGHT, frame_count, CV_8UC3);
+    Mat whole_image = Mat::zeros(REGRESSION_ART_HEIGHT, direct_coarse_image.cols, CV_8UC3);
+    RangeRenderStats zoom_stats;
+    RangeRenderStats repeat_stats;
+    RangeRenderStats frames_stats;
+    RangeRenderStats whole_stats;
+
+    double movie_seconds = (double)frame_count / SYNTHETIC_FPS;
+
+    if (!renderer.Render(first_seconds, last_seconds, range_image, &zoom_stats) || !renderer.Render(first_seconds, last_seconds, repeat_image, &repeat_stats)
+        || !renderer.Render(0.0, movie_seconds, frames_image, &frames_stats) || !renderer.Render(0.0, movie_seconds, whole_image, &whole_stats)) {
+        result.passed = false;
+        result.message = "the range could not be rendered";
+        return result;
+    }
+
+    double cached_seconds = repeat_stats.seconds + whole_stats.seconds;
+    result.throughput = (repeat_image.cols + whole_image.cols) / max(cached_seconds, 1e-9);
+
+    Mat difference;
+    absdiff(direct_image, range_image, difference);
+    double max_difference = 0.0;
+    minMaxLoc(difference.reshape(1), nullptr, &max_difference);
+
+    absdiff(direct_coarse_image, whole_image, difference);
+    double max_coarse_difference = 0.0;
+    minMaxLoc(difference.reshape(1), nullptr, &max_coarse_difference);
+
+    ostringstream message;
+    message << frame_count << " frames, max difference " << max_difference << ", " << zoom_stats.decoded_segments << " segments decoded, then "
+            << repeat_stats.decoded_segments << " again, " << frames_stats.decoded_segments << " for every frame, level " << whole_stats.level
+            << " with " << whole_stats.derived_segments << " derived, " << whole_stats.decoded_segments << " decoded, max difference "
+            << max_coarse_difference;
+    result.message = message.str();
+
+    if (max_difference > 0.0 || zoom_stats.decoded_segments == 0 || repeat_stats.decoded_segments > 0 || norm(range_image, repeat_image, NORM_INF) > 0.0)
+        result.passed = false;
+
+    if (frames_stats.level != 0 || whole_stats.level == 0 || whole_stats.derived_segments == 0 || whole_stats.decoded_segments > 0
+        || max_coarse_difference > 0.0)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Short clips listed in samples.txt, one path per line, are rendered with every style as well.
+ * They are not committed, so the cases are skipped on machines without them.
+ */
+static vector<string> ReadSampleMovies(const string& data_dir) {
+    vector<string> samples;
+    ifstream file(data_dir + "/samples.txt");
+    string line;
+
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (!line.empty() && line[0] != '#')
+            samples.push_back(line);
+    }
+
+    return samples;
+}
+
+static string GetSampleName(const string& sample_path) {
+    size_t slash = sample_path.find_last_of("/\\");
+    string file = slash == string::npos ? sample_path : sample_path.substr(slash + 1);
+    size_t dot = file.find_last_of('.');
+
+    return dot == string::npos ? file : file.substr(0, dot);
+}
+
+/**
+ * Writes the cgroup v2 CPU quota file into a directory that stands for the cgroup filesystem.
+ */
+static void WriteCpuMax(const string& cgroup_root, const string& cpu_max) {
+    ofstream file(cgroup_root + "/cpu.max");
+    file << cpu_max << endl;
+}
+
+/**
+ * Reads an FFMETADATA chapters file, then one with a time that isn't a number, which has to give no chapters
+ * instead of throwing. Nothing is timed.
+ */
+static RegressionResult ValidateChaptersCase(const string& output_dir) {
+    RegressionResult result;
+    result.name = "chapters";
+    result.passed = true;
+    result.throughput = 0.0;
+    result.unit = "";
+
+    string chapters_path = output_dir + "/chapters.txt";
+    ofstream(chapters_path) << ";FFMETADATA1" << endl
+                            << "[CHAPTER]" << endl << "TIMEBASE=1/1000" << endl << "START=0" << endl << "END=2000" << endl << "title=One" << endl
+                            << "[CHAPTER]" << endl << "TIMEBASE=1/1000" << endl << "START=2000" << endl << "END=5000" << endl << "title=Two" << endl;
+    vector<MovieSegment> chapters = ReadMovieChapters(chapters_path, SYNTHETIC_FPS);
+
+    string malformed_path = output_dir + "/chapters_malformed.txt";
+    ofstream(malformed_path) << ";FFMETADATA1" << endl << "[CHAPTER]" << endl << "START=zero" << endl << "END=2000" << endl;
+    vector<MovieSegment> malformed_chapters = ReadMovieChapters(malformed_path, SYNTHETIC_FPS);
+
+    ostringstream message;
+    message << chapters.size() << " chapters, " << malformed_chapters.size() << " from the malformed file";
+    result.message = message.str();
+
+    if (chapters.size() != 2 || chapters[1].first_frame != 2 * SYNTHETIC_FPS || chapters[1].last_frame != 5 * SYNTHETIC_FPS
+        || chapters[1].title != "Two" || !malformed_chapters.empty())
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Checks that cgroup CPU quotas are read and rounded up to whole cores, that no quota reads as 0, that the
+ * smallest quota up the hierarchy of the process applies, and that the plans of this host split the cores
+ * between the workers and the decoders. Nothing is timed.
+ */
+static RegressionResult ValidateConcurrencyCase(const string& output_dir) {
+    RegressionResult result;
+    result.name = "concurrency";
+    result.passed = true;
+    result.throughput = 0.0;
+    result.unit = "";
+
+    WriteCpuMax(output_dir, "150000 100000");
+    int fractional_quota = ReadCgroupQuotaCores(output_dir);
+    WriteCpuMax(output_dir, "400000 100000");
+    int whole_quota = ReadCgroupQuotaCores(output_dir);
+    WriteCpuMax(output_dir, "max 100000");
+    int unlimited_quota = ReadCgroupQuotaCores(output_dir);
+    remove((output_dir + "/cpu.max").c_str());
+    int missing_quota = ReadCgroupQuotaCores(output_dir);
+
+    // A process two levels down, whose parent has the smallest quota, and whose v1 CPU controller lists no path.
+    string proc_cgroup_path = output_dir + "/proc_cgroup";
+    ofstream(proc_cgroup_path) << "0::/workers/render" << endl << "4:cpu,cpuacct:/" << endl;
+    utils::fs::createDirectories(output_dir + "/workers/render");
+    WriteCpuMax(output_dir + "/workers/render", "max 100000");
+    WriteCpuMax(output_dir + "/workers", "300000 100000");
+    WriteCpuMax(output_dir, "800000 100000");
+    int nested_quota = ReadCgroupQuotaCores(output_dir, proc_cgroup_path);
+    remove((output_dir + "/cpu.max").c_str());
+
+    ConcurrencyPlan single = PlanConcurrency(0, 0, false);
+    ConcurrencyPlan concurrent = PlanConcurrency(4, 0, true);
+    bool quota_applied = single.quota_cores == 0 || single.available_cores <= single.quota_cores;
+    bool single_split = single.workers == single.available_cores && single.decoder_threads == single.available_cores;
+    bool concurrent_split = concurrent.workers == 4 && concurrent.opencv_threads == 1 &&
+                            concurrent.decoder_threads == max(1, concurrent.available_cores / 4);
+
+    ostringstream message;
+    message << "quotas " << fractional_quota << ", " << whole_quota << ", " << unlimited_quota << ", " << missing_quota << " and nested "
+            << nested_quota << ", "
+            << single.available_cores << " cores available";
+    result.message = message.str();
+
+    if (fractional_quota != 2 || whole_quota != 4 || unlimited_quota != 0 || missing_quota != 0 || nested_quota != 3 || !quota_applied || !single_split || !concurrent_split)
+        result.passed = false;
+
+    return result;
+}
+
+/**
+ * Counts the occurrences of text in a file.
+ */
+static int CountInFile(const string& path, const string& text) {
+    ifstream file(path);
+    string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    int count = 0;
+
+    for (size_t found = contents.find(text); found != string::npos; found = contents.find(text, found + text.size()))
+        count++;
+
+    return count;
+}
+
+/**
+ * Traces a render of the regression movie and checks the Chrome trace has a reduce span and a decode span for
+ * every column. Runs last, as tracing stays on once enabled.
+ */
+static RegressionResult ValidatePipelineTraceCase(const string& movie_path, const string& output_dir) {
+    RegressionResult result;
+    result.name = "pipeline_trace";
+    result.passed = true;
+
+    ArtRenderOptions options;
+    options.style = ART_STYLE_AVERAGE_COLOR;
+    options.preview = false;
+
+    EnablePipelineTrace();
+
+    Mat art_image = Mat::zeros(REGRESSION_ART_HEIGHT, REGRESSION_ART_WIDTH, CV_8UC3);
+    int64 start = getTickCount();
+    RenderArtColumns(movie_path, art_image, 0, art_image.cols, options);
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    result.throughput = art_image.cols / max(seconds, 1e-9);
+
+    string trace_path = output_dir + "/synthetic.test.trace.json";
+    bool written = WriteChromeTrace(trace_path);
+    int reduce_spans = CountInFile(trace_path, "{\"name\":\"reduce\"");
+    int decode_spans = CountInFile(trace_path, "{\"name\":\"decode\"");
+
+    ostringstream message;
+    message << reduce_spans << " reduce and " << decode_spans << " decode spans for " << art_image.cols << " columns";
+    result.message = message.str();
+
+    if (!written || reduce_spans != art_image.cols || decode_spans < art_image.cols)
+        result.passed = false;
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    RegressionOptions options;
+    options.data_dir = GetDefaultDataDir();
+    options.update_golden = false;
+    options.update_baseline = false;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+
+        if (argument == "--update-golden")
+            options.update_golden = true;
+        else if (argument == "--update-baseline")
+            options.update_baseline = true;
+        else if (argument == "--data-dir" && i + 1 < argc)
+            options.data_dir = argv[++i];
+    }
+
+    GetSyntheticFrames();
+
+    string movie_path = WriteRegressionMovie(options.data_dir + "/output");
+    vector<string> sample_paths = ReadSampleMovies(options.data_dir);
+    vector<RegressionResult> results;
+
+    for (const RegressionStyle& style : regression_styles) {
+        int art_style = style.style;
+
+        if (style.needs_codec)
+            results.push_back(SkipCase("frames_" + style.name, "reads the codec, not the frames"));
+        else {
+            results.push_back(RunCase("frames_" + style.name, style.exact_tolerance, true, [=](Mat& art_image) {
+                RenderSyntheticFrames(art_image, art_style);
+            }, options));
+        }
+
+        // Without motion vectors the style falls back to motion_energy, which has cases of its own.
+        if (style.needs_codec && !IsMotionVectorSupported()) {
+            results.push_back(SkipCase("video_" + style.name, "needs a build with MOVIE_WALL_ART_FFMPEG"));
+            continue;
+        }
+
+        ArtRenderOptions render_options;
+        render_options.style = art_style;
+        render_options.preview = false;
+
+        // Decoding MJPEG is not bit exact across decoder builds.
+        results.push_back(RunCase("video_" + style.name, 3, false, [=](Mat& art_image) {
+            RenderArtColumns(movie_path, art_image, 0, art_image.cols, render_options);
+        }, options));
+
+        for (const string& sample_path : sample_paths) {
+            results.push_back(RunCase("sample_" + GetSampleName(sample_path) + "_" + style.name, 3, false, [=](Mat& art_image) {
+                RenderArtColumns(sample_path, art_image, 0, art_image.cols, render_options);
+            }, options));
+        }
+    }
+
+    results.push_back(ValidateDcCase(movie_path));
+
+    ArtRenderOptions reduced_options;
+    reduced_options.reduction_width = SMALL_FRAME_REDUCTION_WIDTH;
+    results.push_back(ValidateSmallFrameStripCase("reduced_pixel_strip", movie_path, reduced_options));
+
+    // DC frames are an eighth of the movie in each dimension.
+    ArtRenderOptions dc_options;
+    dc_options.dc_average = true;
+    results.push_back(ValidateSmallFrameStripCase("dc_pixel_strip", movie_path, dc_options));
+    results.push_back(ValidateParallelReductionCase());
+    results.push_back(ValidateSparseAverageCase());
+    results.push_back(ValidateDistributedCase(movie_path, options.data_dir + "/output"));
+    results.push_back(ValidateSharedDecodeCase(movie_path));
+    results.push_back(ValidateMemoryGovernorCase(movie_path));
+    results.push_back(ValidateDamageCase(movie_path, options.data_dir + "/output"));
+    results.push_back(ValidateGopIndexCase(movie_path, options.data_dir + "/output"));
+    results.push_back(ValidateMotionVectorCase(options.data_dir + "/output"));
+    results.push_back(ValidateProxyCase(movie_path));
+    results.push_back(ValidateAnalyzerBusCase(movie_path));
+    results.push_back(ValidateRangeRenderCase(options.data_dir + "/output"));
+    results.push_back(ValidateFingerprintBandsCase(movie_path, options.data_dir + "/output"));
+    results.push_back(ValidateFingerprintCase());
+    results.push_back(ValidateTrailerSearchCase());
+    results.push_back(ValidateSpriteSheetCase(movie_path, options.data_dir + "/output"));
+    results.push_back(ValidateChaptersCase(options.data_dir + "/output"));
+    results.push_back(ValidateConcurrencyCase(options.data_dir + "/output"));
+    results.push_back(ValidatePipelineTraceCase(movie_path, options.data_dir + "/output"));
+
+    string baseline_path = options.data_dir + "/baselines/" + GetHostName() + ".txt";
+    map<string, double> baseline = ReadBaseline(baseline_path);
+    int failures = 0;
+    int skipped = 0;
+
+    for (RegressionResult& result : results) {
+        map<string, double>::iterator stored = baseline.find(result.name);
+
+        if (!options.update_baseline && !result.skipped && stored != baseline.end()) {
+            double slowest = stored->second * (100 - THROUGHPUT_TOLERANCE_PERCENT) / 100.0;
+
+            if (result.throughput < slowest) {
+                ostringstream message;
+                message << (result.message.empty() ? "" : result.message + "; ")
+                        << "throughput " << result.throughput << " " << result.unit << " is below the baseline " << stored->second;
+                result.message = message.str();
+                result.passed = false;
+            }
+        }
+
+        cout << (!result.passed ? "[ FAIL ] " : result.skipped ? "[ SKIP ] " : "[  OK  ] ") << result.name << " " << result.throughput << " " << result.unit;
+
+        if (!result.message.empty())
+            cout << " - " << result.message;
+
+        cout << endl;
+
+        if (!result.passed)
+            failures++;
+        else if (result.skipped)
+            skipped++;
+    }
+
+    if (options.update_baseline) {
+        WriteBaseline(baseline_path, results);
+        cout << "Baseline written to " << baseline_path << endl;
+    }
+
+    cout << results.size() - failures - skipped << " of " << results.size() << " cases passed, " << skipped << " skipped." << endl;
+
+    return failures == 0 ? 0 : 1;
+}